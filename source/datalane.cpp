@@ -15,19 +15,20 @@
 ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include <stdexcept>
 #include "datalane-socket-client.hpp"
 #include "datalane-socket-server.hpp"
 #include "datalane.hpp"
 
 std::shared_ptr<datalane::socket> datalane::listen(std::string socket, size_t backlog /*= -1*/) {
-	throw std::exception("Not implemented yet.");
+	throw std::runtime_error("Not implemented yet.");
 	//std::shared_ptr<datalane::server_socket> sock =
 	// std::make_shared<datalane::server_socket>(socket, backlog);
 	//return std::dynamic_pointer_cast<datalane::socket>(sock);
 }
 
 std::shared_ptr<datalane::socket> datalane::connect(std::string socket) {
-	throw std::exception("Not implemented yet.");
+	throw std::runtime_error("Not implemented yet.");
 	//std::shared_ptr<datalane::client_socket> sock =
 	// std::make_shared<datalane::client_socket>(socket);
 	//return std::dynamic_pointer_cast<datalane::socket>(sock);
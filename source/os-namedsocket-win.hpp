@@ -26,7 +26,6 @@
 #include <map>
 #include <mutex>
 #include <thread>
-#include <queue>
 #include <list>
 extern "C" { // clang++ compatible
 #define NOMINMAX
@@ -99,10 +98,6 @@ namespace os {
 		bool m_stopWorkers = false;
 		std::thread m_managerThread;
 
-		std::mutex m_writeLock, m_readLock;
-		std::queue<std::vector<char>>
-			m_writeQueue, m_readQueue;
-
 		// Status
 		bool m_isServer = false;
 		enum class state {
@@ -16,6 +16,8 @@
 */
 
 #include "async_op.hpp"
+#include <stdexcept>
+#include <utility>
 
 void os::async_op::set_callback(async_op_cb_t u_callback) {
 	if (is_valid()) {
@@ -34,5 +36,20 @@ void os::async_op::set_system_callback(async_op_cb_t u_callback) {
 		}
 	}
 
-	system.callback = u_callback;
+	system.callback = std::move(u_callback);
+}
+
+void os::async_op::on_deadline(void *data) {
+	os::async_op *op = static_cast<os::async_op *>(data);
+	if (op->is_valid()) {
+		op->time_out();
+	}
+}
+
+void os::async_op::set_deadline(os::timer_wheel &wheel, std::chrono::nanoseconds timeout) {
+	wheel.schedule(deadline, timeout);
+}
+
+void os::async_op::clear_deadline() {
+	deadline.cancel();
 }
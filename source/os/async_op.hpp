@@ -21,6 +21,7 @@
 #include <functional>
 #include <inttypes.h>
 #include "error.hpp"
+#include "timer-wheel.hpp"
 #include "waitable.hpp"
 
 namespace os {
@@ -36,11 +37,19 @@ namespace os {
 			bool          callback_called = false;
 		} system;
 
+		// Entry in the timer wheel passed to set_deadline().
+		os::timer_wheel::entry deadline;
+
+		static void on_deadline(void *data);
+
 		virtual void *get_waitable() override = 0;
 
+		// Complete a request that is still pending with os::error::TimedOut, returns false if it can't be.
+		virtual bool time_out() = 0;
+
 		public:
-		async_op(){};
-		async_op(async_op_cb_t u_callback) : callback(u_callback){};
+		async_op() : deadline(&on_deadline, this){};
+		async_op(async_op_cb_t u_callback) : callback(u_callback), deadline(&on_deadline, this){};
 		virtual ~async_op(){};
 
 		virtual bool is_valid() = 0;
@@ -60,6 +69,12 @@ namespace os {
 		virtual void call_callback() = 0;
 
 		virtual void call_callback(os::error ec, size_t length) = 0;
+
+		// Time the request out once 'timeout' passed, when 'wheel' expires it. Requests that already moved data
+		///  are left to finish so that the message stream stays intact. Reissuing the request clears the deadline.
+		void set_deadline(os::timer_wheel &wheel, std::chrono::nanoseconds timeout);
+
+		void clear_deadline();
 	};
 } // namespace os
 
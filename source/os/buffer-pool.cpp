@@ -0,0 +1,155 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "buffer-pool.hpp"
+#include <cstring>
+
+static size_t size_class(size_t size, size_t &capacity) {
+	size_t bits = 6;
+	while ((size_t(1) << bits) < size) {
+		bits++;
+	}
+	capacity = size_t(1) << bits;
+	return bits - 6;
+}
+
+#pragma region Buffer
+os::buffer_pool::buffer::buffer(buffer_pool *owner, char *memory, size_t length, size_t capacity)
+	: owner(owner), memory(memory), length(length), capacity(capacity) {}
+
+os::buffer_pool::buffer::~buffer() {
+	release();
+}
+
+os::buffer_pool::buffer::buffer(buffer &&other)
+	: owner(other.owner), memory(other.memory), length(other.length), capacity(other.capacity) {
+	other.owner    = nullptr;
+	other.memory   = nullptr;
+	other.length   = 0;
+	other.capacity = 0;
+}
+
+os::buffer_pool::buffer &os::buffer_pool::buffer::operator=(buffer &&other) {
+	if (this != &other) {
+		release();
+		owner          = other.owner;
+		memory         = other.memory;
+		length         = other.length;
+		capacity       = other.capacity;
+		other.owner    = nullptr;
+		other.memory   = nullptr;
+		other.length   = 0;
+		other.capacity = 0;
+	}
+	return *this;
+}
+
+char *os::buffer_pool::buffer::data() {
+	return memory;
+}
+
+const char *os::buffer_pool::buffer::data() const {
+	return memory;
+}
+
+size_t os::buffer_pool::buffer::size() const {
+	return length;
+}
+
+size_t os::buffer_pool::buffer::get_capacity() const {
+	return capacity;
+}
+
+bool os::buffer_pool::buffer::empty() const {
+	return length == 0;
+}
+
+void os::buffer_pool::buffer::resize(size_t size) {
+	length = size < capacity ? size : capacity;
+}
+
+void os::buffer_pool::buffer::release() {
+	if (memory) {
+		if (owner) {
+			owner->give_back(memory, capacity);
+		} else {
+			delete[] memory;
+		}
+	}
+	owner    = nullptr;
+	memory   = nullptr;
+	length   = 0;
+	capacity = 0;
+}
+#pragma endregion Buffer
+
+os::buffer_pool::buffer_pool(size_t max_cached) : max_cached(max_cached) {}
+
+os::buffer_pool::~buffer_pool() {
+	trim();
+}
+
+void os::buffer_pool::give_back(char *memory, size_t capacity) {
+	size_t ignored;
+	size_t index = size_class(capacity, ignored);
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		if (index < class_count && cached + capacity <= max_cached) {
+			std::memcpy(memory, &free_lists[index], sizeof(char *));
+			free_lists[index] = memory;
+			cached += capacity;
+			return;
+		}
+	}
+	delete[] memory;
+}
+
+os::buffer_pool::buffer os::buffer_pool::acquire(size_t size) {
+	if (size == 0) {
+		return buffer();
+	}
+
+	size_t capacity;
+	size_t index = size_class(size, capacity);
+
+	if (index < class_count) {
+		std::unique_lock<std::mutex> ul(lock);
+		if (char *memory = free_lists[index]) {
+			std::memcpy(&free_lists[index], memory, sizeof(char *));
+			cached -= capacity;
+			return buffer(this, memory, size, capacity);
+		}
+	}
+	return buffer(this, new char[capacity], size, capacity);
+}
+
+size_t os::buffer_pool::get_cached() {
+	std::unique_lock<std::mutex> ul(lock);
+	return cached;
+}
+
+void os::buffer_pool::trim() {
+	std::unique_lock<std::mutex> ul(lock);
+	for (size_t index = 0; index < class_count; index++) {
+		while (char *memory = free_lists[index]) {
+			std::memcpy(&free_lists[index], memory, sizeof(char *));
+			delete[] memory;
+		}
+	}
+	cached = 0;
+}
@@ -0,0 +1,99 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_BUFFER_POOL_HPP
+#define OS_BUFFER_POOL_HPP
+
+#include <inttypes.h>
+#include <mutex>
+
+namespace os {
+	// Reusable memory for received messages.
+	/// Capacities are rounded up to a power of two and released buffers are kept per size class, up to 'max_cached'
+	///  bytes in total, so that steady traffic of similar sizes stops allocating after the first few messages.
+	/// Thread safe. The pool must outlive every buffer acquired from it.
+	class buffer_pool {
+		public:
+		class buffer {
+			buffer_pool *owner    = nullptr;
+			char *       memory   = nullptr;
+			size_t       length   = 0;
+			size_t       capacity = 0;
+
+			buffer(buffer_pool *owner, char *memory, size_t length, size_t capacity);
+
+			public:
+			buffer(){};
+			~buffer();
+
+			buffer(buffer &&other);
+			buffer &operator=(buffer &&other);
+
+			buffer(const buffer &) = delete;
+			buffer &operator=(const buffer &) = delete;
+
+			char *data();
+
+			const char *data() const;
+
+			size_t size() const;
+
+			size_t get_capacity() const;
+
+			bool empty() const;
+
+			// Change the size within the capacity.
+			void resize(size_t size);
+
+			// Hand the memory back to the pool now instead of on destruction.
+			void release();
+
+			friend class os::buffer_pool;
+		};
+
+		private:
+		// 64 bytes up to the largest message the length header can describe.
+		static const size_t minimum_bits = 6;
+		static const size_t class_count  = 33 - minimum_bits;
+
+		std::mutex lock;
+		// Singly linked through the first bytes of each cached block.
+		char * free_lists[class_count] = {};
+		size_t cached                  = 0;
+		size_t max_cached;
+
+		void give_back(char *memory, size_t capacity);
+
+		public:
+		buffer_pool(size_t max_cached = 16 * 1024 * 1024);
+		~buffer_pool();
+
+		buffer_pool(const buffer_pool &) = delete;
+		buffer_pool &operator=(const buffer_pool &) = delete;
+
+		// A buffer of exactly 'size' bytes, cached memory is reused where possible.
+		buffer acquire(size_t size);
+
+		// Bytes currently held for reuse.
+		size_t get_cached();
+
+		// Free all cached memory.
+		void trim();
+	};
+} // namespace os
+
+#endif // OS_BUFFER_POOL_HPP
@@ -0,0 +1,217 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "buffer-tuner.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stdlib.h>
+
+namespace {
+	struct tuner_state {
+		std::mutex               lock;
+		os::buffer_tuner::limits limits;
+		bool                     checked_environment = false;
+		size_t                   reserved            = 0;
+		os::buffer_tuner *       head                = nullptr;
+	};
+
+	tuner_state &get_state() {
+		static tuner_state state;
+		return state;
+	}
+
+	void check_environment(tuner_state &state) {
+		if (state.checked_environment) {
+			return;
+		}
+		state.checked_environment = true;
+		const char *value         = getenv("DATALANE_BUFFER_TUNING");
+		if (value && (atoi(value) > 0)) {
+			state.limits.enabled = true;
+		}
+	}
+} // namespace
+
+void os::buffer_tuner::set_limits(const limits &value) {
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	state.checked_environment = true;
+	state.limits              = value;
+}
+
+os::buffer_tuner::limits os::buffer_tuner::get_limits() {
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	check_environment(state);
+	return state.limits;
+}
+
+size_t os::buffer_tuner::get_reserved() {
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	return state.reserved;
+}
+
+os::buffer_tuner::buffer_tuner() : last_activity(0), reclaimed(false) {}
+
+os::buffer_tuner::~buffer_tuner() {
+	stop();
+}
+
+size_t os::buffer_tuner::start() {
+	stop();
+
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	check_environment(state);
+	if (!state.limits.enabled) {
+		return 0;
+	}
+
+	// Every connection gets the minimum, even beyond the total.
+	clock::time_point now = clock::now();
+	active                = true;
+	size                  = state.limits.minimum;
+	applied               = size;
+	interval              = state.limits.interval;
+	state.reserved += size;
+
+	window_start   = now;
+	window_bytes   = 0;
+	window_writes  = 0;
+	window_latency = 0;
+	window_largest = 0;
+	window_blocked = false;
+	last_activity.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+	reclaimed.store(false, std::memory_order_relaxed);
+
+	prev = nullptr;
+	next = state.head;
+	if (state.head) {
+		state.head->prev = this;
+	}
+	state.head = this;
+	return size;
+}
+
+void os::buffer_tuner::stop() {
+	if (!active) {
+		return;
+	}
+
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	state.reserved -= size;
+	if (prev) {
+		prev->next = next;
+	} else {
+		state.head = next;
+	}
+	if (next) {
+		next->prev = prev;
+	}
+	prev = next = nullptr;
+	active      = false;
+	size        = 0;
+	applied     = 0;
+}
+
+bool os::buffer_tuner::is_active() {
+	return active;
+}
+
+size_t os::buffer_tuner::get_size() {
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	return active ? size : 0;
+}
+
+size_t os::buffer_tuner::on_send(size_t bytes, bool blocked, size_t message_length) {
+	clock::time_point now = clock::now();
+	window_bytes += bytes;
+	window_blocked = window_blocked || blocked;
+	window_largest = std::max(window_largest, message_length);
+	last_activity.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+	if (((now - window_start) < interval) && !reclaimed.load(std::memory_order_relaxed)) {
+		return 0;
+	}
+	return evaluate(now);
+}
+
+void os::buffer_tuner::on_complete(std::chrono::nanoseconds latency) {
+	window_writes++;
+	window_latency += uint64_t(std::max<int64_t>(latency.count(), 0));
+}
+
+size_t os::buffer_tuner::evaluate(clock::time_point now) {
+	tuner_state &                state = get_state();
+	std::unique_lock<std::mutex> ul(state.lock);
+	const limits &               lim = state.limits;
+	interval                         = lim.interval;
+
+	// Bandwidth times the average time a write spent in the buffer, with headroom for bursts.
+	double seconds   = std::chrono::duration<double>(now - window_start).count();
+	double bandwidth = (seconds > 0) ? (double(window_bytes) / seconds) : 0;
+	double delay     = (window_writes > 0) ? (double(window_latency) / double(window_writes) / 1e9) : 0;
+	size_t desired   = size_t(std::min(2.0 * bandwidth * delay, double(lim.maximum)));
+
+	// A full buffer means the estimate was too low, otherwise give memory back gradually.
+	if (window_blocked) {
+		desired = std::max(desired, size * 2);
+	} else {
+		desired = std::max(desired, size / 2);
+	}
+	desired = std::max(desired, window_largest);
+	desired = std::min(std::max(desired, lim.minimum), lim.maximum);
+
+	if (desired > size) {
+		size_t wanted = desired - size;
+		if ((state.reserved + wanted) > lim.total) {
+			int64_t now_count  = now.time_since_epoch().count();
+			int64_t idle_count = std::chrono::duration_cast<clock::duration>(lim.idle).count();
+			for (buffer_tuner *other = state.head; other && ((state.reserved + wanted) > lim.total);
+				 other               = other->next) {
+				if ((other == this) || (other->size <= lim.minimum)
+					|| ((now_count - other->last_activity.load(std::memory_order_relaxed)) < idle_count)) {
+					continue;
+				}
+				state.reserved -= other->size - lim.minimum;
+				other->size = lim.minimum;
+				other->reclaimed.store(true, std::memory_order_relaxed);
+			}
+		}
+		size_t room = (lim.total > state.reserved) ? (lim.total - state.reserved) : 0;
+		desired     = size + std::min(wanted, room);
+	}
+	state.reserved = state.reserved - size + desired;
+	size           = desired;
+	reclaimed.store(false, std::memory_order_relaxed);
+
+	window_start   = now;
+	window_bytes   = 0;
+	window_writes  = 0;
+	window_latency = 0;
+	window_largest = 0;
+	window_blocked = false;
+
+	if (size == applied) {
+		return 0;
+	}
+	applied = size;
+	return size;
+}
@@ -0,0 +1,112 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_BUFFER_TUNER_HPP
+#define OS_BUFFER_TUNER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+
+namespace os {
+	// Sizes the kernel send buffer of one connection from its observed traffic.
+	/// Once per interval the bandwidth-delay product is estimated from the bytes sent and the average time a write
+	///  took to complete. Connections whose writes blocked grow to at least twice their size, the others shrink by at
+	///  most half towards twice the estimate, and no buffer is smaller than the largest recent message. All tuned
+	///  connections together stay within limits::total: when a connection needs room to grow, those without writes for
+	///  limits::idle are dropped to limits::minimum first, which they apply on their next write.
+	/// Tuning is off by default, it is enabled with set_limits() or by setting the environment variable
+	///  DATALANE_BUFFER_TUNING to 1 before the first pipe connects. Only connections made afterwards are tuned.
+	/// Not thread safe on its own, the owning pipe serializes all calls except the static ones.
+	class buffer_tuner {
+		public:
+		struct limits {
+			bool enabled = false;
+			// Sizes as passed to the system, Linux doubles them for bookkeeping and clamps them to
+			//  net.core.wmem_max.
+			size_t minimum = 64 * 1024;
+			size_t maximum = 16 * 1024 * 1024;
+			// Over all tuned connections of the process.
+			size_t                    total    = 256 * 1024 * 1024;
+			std::chrono::milliseconds interval = std::chrono::milliseconds(100);
+			std::chrono::milliseconds idle     = std::chrono::milliseconds(1000);
+		};
+
+		static void set_limits(const limits &value);
+
+		static limits get_limits();
+
+		// Sum of the sizes of all tuned connections.
+		static size_t get_reserved();
+
+		private:
+		typedef std::chrono::steady_clock clock;
+
+		bool   active = false;
+		// Guarded by the global lock, other connections may lower it.
+		size_t size = 0;
+		// Last size handed out to the owner.
+		size_t                    applied  = 0;
+		std::chrono::milliseconds interval = std::chrono::milliseconds(0);
+
+		// Current interval.
+		clock::time_point window_start;
+		uint64_t          window_bytes   = 0;
+		uint64_t          window_writes  = 0;
+		uint64_t          window_latency = 0;
+		size_t            window_largest = 0;
+		bool              window_blocked = false;
+
+		// Written by the owner, read by other connections looking for idle ones.
+		std::atomic<int64_t> last_activity;
+		// Set by another connection that took this one's share.
+		std::atomic<bool> reclaimed;
+
+		// Registry of active tuners, guarded by the global lock.
+		buffer_tuner *prev = nullptr;
+		buffer_tuner *next = nullptr;
+
+		size_t evaluate(clock::time_point now);
+
+		public:
+		buffer_tuner();
+		~buffer_tuner();
+
+		buffer_tuner(const buffer_tuner &) = delete;
+		buffer_tuner &operator=(const buffer_tuner &) = delete;
+
+		// Start tuning a new connection if enabled, returns the size to apply or 0 to keep the fixed size.
+		size_t start();
+
+		// The connection closed, give its share back.
+		void stop();
+
+		bool is_active();
+
+		// Size the connection should currently have, 0 if not tuned.
+		size_t get_size();
+
+		// A send accepted 'bytes' of a message of 'message_length' bytes, or 'blocked' because the buffer was full.
+		//  Returns the size to apply now, or 0 if it stays as it is.
+		size_t on_send(size_t bytes, bool blocked, size_t message_length);
+
+		// A write completed 'latency' after it was issued.
+		void on_complete(std::chrono::nanoseconds latency);
+	};
+} // namespace os
+
+#endif // OS_BUFFER_TUNER_HPP
@@ -0,0 +1,326 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "capture.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint64_t record_alignment = 8;
+static const uint64_t default_capacity = 256ull * 1024 * 1024;
+
+static uint64_t get_header_size() {
+	// Keep the first record on its own cache line.
+	return (sizeof(os::capture::file_header) + 63) & ~uint64_t(63);
+}
+
+static uint64_t get_timestamp() {
+	return uint64_t(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+			.count());
+}
+
+#pragma region Writer
+os::capture::writer::writer(std::string path, uint64_t capacity, uint32_t sample_every, uint64_t snap_length)
+	: path(path)
+{
+	if (capacity < get_header_size() + sizeof(record_header)) {
+		throw std::invalid_argument("capacity too small");
+	}
+	if (sample_every == 0) {
+		sample_every = 1;
+	}
+	size = capacity;
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+					   FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw std::runtime_error("failed to create capture file");
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, DWORD(size >> 32), DWORD(size & 0xFFFFFFFF), NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size_t(size));
+	if (!memory) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+#else
+	file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (file < 0) {
+		throw std::runtime_error("failed to create capture file");
+	}
+	if (ftruncate(file, off_t(size)) != 0) {
+		close(file);
+		throw std::runtime_error("failed to size capture file");
+	}
+	memory = mmap(nullptr, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (memory == MAP_FAILED) {
+		close(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+#endif
+
+	head                     = reinterpret_cast<file_header *>(memory);
+	head->version            = version;
+	head->header_size        = uint16_t(get_header_size());
+	head->record_header_size = uint32_t(sizeof(record_header));
+	head->sample_every       = sample_every;
+	head->snap_length        = snap_length;
+	head->capacity           = size;
+	head->start_time         = get_timestamp();
+	head->start_system_time  = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::system_clock::now().time_since_epoch())
+                                           .count());
+	head->tail.store(get_header_size(), std::memory_order_relaxed);
+	head->records.store(0, std::memory_order_relaxed);
+	head->dropped.store(0, std::memory_order_relaxed);
+	head->seen.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	head->magic = magic;
+}
+
+os::capture::writer::~writer() {
+	uint64_t used = std::min(head->tail.load(std::memory_order_acquire), size);
+
+#ifdef _WIN32
+	UnmapViewOfFile(memory);
+	CloseHandle(mapping);
+	// Drop the unused tail of the file.
+	LARGE_INTEGER pos;
+	pos.QuadPart = LONGLONG(used);
+	if (SetFilePointerEx(file, pos, NULL, FILE_BEGIN)) {
+		SetEndOfFile(file);
+	}
+	CloseHandle(file);
+#else
+	munmap(memory, size_t(size));
+	if (ftruncate(file, off_t(used)) != 0) {
+		// The file stays at full size, readers stop at 'tail' anyway.
+	}
+	close(file);
+#endif
+}
+
+bool os::capture::writer::append(direction dir, uint32_t lane, const char *data, size_t length, os::error result,
+								 std::chrono::nanoseconds latency) {
+	if ((head->seen.fetch_add(1, std::memory_order_relaxed) % head->sample_every) != 0) {
+		return false;
+	}
+
+	size_t captured = length;
+	if ((head->snap_length > 0) && (captured > head->snap_length)) {
+		captured = size_t(head->snap_length);
+	}
+	if (!data) {
+		captured = 0;
+	}
+	uint64_t record_length = (sizeof(record_header) + captured + record_alignment - 1) & ~(record_alignment - 1);
+	if (record_length > UINT32_MAX) {
+		head->dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint64_t offset = head->tail.fetch_add(record_length, std::memory_order_relaxed);
+	if (offset + record_length > size) {
+		head->dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	char *         base = reinterpret_cast<char *>(memory) + offset;
+	record_header *rec  = reinterpret_cast<record_header *>(base);
+	rec->dir             = dir;
+	rec->result          = int8_t(result);
+	rec->reserved        = 0;
+	rec->lane            = lane;
+	rec->message_length  = uint32_t(std::min<size_t>(length, UINT32_MAX));
+	rec->captured_length = uint32_t(captured);
+	rec->reserved2       = 0;
+	rec->timestamp       = get_timestamp();
+	rec->latency         = uint64_t(latency.count());
+	if (captured > 0) {
+		memcpy(base + sizeof(record_header), data, captured);
+	}
+	rec->length.store(uint32_t(record_length), std::memory_order_release);
+	head->records.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+uint64_t os::capture::writer::get_records() {
+	return head->records.load(std::memory_order_relaxed);
+}
+
+uint64_t os::capture::writer::get_dropped() {
+	return head->dropped.load(std::memory_order_relaxed);
+}
+
+std::string os::capture::writer::get_path() {
+	return path;
+}
+#pragma endregion Writer
+
+std::shared_ptr<os::capture::writer> os::capture::get_default() {
+	static std::once_flag                       once;
+	static std::shared_ptr<os::capture::writer> instance;
+
+	std::call_once(once, []() {
+		const char *path = getenv("DATALANE_CAPTURE");
+		if (!path || (path[0] == '\0')) {
+			return;
+		}
+		const char *sample   = getenv("DATALANE_CAPTURE_SAMPLE");
+		const char *capacity = getenv("DATALANE_CAPTURE_SIZE");
+		try {
+			instance = std::make_shared<os::capture::writer>(
+				path, capacity ? strtoull(capacity, nullptr, 10) : default_capacity,
+				sample ? uint32_t(strtoul(sample, nullptr, 10)) : 1);
+		} catch (...) {
+			// Capturing is a debugging aid, never fail the application over it.
+			instance = nullptr;
+		}
+	});
+	return instance;
+}
+
+uint32_t os::capture::next_lane() {
+	static std::atomic<uint32_t> counter(0);
+	return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+#pragma region Reader
+os::capture::reader::reader(std::string path) {
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+					   FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw std::runtime_error("failed to open capture file");
+	}
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length)) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to open capture file");
+	}
+	size = uint64_t(length.QuadPart);
+	if (size < sizeof(file_header)) {
+		CloseHandle(file);
+		throw std::runtime_error("not a capture file");
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size_t(size));
+	if (!memory) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+#else
+	file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0) {
+		throw std::runtime_error("failed to open capture file");
+	}
+	struct stat st;
+	if (fstat(file, &st) != 0) {
+		close(file);
+		throw std::runtime_error("failed to open capture file");
+	}
+	size = uint64_t(st.st_size);
+	if (size < sizeof(file_header)) {
+		close(file);
+		throw std::runtime_error("not a capture file");
+	}
+	memory = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, file, 0);
+	if (memory == MAP_FAILED) {
+		close(file);
+		throw std::runtime_error("failed to map capture file");
+	}
+#endif
+
+	head = reinterpret_cast<file_header *>(memory);
+	if ((head->magic != magic) || (head->version != version) || (head->header_size > size)
+		|| (head->record_header_size != sizeof(record_header))) {
+		unmap();
+		throw std::runtime_error("not a capture file or unsupported version");
+	}
+	end = std::min(head->tail.load(std::memory_order_acquire), size);
+}
+
+os::capture::reader::~reader() {
+	unmap();
+}
+
+void os::capture::reader::unmap() {
+	if (!memory) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(memory);
+	CloseHandle(mapping);
+	CloseHandle(file);
+#else
+	munmap(memory, size_t(size));
+	close(file);
+#endif
+	memory = nullptr;
+}
+
+const os::capture::file_header &os::capture::reader::get_header() {
+	return *head;
+}
+
+uint64_t os::capture::reader::begin() {
+	return head->header_size;
+}
+
+bool os::capture::reader::next(uint64_t &offset, entry &out) {
+	if (offset + sizeof(record_header) > end) {
+		return false;
+	}
+
+	const char *         base = reinterpret_cast<const char *>(memory) + offset;
+	const record_header *rec  = reinterpret_cast<const record_header *>(base);
+	uint32_t             length = rec->length.load(std::memory_order_acquire);
+	if ((length < sizeof(record_header)) || (offset + length > end)
+		|| (sizeof(record_header) + uint64_t(rec->captured_length) > length)) {
+		// Unpublished or damaged record.
+		return false;
+	}
+
+	out.header = rec;
+	out.data   = base + sizeof(record_header);
+	offset += length;
+	return true;
+}
+#pragma endregion Reader
@@ -0,0 +1,159 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_CAPTURE_HPP
+#define OS_CAPTURE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#include "error.hpp"
+
+namespace os {
+	// Traffic capture into a memory mapped file, for datalane-dump and datalane-replay.
+	/// Appends are lock-free: a writer reserves space by advancing the shared tail, fills in the record and then
+	///  publishes it by storing its length last. A record that was reserved but never published (the process died
+	///  in between) ends the readable part of the file. Once the file is full further messages are only counted.
+	/// Pipes capture into the writer set with set_capture(), or into a process wide writer that is created from
+	///  the environment variables DATALANE_CAPTURE (file path), DATALANE_CAPTURE_SAMPLE (capture every Nth
+	///  message, default 1) and DATALANE_CAPTURE_SIZE (file size in bytes, default 256MB).
+	namespace capture {
+		static const uint32_t magic   = 0x50434C44; // "DLCP"
+		static const uint16_t version = 1;
+
+		enum class direction : uint8_t {
+			In  = 0,
+			Out = 1,
+		};
+
+		struct file_header {
+			uint32_t magic;
+			uint16_t version;
+			uint16_t header_size;
+			uint32_t record_header_size;
+			// Only every Nth message is captured.
+			uint32_t sample_every;
+			// Messages are truncated to this many bytes, 0 captures them completely.
+			uint64_t snap_length;
+			uint64_t capacity;
+			// Monotonic and wall clock time at creation, record timestamps are monotonic.
+			uint64_t start_time;
+			uint64_t start_system_time;
+			// Offset of the next record, may be beyond capacity once the file is full.
+			std::atomic<uint64_t> tail;
+			std::atomic<uint64_t> records;
+			// Messages that were sampled but did not fit anymore.
+			std::atomic<uint64_t> dropped;
+			// Messages seen, including the ones skipped by sampling.
+			std::atomic<uint64_t> seen;
+		};
+
+		struct record_header {
+			// Size of the record including this header and padding, written last. 0 if not published yet.
+			std::atomic<uint32_t> length;
+			direction             dir;
+			int8_t                result;
+			uint16_t              reserved;
+			// Caller defined connection or lane identifier.
+			uint32_t lane;
+			// Size of the message and how much of it follows the header.
+			uint32_t message_length;
+			uint32_t captured_length;
+			uint32_t reserved2;
+			// Monotonic time of completion in nanoseconds.
+			uint64_t timestamp;
+			// Time from submission to completion in nanoseconds.
+			uint64_t latency;
+		};
+
+		class writer {
+			void *       memory = nullptr;
+			file_header *head   = nullptr;
+			uint64_t     size   = 0;
+			std::string  path;
+#ifdef _WIN32
+			void *file    = nullptr;
+			void *mapping = nullptr;
+#else
+			int file = -1;
+#endif
+
+			public:
+			writer(std::string path, uint64_t capacity, uint32_t sample_every = 1, uint64_t snap_length = 0);
+			~writer();
+
+			writer(const writer &) = delete;
+			writer &operator=(const writer &) = delete;
+
+			// Capture a completed message, returns false if it was not sampled or the file is full.
+			bool append(direction dir, uint32_t lane, const char *data, size_t length, os::error result,
+						std::chrono::nanoseconds latency);
+
+			uint64_t get_records();
+
+			uint64_t get_dropped();
+
+			std::string get_path();
+		};
+
+		// Writer configured through the environment, nullptr if capturing is not enabled.
+		std::shared_ptr<writer> get_default();
+
+		// Identifier for a connection that has no lane of its own.
+		uint32_t next_lane();
+
+		// Sequential view of a capture file.
+		class reader {
+			void *       memory = nullptr;
+			file_header *head   = nullptr;
+			uint64_t     size   = 0;
+			uint64_t     end    = 0;
+#ifdef _WIN32
+			void *file    = nullptr;
+			void *mapping = nullptr;
+#else
+			int file = -1;
+#endif
+
+			void unmap();
+
+			public:
+			struct entry {
+				const record_header *header;
+				const char *         data;
+			};
+
+			reader(std::string path);
+			~reader();
+
+			reader(const reader &) = delete;
+			reader &operator=(const reader &) = delete;
+
+			const file_header &get_header();
+
+			// Offset of the first record, for next().
+			uint64_t begin();
+
+			// Record at 'offset', which is advanced to the next one. False at the end of the readable data.
+			bool next(uint64_t &offset, entry &out);
+		};
+	} // namespace capture
+} // namespace os
+
+#endif // OS_CAPTURE_HPP
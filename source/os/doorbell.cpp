@@ -0,0 +1,44 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "doorbell.hpp"
+
+os::error os::doorbell::ring(uint32_t count /*= 1*/) {
+	if (count == 0) {
+		return os::error::Success;
+	}
+
+	// Both sides write their own flag before reading the other's, so either the consumer sees these rings when it
+	//  arms, or this sees the doorbell armed.
+	state->rings.fetch_add(count, std::memory_order_seq_cst);
+	if ((state->armed.load(std::memory_order_seq_cst) == 0) || (state->armed.exchange(0) == 0)) {
+		return os::error::Success;
+	}
+	return post();
+}
+
+uint64_t os::doorbell::take() {
+	uint64_t rings = state->rings.exchange(0, std::memory_order_acquire);
+	if (rings > 0) {
+		return rings;
+	}
+
+	// Rings racing with this may have seen the doorbell armed and posted already, the consumer then wakes up once
+	//  for nothing.
+	state->armed.store(1, std::memory_order_seq_cst);
+	return state->rings.exchange(0, std::memory_order_seq_cst);
+}
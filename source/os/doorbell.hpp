@@ -0,0 +1,69 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_DOORBELL_HPP
+#define OS_DOORBELL_HPP
+
+#include <atomic>
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#include "error.hpp"
+#include "tags.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	// Semaphore for announcing messages that coalesces signals while the consumer is busy.
+	/// Producers ring() once per message, which only adds to a counter in memory shared with the consumer. The
+	///  kernel is entered only for the first ring after the consumer armed the doorbell, which it does when take()
+	///  finds nothing left, right before it goes to sleep. A burst of messages therefore costs a single system call
+	///  instead of one per message.
+	/// The consumer waits on the doorbell like on any other waitable, then calls take() until it returns 0, and
+	///  only then waits again. Rings that arrive meanwhile are collected by take() without waking anybody.
+	/// Named doorbells keep their counter in shared memory and work across processes. The creator owns the
+	///  shared memory and kernel object and removes them again on POSIX.
+	class doorbell : public os::waitable {
+		protected:
+		struct shared_state {
+			std::atomic<uint64_t> rings;
+			// Set while the consumer might be asleep, whoever clears it wakes the consumer up.
+			std::atomic<uint32_t> armed;
+		};
+
+		shared_state *state = nullptr;
+
+		// Wake the consumer up.
+		virtual os::error post() = 0;
+
+		public:
+		virtual ~doorbell(){};
+
+		// Announce 'count' messages.
+		os::error ring(uint32_t count = 1);
+
+		// Rings since the last take(). Arms the doorbell once there are none left.
+		uint64_t take();
+
+		public:
+		static std::shared_ptr<os::doorbell> construct();
+		static std::shared_ptr<os::doorbell> construct(os::create_only_t, std::string name);
+		static std::shared_ptr<os::doorbell> construct(os::create_or_open_t, std::string name);
+		static std::shared_ptr<os::doorbell> construct(os::open_only_t, std::string name);
+	};
+} // namespace os
+
+#endif // OS_DOORBELL_HPP
@@ -63,6 +63,9 @@ namespace os {
 
 		// Buffer Overflow
 		BufferOverflow,
+
+		// Can't be done without waiting, try again once the pipe is ready.
+		WouldBlock,
 	};
 }
 
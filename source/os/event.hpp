@@ -0,0 +1,47 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_EVENT_HPP
+#define OS_EVENT_HPP
+
+#include <memory>
+#include <string>
+#include "error.hpp"
+#include "tags.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	// Event like on Windows: once set it stays signalled until reset() (manual reset), or until a wait consumed it
+	///  (auto reset). Setting it more than once before that does nothing, which makes it a cheap way to kick a
+	///  thread that waits on I/O.
+	class event : public os::waitable {
+		public:
+		virtual os::error set() = 0;
+
+		virtual os::error reset() = 0;
+
+		public:
+		static std::shared_ptr<os::event> construct(bool manual_reset = false, bool initial_state = false);
+		static std::shared_ptr<os::event> construct(os::create_only_t, std::string name, bool manual_reset = false,
+													bool initial_state = false);
+		static std::shared_ptr<os::event> construct(os::create_or_open_t, std::string name,
+													bool manual_reset = false, bool initial_state = false);
+		static std::shared_ptr<os::event> construct(os::open_only_t, std::string name);
+	};
+} // namespace os
+
+#endif // OS_EVENT_HPP
@@ -0,0 +1,228 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "histogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+size_t os::histogram::index_of(uint64_t value) const {
+	uint64_t sub_bucket_count = uint64_t(1) << precision;
+	if (value < sub_bucket_count) {
+		return size_t(value);
+	}
+
+	// Position of the highest set bit, which selects the power of two bucket.
+#ifdef _MSC_VER
+	unsigned long magnitude;
+	_BitScanReverse64(&magnitude, value);
+#else
+	size_t magnitude = 63 - size_t(__builtin_clzll(value));
+#endif
+	if (size_t(magnitude) >= max_magnitude) {
+		return bucket_count() - 1;
+	}
+	size_t shift = size_t(magnitude) - precision;
+	return (shift << precision) + size_t(value >> shift);
+}
+
+uint64_t os::histogram::highest_of(size_t index) const {
+	size_t sub_bucket_count = size_t(1) << precision;
+	if (index < (sub_bucket_count * 2)) {
+		return uint64_t(index);
+	}
+
+	size_t   shift = (index >> precision) - 1;
+	uint64_t base  = uint64_t((index & (sub_bucket_count - 1)) + sub_bucket_count) << shift;
+	return base + ((uint64_t(1) << shift) - 1);
+}
+
+size_t os::histogram::bucket_count() const {
+	return (max_magnitude - precision + 1) << precision;
+}
+
+uint64_t &os::histogram::get_bucket(size_t index) {
+	if (rows.empty()) {
+		rows.resize(bucket_count() >> precision);
+	}
+	std::vector<uint64_t> &row = rows[index >> precision];
+	if (row.empty()) {
+		row.resize(size_t(1) << precision, 0);
+	}
+	return row[index & ((size_t(1) << precision) - 1)];
+}
+
+uint64_t os::histogram::get_bucket(size_t index) const {
+	if (rows.empty() || rows[index >> precision].empty()) {
+		return 0;
+	}
+	return rows[index >> precision][index & ((size_t(1) << precision) - 1)];
+}
+
+os::histogram::histogram(size_t precision) : precision(precision) {
+	if ((precision < 1) || (precision > 16)) {
+		throw std::invalid_argument("'precision' must be between 1 and 16.");
+	}
+}
+
+void os::histogram::record(std::chrono::nanoseconds value) {
+	uint64_t v = (value.count() > 0) ? uint64_t(value.count()) : 0;
+	if (calls == 0) {
+		smallest = v;
+		largest  = v;
+	}
+
+	get_bucket(index_of(v))++;
+	calls++;
+	sum += v;
+	if (v < smallest) {
+		smallest = v;
+	}
+	if (v > largest) {
+		largest = v;
+	}
+}
+
+void os::histogram::preallocate() {
+	for (size_t idx = 0; idx < bucket_count(); idx += (size_t(1) << precision)) {
+		get_bucket(idx);
+	}
+}
+
+void os::histogram::merge(const histogram &other) {
+	if (other.precision != precision) {
+		throw std::invalid_argument("Histograms of different precision can't be merged.");
+	} else if (other.calls == 0) {
+		return;
+	}
+
+	if (calls == 0) {
+		smallest = other.smallest;
+		largest  = other.largest;
+	}
+	for (size_t row = 0; row < other.rows.size(); row++) {
+		const std::vector<uint64_t> &source = other.rows[row];
+		for (size_t sub = 0; sub < source.size(); sub++) {
+			if (source[sub] != 0) {
+				get_bucket((row << precision) + sub) += source[sub];
+			}
+		}
+	}
+	calls += other.calls;
+	sum += other.sum;
+	if (other.smallest < smallest) {
+		smallest = other.smallest;
+	}
+	if (other.largest > largest) {
+		largest = other.largest;
+	}
+}
+
+void os::histogram::reset() {
+	// Keeps the buckets, whoever resets is likely to record again.
+	for (std::vector<uint64_t> &row : rows) {
+		std::fill(row.begin(), row.end(), 0);
+	}
+	calls    = 0;
+	sum      = 0;
+	smallest = 0;
+	largest  = 0;
+}
+
+uint64_t os::histogram::count() const {
+	return calls;
+}
+
+std::chrono::nanoseconds os::histogram::total() const {
+	return std::chrono::nanoseconds(sum);
+}
+
+std::chrono::nanoseconds os::histogram::min() const {
+	return std::chrono::nanoseconds(smallest);
+}
+
+std::chrono::nanoseconds os::histogram::max() const {
+	return std::chrono::nanoseconds(largest);
+}
+
+double os::histogram::average() const {
+	if (calls == 0) {
+		return 0;
+	}
+	return double(sum) / double(calls);
+}
+
+std::chrono::nanoseconds os::histogram::percentile(double pct) const {
+	if (calls == 0) {
+		return std::chrono::nanoseconds(0);
+	} else if (pct <= 0.0) {
+		return std::chrono::nanoseconds(smallest);
+	} else if (pct >= 1.0) {
+		return std::chrono::nanoseconds(largest);
+	}
+
+	// Nearest rank, resolved to the highest value of the bucket and clamped to the known extremes.
+	uint64_t rank = uint64_t(std::ceil(pct * double(calls)));
+	uint64_t accu = 0;
+	for (size_t idx = 0; idx < bucket_count(); idx++) {
+		accu += get_bucket(idx);
+		if (accu >= rank) {
+			uint64_t value = std::min(std::max(highest_of(idx), smallest), largest);
+			return std::chrono::nanoseconds(value);
+		}
+	}
+	return std::chrono::nanoseconds(largest);
+}
+
+std::chrono::nanoseconds os::histogram::ceiling(std::chrono::nanoseconds value) const {
+	if (calls == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+
+	uint64_t v = (value.count() > 0) ? uint64_t(value.count()) : 0;
+	for (size_t idx = index_of(v); idx < bucket_count(); idx++) {
+		if (get_bucket(idx) != 0) {
+			uint64_t found = std::min(std::max(highest_of(idx), smallest), largest);
+			return std::chrono::nanoseconds(found);
+		}
+	}
+	return std::chrono::nanoseconds(largest);
+}
+
+os::latency_recorder::latency_recorder() : enabled(false) {}
+
+void os::latency_recorder::record_locked(std::chrono::nanoseconds value) {
+	std::unique_lock<std::mutex> ul(lock);
+	data.record(value);
+}
+
+void os::latency_recorder::enable(bool enabled) {
+	this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+os::histogram os::latency_recorder::get() {
+	std::unique_lock<std::mutex> ul(lock);
+	return data;
+}
+
+void os::latency_recorder::reset() {
+	std::unique_lock<std::mutex> ul(lock);
+	data.reset();
+}
@@ -0,0 +1,140 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_HISTOGRAM_HPP
+#define OS_HISTOGRAM_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <mutex>
+#include <vector>
+
+namespace os {
+	// Operations that the library keeps latency histograms for.
+	enum class latency_type : uint8_t {
+		// From issuing to completion of an operation.
+		Accept,
+		Read,
+		Write,
+		// Time spent blocked in os::waitable until a request of the pipe completed.
+		Wait,
+		// Time spent in user callbacks.
+		Callback,
+
+		_Count
+	};
+
+	// Log-linear latency histogram.
+	/// Values below 2^precision nanoseconds are exact, every power of two above that is split into 2^precision
+	///  linear buckets, which bounds the relative error to 1/2^precision. Buckets are allocated one power of two at a
+	///  time as samples arrive, so empty histograms are cheap to keep and to copy and busy ones only pay for the range
+	///  they use. Not thread safe, threads that record on their own merge their histograms afterwards, see
+	///  os::latency_recorder for one that is shared.
+	class histogram {
+		public:
+		// About 3% error, small enough to keep one per operation type on every pipe.
+		static const size_t default_precision = 5;
+		// Values from 2^40 ns (about 18 minutes) on share the last bucket.
+		static const size_t max_magnitude = 40;
+
+		private:
+		size_t precision;
+		// One row of 2^precision buckets per power of two, empty until a sample lands in it.
+		std::vector<std::vector<uint64_t>> rows;
+		uint64_t                           calls    = 0;
+		uint64_t                           sum      = 0;
+		uint64_t                           smallest = 0;
+		uint64_t                           largest  = 0;
+
+		size_t index_of(uint64_t value) const;
+
+		uint64_t highest_of(size_t index) const;
+
+		size_t bucket_count() const;
+
+		uint64_t &get_bucket(size_t index);
+
+		uint64_t get_bucket(size_t index) const;
+
+		public:
+		// 'precision' is the number of sub-bucket bits, from 1 to 16.
+		histogram(size_t precision = default_precision);
+
+		void record(std::chrono::nanoseconds value);
+
+		// Allocate every bucket now, so that record() never allocates.
+		void preallocate();
+
+		// Add all samples of 'other', which must have the same precision.
+		void merge(const histogram &other);
+
+		void reset();
+
+		uint64_t count() const;
+
+		std::chrono::nanoseconds total() const;
+
+		std::chrono::nanoseconds min() const;
+
+		std::chrono::nanoseconds max() const;
+
+		double average() const;
+
+		// Value below which 'pct' (0.0 to 1.0) of all samples are.
+		std::chrono::nanoseconds percentile(double pct) const;
+
+		// Smallest recorded value at or above 'value', resolved to its bucket.
+		std::chrono::nanoseconds ceiling(std::chrono::nanoseconds value) const;
+	};
+
+	// Latency histogram that any thread can record to, off until enabled.
+	/// Disabled, record() is a single relaxed load. Enabled, samples go into a plain os::histogram under an
+	///  uncontended lock, which is cheaper than updating buckets, sum and extremes with separate atomics.
+	class latency_recorder {
+		std::atomic<bool> enabled;
+		std::mutex        lock;
+		os::histogram     data;
+
+		void record_locked(std::chrono::nanoseconds value);
+
+		public:
+		latency_recorder();
+
+		latency_recorder(const latency_recorder &) = delete;
+		latency_recorder &operator=(const latency_recorder &) = delete;
+
+		// Samples recorded so far are kept when disabling.
+		void enable(bool enabled);
+
+		inline bool is_enabled() {
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		inline void record(std::chrono::nanoseconds value) {
+			if (is_enabled()) {
+				record_locked(value);
+			}
+		}
+
+		os::histogram get();
+
+		void reset();
+	};
+} // namespace os
+
+#endif // OS_HISTOGRAM_HPP
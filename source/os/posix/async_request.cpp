@@ -0,0 +1,227 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "async_request.hpp"
+#include <poll.h>
+#include "../trace.hpp"
+#include "named-pipe.hpp"
+
+void os::posix::async_request::set_pipe(os::posix::named_pipe *pipe, request_type type, char *buffer,
+										size_t buffer_length) {
+	this->pipe              = pipe;
+	this->type              = type;
+	this->buffer            = buffer;
+	this->buffer_length     = buffer_length;
+	this->bytes_transferred = 0;
+	this->header            = uint32_t(buffer_length);
+	this->header_offset     = 0;
+	this->pool              = nullptr;
+	this->message           = nullptr;
+	this->submitted         = std::chrono::steady_clock::now();
+	this->blocked_since     = std::chrono::steady_clock::time_point();
+	this->complete          = false;
+	this->signalled         = false;
+	this->result            = os::error::Pending;
+	this->valid             = false;
+	this->callback_called   = false;
+	this->system.callback_called = false;
+	clear_deadline();
+}
+
+void os::posix::async_request::set_valid(bool valid) {
+	this->valid           = valid;
+	this->callback_called = false;
+	notify_changed();
+}
+
+void os::posix::async_request::set_complete(os::error ec) {
+	this->result    = ec;
+	this->complete  = true;
+	this->signalled = true;
+	DATALANE_TRACE(Complete, this, get_trace_name());
+	notify_changed();
+}
+
+bool os::posix::async_request::is_started() {
+	return (header_offset > 0) || (bytes_transferred > 0);
+}
+
+const char *os::posix::async_request::get_trace_name() {
+	static const char *names[] = {"unknown", "accept", "read", "write"};
+	if ((type == request_type::Read) && pool) {
+		return "read_message";
+	}
+	return names[size_t(type)];
+}
+
+
+os::posix::async_request::~async_request() {
+	if (is_valid()) {
+		cancel();
+	}
+	if (pipe) {
+		pipe->remove(this);
+		pipe->unbind(this);
+	}
+}
+
+bool os::posix::async_request::is_valid() {
+	return this->valid;
+}
+
+void os::posix::async_request::invalidate() {
+	valid           = false;
+	callback_called = true;
+
+	// Requests that already moved data have to finish, otherwise the message stream breaks.
+	if (pipe && !complete && !is_started()) {
+		pipe->remove(this);
+	}
+	notify_changed();
+}
+
+bool os::posix::async_request::is_complete() {
+	if (!is_valid()) {
+		return false;
+	}
+
+	if (pipe && !complete) {
+		pipe->progress(this);
+	}
+	return complete;
+}
+
+size_t os::posix::async_request::get_bytes_transferred() {
+	if (!is_valid()) {
+		return 0;
+	}
+	return bytes_transferred;
+}
+
+bool os::posix::async_request::cancel() {
+	if (!is_valid()) {
+		return false;
+	}
+
+	if (complete) {
+		return true;
+	}
+
+	// A partially sent message can't be taken back, and the part of a message a read took already would be lost
+	//  with it, leaving the rest for the next read. Like time_out(), refuse and let the request finish.
+	if (is_started()) {
+		return false;
+	}
+
+	if (pipe) {
+		pipe->remove(this);
+	}
+	set_complete(os::error::Error);
+	return true;
+}
+
+bool os::posix::async_request::time_out() {
+	// Whatever arrived in the meantime wins over the deadline.
+	if (!is_valid() || is_complete() || is_started()) {
+		return false;
+	}
+
+	if (pipe) {
+		pipe->remove(this);
+	}
+	set_complete(os::error::TimedOut);
+	return true;
+}
+
+void os::posix::async_request::call_callback() {
+	call_callback(result, bytes_transferred);
+}
+
+void os::posix::async_request::call_callback(os::error ec, size_t length) {
+	if (system.callback && !system.callback_called) {
+		system.callback_called = true;
+		system.callback(ec, length);
+	}
+	if (callback && !callback_called) {
+		callback_called = true;
+		DATALANE_TRACE_SCOPE(Callback, this, "callback");
+		if (pipe && pipe->latency[size_t(os::latency_type::Callback)].is_enabled()) {
+			auto begin = std::chrono::steady_clock::now();
+			callback(ec, length);
+			pipe->latency[size_t(os::latency_type::Callback)].record(std::chrono::steady_clock::now() - begin);
+		} else {
+			callback(ec, length);
+		}
+	}
+}
+
+int os::posix::async_request::get_fd() {
+	if (!pipe || !is_valid()) {
+		return -1;
+	}
+	return pipe->get_fd(this);
+}
+
+short os::posix::async_request::get_events() {
+	if (type == request_type::Write) {
+		return POLLOUT;
+	} else if ((type == request_type::Read) && pipe && (pipe->backlog > 0)) {
+		// Progress on the read sends the backlog of try_write() as well.
+		return POLLIN | POLLOUT;
+	}
+	return POLLIN;
+}
+
+uint64_t os::posix::async_request::get_generation() {
+	if (!pipe) {
+		return 0;
+	}
+	return pipe->get_generation(this);
+}
+
+bool os::posix::async_request::try_consume() {
+	if (!is_valid()) {
+		return false;
+	}
+
+	if (pipe) {
+		return pipe->consume(this);
+	}
+
+	if (signalled) {
+		signalled = false;
+		return true;
+	}
+	return false;
+}
+
+void os::posix::async_request::on_wakeup(std::chrono::nanoseconds blocked) {
+	if (pipe) {
+		pipe->counters.add(os::stats_counters::counter::Wakeups);
+		pipe->latency[size_t(os::latency_type::Wait)].record(blocked);
+	}
+}
+
+void os::posix::async_request::on_timeout() {
+	if (pipe) {
+		pipe->counters.add(os::stats_counters::counter::Timeouts);
+	}
+}
+
+void *os::posix::async_request::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
@@ -0,0 +1,127 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_ASYNC_REQUEST_HPP
+#define OS_POSIX_ASYNC_REQUEST_HPP
+
+#include <chrono>
+#include "../async_op.hpp"
+#include "../buffer-pool.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	namespace posix {
+		class named_pipe;
+
+		class async_request : public os::async_op, public os::posix::waitable_handle {
+			protected:
+			enum class request_type : int8_t {
+				Unknown,
+				Accept,
+				Read,
+				Write,
+			};
+
+			os::posix::named_pipe *pipe = nullptr;
+			request_type           type = request_type::Unknown;
+
+			char * buffer            = nullptr;
+			size_t buffer_length     = 0;
+			size_t bytes_transferred = 0;
+
+			// Writes send a length header in front of every message, which may only be partially sent.
+			uint32_t header        = 0;
+			size_t   header_offset = 0;
+
+			// Reads issued by read_message() take their buffer from 'pool' once the length of the message is known.
+			os::buffer_pool *        pool    = nullptr;
+			os::buffer_pool::buffer *message = nullptr;
+
+			// Copies of messages queued by named_pipe::try_write(), which the pipe recycles once they completed.
+			bool spilled = false;
+
+			// When the request was issued, for the latency histograms of the pipe.
+			std::chrono::steady_clock::time_point submitted;
+
+			// Set once a write could not complete immediately, for os::pipe_stats::write_blocked_time.
+			std::chrono::steady_clock::time_point blocked_since;
+
+			bool      complete  = false;
+			bool      signalled = false;
+			bool      queued    = false;
+			os::error result    = os::error::Unknown;
+
+			// Intrusive links for the request queues and the bound list of the pipe, so that neither allocates.
+			async_request *next_queued = nullptr;
+			async_request *prev_bound  = nullptr;
+			async_request *next_bound  = nullptr;
+
+			void set_pipe(os::posix::named_pipe *pipe, request_type type, char *buffer, size_t buffer_length);
+
+			void set_valid(bool valid);
+
+			void set_complete(os::error ec);
+
+			bool is_started();
+
+			// The same for submission and completion, read_message() reads are told apart from read() ones.
+			const char *get_trace_name();
+
+			virtual bool time_out() override;
+
+			public:
+			~async_request();
+
+			virtual bool is_valid() override;
+
+			virtual void invalidate() override;
+
+			virtual bool is_complete() override;
+
+			virtual size_t get_bytes_transferred() override;
+
+			// Returns false once the request moved any data, it then has to finish to keep the messages intact.
+			virtual bool cancel() override;
+
+			virtual void call_callback() override;
+
+			virtual void call_callback(os::error ec, size_t length) override;
+
+			// os::posix::waitable_handle
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual uint64_t get_generation() override;
+
+			virtual bool try_consume() override;
+
+			virtual void on_wakeup(std::chrono::nanoseconds blocked) override;
+
+			virtual void on_timeout() override;
+
+			// os::waitable
+			virtual void *get_waitable() override;
+
+			public:
+			friend class os::posix::named_pipe;
+			friend class os::waitable;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_ASYNC_REQUEST_HPP
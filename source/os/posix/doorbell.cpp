@@ -0,0 +1,163 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "doorbell.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+inline std::string make_path(std::string name) {
+	for (char &v : name) {
+		if (v == '/' || v == '\\') {
+			v = '_';
+		}
+	}
+	return "/datalane-" + name + ".bell";
+}
+
+inline void *map_state(int handle, size_t size) {
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+	return (memory == MAP_FAILED) ? nullptr : memory;
+}
+
+void os::posix::doorbell::create(std::string name) {
+	bell = std::make_unique<os::posix::semaphore>(os::create_only, name + ".bell");
+
+	path       = make_path(name);
+	int handle = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0666);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Doorbell creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+
+	void *memory = nullptr;
+	if ((ftruncate(handle, sizeof(shared_state)) != 0) || !(memory = map_state(handle, sizeof(shared_state)))) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Doorbell creation failed with error code %X.", errno);
+		close(handle);
+		shm_unlink(path.c_str());
+		throw std::runtime_error(msg.data());
+	}
+	close(handle);
+
+	state = new (memory) shared_state();
+	state->rings.store(0);
+	state->armed.store(1);
+	owner = true;
+}
+
+void os::posix::doorbell::open(std::string name) {
+	bell = std::make_unique<os::posix::semaphore>(os::open_only, name + ".bell");
+
+	path       = make_path(name);
+	int handle = shm_open(path.c_str(), O_RDWR | O_CLOEXEC, 0666);
+	struct stat st;
+	void *      memory = nullptr;
+	if ((handle < 0) || (fstat(handle, &st) != 0) || (size_t(st.st_size) < sizeof(shared_state))
+		|| !(memory = map_state(handle, sizeof(shared_state)))) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Doorbell failed with error code %X.", errno ? errno : ENOENT);
+		if (handle >= 0) {
+			close(handle);
+		}
+		throw std::runtime_error(msg.data());
+	}
+	close(handle);
+	state = static_cast<shared_state *>(memory);
+}
+
+os::posix::doorbell::doorbell() {
+	local.rings.store(0);
+	local.armed.store(1);
+	state = &local;
+	bell  = std::make_unique<os::posix::semaphore>();
+}
+
+os::posix::doorbell::doorbell(os::create_only_t, std::string name) {
+	create(name);
+}
+
+os::posix::doorbell::doorbell(os::create_or_open_t, std::string name) {
+	try {
+		create(name);
+	} catch (...) {
+		// There's technically two errors here, but the latter is likely to be more interesting.
+		bell.reset();
+		open(name);
+	}
+}
+
+os::posix::doorbell::doorbell(os::open_only_t, std::string name) {
+	open(name);
+}
+
+os::posix::doorbell::~doorbell() {
+	if (state && (state != &local)) {
+		munmap(state, sizeof(shared_state));
+	}
+	if (owner) {
+		shm_unlink(path.c_str());
+	}
+}
+
+os::error os::posix::doorbell::post() {
+	return bell->signal();
+}
+
+int os::posix::doorbell::get_fd() {
+	return bell->get_fd();
+}
+
+short os::posix::doorbell::get_events() {
+	return POLLIN;
+}
+
+bool os::posix::doorbell::try_consume() {
+	// Posts that raced with take() can pile up, one wakeup covers all of them.
+	bool signalled = false;
+	while (bell->try_consume()) {
+		signalled = true;
+	}
+	return signalled;
+}
+
+void *os::posix::doorbell::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct() {
+	return std::make_shared<os::posix::doorbell>();
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::create_only_t, std::string name) {
+	return std::make_shared<os::posix::doorbell>(os::create_only, name);
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::create_or_open_t, std::string name) {
+	return std::make_shared<os::posix::doorbell>(os::create_or_open, name);
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::open_only_t, std::string name) {
+	return std::make_shared<os::posix::doorbell>(os::open_only, name);
+}
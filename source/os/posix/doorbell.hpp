@@ -0,0 +1,66 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_DOORBELL_HPP
+#define OS_POSIX_DOORBELL_HPP
+
+#include <memory>
+#include <string>
+#include "../doorbell.hpp"
+#include "../tags.hpp"
+#include "semaphore.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	namespace posix {
+		// Unnamed doorbells keep their counter in the object itself, named ones in a POSIX shared memory object.
+		///  The consumer sleeps on an os::posix::semaphore of the same name.
+		class doorbell : public os::doorbell, public os::posix::waitable_handle {
+			shared_state                          local;
+			std::unique_ptr<os::posix::semaphore> bell;
+			std::string                           path;
+			bool                                  owner = false;
+
+			void create(std::string name);
+
+			void open(std::string name);
+
+			protected:
+			virtual os::error post() override;
+
+			public:
+			doorbell();
+			doorbell(os::create_only_t, std::string name);
+			doorbell(os::create_or_open_t, std::string name);
+			doorbell(os::open_only_t, std::string name);
+			virtual ~doorbell();
+
+			// os::posix::waitable_handle
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual bool try_consume() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_DOORBELL_HPP
@@ -0,0 +1,239 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "event.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define MAX_NAME_LENGTH 200
+
+inline std::string make_path(std::string name) {
+	for (char &v : name) {
+		if (v == '/' || v == '\\') {
+			v = '_';
+		}
+	}
+	return "/tmp/datalane-" + name + ".event";
+}
+
+inline void validate_name(std::string name) {
+	if (name.length() == 0) {
+		throw std::invalid_argument("'name' can't be empty.");
+	} else if (name.length() >= MAX_NAME_LENGTH) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "'name' can't be longer than %d characters.", MAX_NAME_LENGTH);
+		throw std::invalid_argument(msg.data());
+	}
+}
+
+inline void create_event_impl(int &handle, std::string path, bool manual_reset) {
+	if (mkfifo(path.c_str(), 0666) != 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Event creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+
+	// O_RDWR keeps open() from blocking and the FIFO from reporting a hang-up when nobody else has it open.
+	handle = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	struct stat st;
+	if ((handle < 0) || (fstat(handle, &st) != 0)
+		|| (fchmod(handle, (st.st_mode & 07777 & ~S_IXUSR) | (manual_reset ? S_IXUSR : 0)) != 0)) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Event creation failed with error code %X.", errno);
+		if (handle >= 0) {
+			close(handle);
+		}
+		unlink(path.c_str());
+		throw std::runtime_error(msg.data());
+	}
+}
+
+inline void open_event_impl(int &handle, std::string path, bool &manual_reset) {
+	struct stat st;
+	if ((stat(path.c_str(), &st) != 0) || !S_ISFIFO(st.st_mode)) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Event failed with error code %X.", errno ? errno : ENOENT);
+		throw std::runtime_error(msg.data());
+	}
+	manual_reset = (st.st_mode & S_IXUSR) != 0;
+
+	handle = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Event failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::posix::event::event(bool manual_reset /*= false*/, bool initial_state /*= false*/) : manual_reset(manual_reset) {
+	handle = eventfd(initial_state ? 1 : 0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Event creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::posix::event::event(os::create_only_t, std::string name, bool manual_reset /*= false*/,
+						bool initial_state /*= false*/)
+	: manual_reset(manual_reset) {
+	validate_name(name);
+	path = make_path(name);
+	create_event_impl(handle, path, manual_reset);
+	named = true;
+	owner = true;
+	if (initial_state) {
+		set();
+	}
+}
+
+os::posix::event::event(os::create_or_open_t, std::string name, bool manual_reset /*= false*/,
+						bool initial_state /*= false*/)
+	: manual_reset(manual_reset) {
+	validate_name(name);
+	path  = make_path(name);
+	named = true;
+	try {
+		create_event_impl(handle, path, manual_reset);
+		owner = true;
+		if (initial_state) {
+			set();
+		}
+	} catch (...) {
+		// There's technically two errors here, but the latter is likely to be more interesting.
+		open_event_impl(handle, path, this->manual_reset);
+	}
+}
+
+os::posix::event::event(os::open_only_t, std::string name) {
+	validate_name(name);
+	path  = make_path(name);
+	named = true;
+	open_event_impl(handle, path, manual_reset);
+}
+
+os::posix::event::~event() {
+	if (handle >= 0) {
+		close(handle);
+	}
+	if (owner) {
+		unlink(path.c_str());
+	}
+}
+
+os::error os::posix::event::set() {
+	// A byte in the FIFO is what keeps a named event signalled, a second one would wake a second waiter. Two set()
+	//  calls racing each other can still both write, which wakes one waiter too many but never one too few.
+	if (named) {
+		int pending = 0;
+		if ((ioctl(handle, FIONREAD, &pending) == 0) && (pending > 0)) {
+			return os::error::Success;
+		}
+	}
+
+	// A full counter or FIFO means it is set already.
+	ssize_t result = 0;
+	do {
+		if (!named) {
+			uint64_t value = 1;
+			result         = write(handle, &value, sizeof(value));
+		} else {
+			char value = 0;
+			result     = write(handle, &value, sizeof(value));
+		}
+	} while ((result < 0) && (errno == EINTR));
+
+	if ((result < 0) && (errno != EAGAIN)) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::event::reset() {
+	if (!named) {
+		uint64_t value = 0;
+		if ((read(handle, &value, sizeof(value)) < 0) && (errno != EAGAIN)) {
+			return os::error::Error;
+		}
+		return os::error::Success;
+	}
+
+	// Racing set() calls may have left more than one byte behind.
+	char    buffer[256];
+	ssize_t result = 0;
+	while ((result = read(handle, buffer, sizeof(buffer))) > 0 || ((result < 0) && (errno == EINTR))) {
+	}
+	if ((result < 0) && (errno != EAGAIN)) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+int os::posix::event::get_fd() {
+	return handle;
+}
+
+short os::posix::event::get_events() {
+	return POLLIN;
+}
+
+bool os::posix::event::try_consume() {
+	if (manual_reset) {
+		pollfd fd = {handle, POLLIN, 0};
+		return (poll(&fd, 1, 0) > 0) && (fd.revents & POLLIN);
+	}
+
+	if (!named) {
+		uint64_t value = 0;
+		return read(handle, &value, sizeof(value)) == sizeof(value);
+	}
+
+	// Take exactly one byte. Draining the rest would swallow a set() from another process that landed right after
+	//  the read, and that one has to leave the event signalled for the next waiter.
+	char value = 0;
+	return read(handle, &value, sizeof(value)) == sizeof(value);
+}
+
+void *os::posix::event::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+std::shared_ptr<os::event> os::event::construct(bool manual_reset /*= false*/, bool initial_state /*= false*/) {
+	return std::make_shared<os::posix::event>(manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::create_only_t, std::string name, bool manual_reset /*= false*/,
+												bool initial_state /*= false*/) {
+	return std::make_shared<os::posix::event>(os::create_only, name, manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::create_or_open_t, std::string name,
+												bool manual_reset /*= false*/, bool initial_state /*= false*/) {
+	return std::make_shared<os::posix::event>(os::create_or_open, name, manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::open_only_t, std::string name) {
+	return std::make_shared<os::posix::event>(os::open_only, name);
+}
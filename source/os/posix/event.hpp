@@ -0,0 +1,65 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_EVENT_HPP
+#define OS_POSIX_EVENT_HPP
+
+#include <string>
+#include "../event.hpp"
+#include "../tags.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	namespace posix {
+		// Event that can be waited on with poll().
+		/// Unnamed events are backed by an eventfd, named ones by a FIFO that holds a byte while the event is set.
+		///  set() only writes into an empty FIFO and an auto-reset wait takes a single byte, so a set() from another
+		///  process is never swallowed by a wait that was already under way. Whether a named event resets manually
+		///  is kept in the permissions of the FIFO, so that opening it by name finds out.
+		class event : public os::event, public os::posix::waitable_handle {
+			int         handle       = -1;
+			bool        named        = false;
+			bool        manual_reset = false;
+			std::string path;
+			bool        owner = false;
+
+			public:
+			event(bool manual_reset = false, bool initial_state = false);
+			event(os::create_only_t, std::string name, bool manual_reset = false, bool initial_state = false);
+			event(os::create_or_open_t, std::string name, bool manual_reset = false, bool initial_state = false);
+			event(os::open_only_t, std::string name);
+			virtual ~event();
+
+			virtual os::error set() override;
+
+			virtual os::error reset() override;
+
+			// os::posix::waitable_handle
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual bool try_consume() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_EVENT_HPP
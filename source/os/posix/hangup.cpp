@@ -0,0 +1,162 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "hangup.hpp"
+#include <condition_variable>
+#include <errno.h>
+#include <mutex>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+	struct entry {
+		int                           fd         = -1;
+		os::posix::hangup::callback_t callback   = nullptr;
+		void *                        context    = nullptr;
+		uint32_t                      generation = 0;
+		uint32_t                      next_free  = 0;
+	};
+
+	// Ids are the slot index plus its generation, so that events fetched before a remove() can be told apart from
+	//  those of whoever reuses the slot.
+	struct watcher {
+		std::mutex              lock;
+		std::condition_variable idle;
+		int                     epoll_fd = -1;
+		std::vector<entry>      entries;
+		uint32_t                free_head = UINT32_MAX;
+		std::thread::id         thread;
+
+		// Id whose callback is running right now, remove() waits for it to return.
+		uint64_t running = 0;
+
+		bool is_live(uint64_t id) {
+			uint32_t index      = uint32_t(id & UINT32_MAX);
+			uint32_t generation = uint32_t(id >> 32);
+			return (index < entries.size()) && (entries[index].generation == generation) && entries[index].callback;
+		}
+
+		void run() {
+			epoll_event events[64];
+			for (;;) {
+				int count = epoll_wait(epoll_fd, events, 64, -1);
+				if (count < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					return;
+				}
+
+				// Callbacks run unlocked, they may well open, accept or close pipes which lands in add() or remove().
+				std::unique_lock<std::mutex> ul(lock);
+				for (int idx = 0; idx < count; idx++) {
+					uint64_t id = events[idx].data.u64;
+					if (!is_live(id)) {
+						continue;
+					}
+					entry &                       e        = entries[uint32_t(id & UINT32_MAX)];
+					os::posix::hangup::callback_t callback = e.callback;
+					void *                        context  = e.context;
+
+					running = id;
+					ul.unlock();
+					callback(context);
+					ul.lock();
+					running = 0;
+					idle.notify_all();
+				}
+			}
+		}
+	};
+
+	// Never destroyed, pipes may outlive static destruction and the thread runs until the process exits.
+	watcher *get_watcher() {
+		static watcher *instance = []() {
+			watcher *ptr  = new watcher;
+			ptr->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+			if (ptr->epoll_fd >= 0) {
+				std::thread thread(&watcher::run, ptr);
+				ptr->thread = thread.get_id();
+				thread.detach();
+			}
+			return ptr;
+		}();
+		return instance;
+	}
+} // namespace
+
+uint64_t os::posix::hangup::add(int fd, callback_t callback, void *context) {
+	watcher *w = get_watcher();
+	if ((w->epoll_fd < 0) || (fd < 0)) {
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> ul(w->lock);
+	uint32_t                     index = w->free_head;
+	if (index != UINT32_MAX) {
+		w->free_head = w->entries[index].next_free;
+	} else {
+		index = uint32_t(w->entries.size());
+		w->entries.emplace_back();
+	}
+	entry &e   = w->entries[index];
+	e.fd       = fd;
+	e.callback = callback;
+	e.context  = context;
+	e.generation++;
+
+	// One-shot, a connection only hangs up once.
+	epoll_event ev;
+	ev.events   = EPOLLRDHUP | EPOLLONESHOT;
+	ev.data.u64 = (uint64_t(e.generation) << 32) | index;
+	if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		e.callback   = nullptr;
+		e.next_free  = w->free_head;
+		w->free_head = index;
+		return 0;
+	}
+	return ev.data.u64;
+}
+
+void os::posix::hangup::remove(uint64_t id) {
+	if (id == 0) {
+		return;
+	}
+
+	watcher *                    w = get_watcher();
+	std::unique_lock<std::mutex> ul(w->lock);
+	if (!w->is_live(id)) {
+		return;
+	}
+
+	uint32_t index = uint32_t(id & UINT32_MAX);
+	entry &  e     = w->entries[index];
+	epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, e.fd, nullptr);
+	e.fd         = -1;
+	e.callback   = nullptr;
+	e.context    = nullptr;
+	e.next_free  = w->free_head;
+	w->free_head = index;
+
+	// A callback that already started has to finish before the context may go away. The callback itself may
+	//  remove its own id (a pipe closed from its disconnect handler), that must not wait for itself.
+	if (std::this_thread::get_id() != w->thread) {
+		w->idle.wait(ul, [w, id]() { return w->running != id; });
+	}
+}
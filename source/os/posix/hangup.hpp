@@ -0,0 +1,42 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_HANGUP_HPP
+#define OS_POSIX_HANGUP_HPP
+
+#include <inttypes.h>
+
+namespace os {
+	namespace posix {
+		// Reports hang-ups of connected sockets from a single background thread, so that nobody has to poll for them.
+		/// Sockets are registered with EPOLLRDHUP only, so the thread sleeps through regular traffic and wakes up
+		///  once per connection whose remote end went away. The callback runs on that thread without the registry
+		///  locked, so it may add() or remove() sockets, but it holds up hang-up detection for everyone else.
+		namespace hangup {
+			typedef void (*callback_t)(void *context);
+
+			// Start watching 'fd', returns an id for remove() or 0 if the socket can't be watched.
+			uint64_t add(int fd, callback_t callback, void *context);
+
+			// Stop watching, after this returns the callback is never called again for 'id' and is no longer running,
+			//  unless remove() was called from that very callback.
+			void remove(uint64_t id);
+		} // namespace hangup
+	}     // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_HANGUP_HPP
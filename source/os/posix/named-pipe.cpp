@@ -0,0 +1,1343 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "named-pipe.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits>
+#include <map>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include "../trace.hpp"
+#include "hangup.hpp"
+#include "utility.hpp"
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+#define DEFAULT_BUFFER_SIZE 16 * 1024 * 1024
+#define HEADER_SIZE sizeof(uint32_t)
+// Backlog of try_write() at which it starts refusing messages, and at which it takes them again.
+#define DEFAULT_HIGH_WATERMARK 64 * 1024
+#define DEFAULT_LOW_WATERMARK 16 * 1024
+
+// Abstract socket names are limited by sun_path, minus the leading zero byte and the prefix.
+#define MAX_PATH_MINUS_PREFIX (sizeof(sockaddr_un::sun_path) - 11)
+
+// Handed out to every connection and listening socket, see named_pipe::generation.
+static uint64_t next_generation() {
+	static std::atomic<uint64_t> counter(0);
+	return ++counter;
+}
+
+struct os::posix::named_pipe::listener {
+	int         fd         = -1;
+	uint64_t    generation = next_generation();
+	std::string name;
+	size_t      instances     = 0;
+	size_t      max_instances = 0;
+
+	~listener() {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+};
+
+static std::mutex                                                          listeners_lock;
+static std::map<std::string, std::weak_ptr<os::posix::named_pipe::listener>> listeners;
+
+inline void validate_create_param(std::string name, size_t max_instances) {
+	if (name.length() == 0) {
+		throw std::invalid_argument("'name' can't be empty.");
+	} else if (name.length() >= MAX_PATH_MINUS_PREFIX) {
+		throw std::invalid_argument("'name' can't be longer than " TOSTRING(MAX_PATH_MINUS_PREFIX) " characters.");
+	} else if (max_instances == 0) {
+		throw std::invalid_argument("'max_instances' can't be zero.");
+	} else if (max_instances > PIPE_UNLIMITED_INSTANCES) {
+		throw std::invalid_argument("'max_instances' can't be greater than " TOSTRING(PIPE_UNLIMITED_INSTANCES));
+	}
+}
+
+inline void validate_open_param(std::string name) {
+	if (name.length() == 0) {
+		throw std::invalid_argument("'name' can't be empty.");
+	} else if (name.length() >= MAX_PATH_MINUS_PREFIX) {
+		throw std::invalid_argument("'name' can't be longer than " TOSTRING(MAX_PATH_MINUS_PREFIX) " characters.");
+	}
+}
+
+inline socklen_t make_address(std::string name, sockaddr_un &addr) {
+	for (char &v : name) {
+		if (v == '\\') {
+			v = '/';
+		}
+	}
+	std::string path = "datalane/" + name;
+
+	memset(&addr, 0, sizeof(sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path + 1, path.data(), path.length());
+	return socklen_t(offsetof(sockaddr_un, sun_path) + 1 + path.length());
+}
+
+inline void set_buffer_size(int handle) {
+	int size = DEFAULT_BUFFER_SIZE;
+	setsockopt(handle, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(handle, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+inline void set_send_buffer_size(int handle, size_t size) {
+	// Stream sockets of AF_UNIX charge queued data to the sender only, so the receive buffer doesn't matter.
+	int value = int(std::min<size_t>(size, std::numeric_limits<int>::max()));
+	setsockopt(handle, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+}
+
+inline void create_logic(std::shared_ptr<os::posix::named_pipe::listener> &owner, std::string name,
+						 size_t max_instances, bool is_unique) {
+	std::unique_lock<std::mutex> ul(listeners_lock);
+
+	// Instances within this process share the listening socket.
+	auto kv = listeners.find(name);
+	if (kv != listeners.end()) {
+		owner = kv->second.lock();
+	}
+	if (owner) {
+		if (is_unique) {
+			throw std::runtime_error("Creating Named Pipe failed, an instance already exists.");
+		} else if (owner->instances >= owner->max_instances) {
+			throw std::runtime_error("Creating Named Pipe failed, all instances are busy.");
+		}
+		owner->instances++;
+		return;
+	}
+
+	owner       = std::make_shared<os::posix::named_pipe::listener>();
+	owner->name = name;
+	// Like on Windows, the largest value means there is no limit.
+	owner->max_instances = (max_instances == PIPE_UNLIMITED_INSTANCES) ? SIZE_MAX : max_instances;
+	owner->fd            = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (owner->fd < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Creating Named Pipe failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+
+	sockaddr_un addr;
+	socklen_t   addr_len = make_address(name, addr);
+	if ((bind(owner->fd, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0)
+		|| (::listen(owner->fd, int(std::min<size_t>(owner->max_instances, SOMAXCONN))) != 0)) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Creating Named Pipe failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+
+	owner->instances = 1;
+	listeners[name]  = owner;
+}
+
+inline void open_logic(int &handle, std::string name) {
+	handle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Named Pipe failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+	set_buffer_size(handle);
+
+	sockaddr_un addr;
+	socklen_t   addr_len = make_address(name, addr);
+	if (connect(handle, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Named Pipe failed with error code %X.", errno);
+		close(handle);
+		handle = -1;
+		throw std::runtime_error(msg.data());
+	}
+
+	// Connect blocking, everything afterwards is non-blocking.
+	int flags = fcntl(handle, F_GETFL, 0);
+	fcntl(handle, F_SETFL, flags | O_NONBLOCK);
+}
+
+bool os::posix::named_pipe::request_queue::empty() const {
+	return head == nullptr;
+}
+
+void os::posix::named_pipe::request_queue::push_back(async_request *ar) {
+	ar->next_queued = nullptr;
+	ar->queued      = true;
+	if (tail) {
+		tail->next_queued = ar;
+	} else {
+		head = ar;
+	}
+	tail = ar;
+}
+
+void os::posix::named_pipe::request_queue::pop_front() {
+	async_request *ar = head;
+	head              = ar->next_queued;
+	if (!head) {
+		tail = nullptr;
+	}
+	ar->next_queued = nullptr;
+	ar->queued      = false;
+}
+
+bool os::posix::named_pipe::request_queue::erase(async_request *ar) {
+	// Only cancelled and destroyed requests leave out of order, so a linear search is fine.
+	async_request *prev = nullptr;
+	for (async_request *cur = head; cur; prev = cur, cur = cur->next_queued) {
+		if (cur != ar) {
+			continue;
+		}
+		if (prev) {
+			prev->next_queued = cur->next_queued;
+		} else {
+			head = cur->next_queued;
+		}
+		if (tail == cur) {
+			tail = prev;
+		}
+		ar->next_queued = nullptr;
+		ar->queued      = false;
+		return true;
+	}
+	return false;
+}
+
+struct os::posix::named_pipe::write_backlog {
+	// Declared first, the copies hand their memory back to it on destruction.
+	os::buffer_pool pool;
+
+	struct copy : public async_request {
+		os::buffer_pool::buffer data;
+	};
+	std::vector<std::unique_ptr<copy>> copies;
+	std::vector<copy *>                spare;
+};
+
+os::posix::named_pipe::named_pipe() {
+	handle         = -1;
+	created        = false;
+	read_state     = {0, 0, 0};
+	low_watermark  = DEFAULT_LOW_WATERMARK;
+	high_watermark = DEFAULT_HIGH_WATERMARK;
+	set_connected(false);
+}
+
+os::posix::named_pipe::named_pipe(os::create_only_t, std::string name,
+								  size_t         max_instances /*= PIPE_UNLIMITED_INSTANCES*/,
+								  pipe_type      type /*= pipe_type::Message*/,
+								  pipe_read_mode mode /*= pipe_read_mode::Message*/, bool is_unique /*= false*/)
+	: named_pipe() {
+	validate_create_param(name, max_instances);
+
+	create_logic(owner, name, max_instances, is_unique);
+	created    = true;
+	this->type = type;
+	this->mode = mode;
+	os::stats_page::add(this, name + " (server)");
+}
+
+os::posix::named_pipe::named_pipe(os::create_or_open_t, std::string name,
+								  size_t         max_instances /*= PIPE_UNLIMITED_INSTANCES*/,
+								  pipe_type      type /*= pipe_type::Message*/,
+								  pipe_read_mode mode /*= pipe_read_mode::Message*/, bool is_unique /*= false*/)
+	: named_pipe() {
+	validate_create_param(name, max_instances);
+
+	this->type = type;
+	this->mode = mode;
+	try {
+		create_logic(owner, name, max_instances, is_unique);
+		created = true;
+	} catch (...) {
+		open_logic(handle, name);
+		set_connected(true);
+		attach();
+	}
+	os::stats_page::add(this, name + (created ? " (server)" : " (client)"));
+}
+
+os::posix::named_pipe::named_pipe(os::open_only_t, std::string name,
+								  pipe_read_mode mode /*= pipe_read_mode::Message*/)
+	: named_pipe() {
+	validate_open_param(name);
+
+	this->mode = mode;
+	open_logic(handle, name);
+	set_connected(true);
+	attach();
+	os::stats_page::add(this, name + " (client)");
+}
+
+os::posix::named_pipe::~named_pipe() {
+	os::stats_page::remove(this);
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		for (request_queue *queue : {&read_queue, &write_queue}) {
+			while (!queue->empty()) {
+				queue->head->set_complete(os::error::Disconnected);
+				queue->pop_front();
+			}
+		}
+		if (accept_request) {
+			accept_request->set_complete(os::error::Disconnected);
+		}
+		while (bound) {
+			async_request *ar = bound;
+			bound             = ar->next_bound;
+			ar->pipe          = nullptr;
+			ar->prev_bound = ar->next_bound = nullptr;
+		}
+		accept_request = nullptr;
+	}
+
+	detach();
+	if (handle >= 0) {
+		shutdown(handle, SHUT_RDWR);
+		close(handle);
+	}
+
+	if (owner) {
+		std::unique_lock<std::mutex> ul(listeners_lock);
+		owner->instances--;
+	}
+}
+
+void os::posix::named_pipe::bind(async_request *ar) {
+	if (ar->pipe == this) {
+		return;
+	} else if (ar->pipe) {
+		ar->pipe->remove(ar);
+		ar->pipe->unbind(ar);
+	}
+
+	std::unique_lock<std::mutex> ul(lock);
+	ar->prev_bound = nullptr;
+	ar->next_bound = bound;
+	if (bound) {
+		bound->prev_bound = ar;
+	}
+	bound = ar;
+}
+
+void os::posix::named_pipe::unbind(async_request *ar) {
+	std::unique_lock<std::mutex> ul(lock);
+	if (ar->prev_bound) {
+		ar->prev_bound->next_bound = ar->next_bound;
+	} else if (bound == ar) {
+		bound = ar->next_bound;
+	} else {
+		return;
+	}
+	if (ar->next_bound) {
+		ar->next_bound->prev_bound = ar->prev_bound;
+	}
+	ar->prev_bound = ar->next_bound = nullptr;
+}
+
+void os::posix::named_pipe::account(async_request *ar) {
+	typedef os::stats_counters::counter counter;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (capture && ((ar->result == os::error::Success) || (ar->result == os::error::MoreData))) {
+		capture->append(
+			ar->type == async_request::request_type::Write ? os::capture::direction::Out : os::capture::direction::In,
+			lane, ar->buffer, ar->bytes_transferred, ar->result,
+			std::chrono::duration_cast<std::chrono::nanoseconds>(now - ar->submitted));
+	}
+	if (ar->type == async_request::request_type::Write) {
+		latency[size_t(os::latency_type::Write)].record(now - ar->submitted);
+		counters.add(counter::PendingWrites, -1);
+		if (tuner.is_active()) {
+			tuner.on_complete(now - ar->submitted);
+		}
+		if (ar->result == os::error::Success) {
+			counters.add(counter::MessagesOut);
+			counters.add(counter::BytesOut, int64_t(ar->bytes_transferred));
+		}
+		if (ar->blocked_since != std::chrono::steady_clock::time_point()) {
+			counters.add(counter::WriteBlockedTime,
+						 std::chrono::duration_cast<std::chrono::nanoseconds>(now - ar->blocked_since).count());
+		}
+	} else {
+		latency[size_t(os::latency_type::Read)].record(now - ar->submitted);
+		counters.add(counter::PendingReads, -1);
+		counters.add(counter::BytesIn, int64_t(ar->bytes_transferred));
+		if (ar->result == os::error::MoreData) {
+			counters.add(counter::MoreData);
+			counters.add(counter::PartialReads);
+		} else if ((ar->result == os::error::Success) && (read_state.remaining > 0)) {
+			counters.add(counter::PartialReads);
+		}
+
+		int bytes = 0;
+		if (hung_up && ((ioctl(handle, FIONREAD, &bytes) != 0) || (bytes == 0))) {
+			disconnected();
+		}
+	}
+}
+
+void os::posix::named_pipe::attach() {
+	generation = next_generation();
+	hung_up    = false;
+	hangup_id = os::posix::hangup::add(handle, &named_pipe::handle_hangup, this);
+
+	readable.arm();
+
+	size_t size = tuner.start();
+	if (size > 0) {
+		set_send_buffer_size(handle, size);
+	}
+}
+
+void os::posix::named_pipe::detach() {
+	os::posix::hangup::remove(hangup_id);
+	hangup_id = 0;
+	tuner.stop();
+
+	// The descriptor is about to go away, sets have to drop it.
+	readable.arm();
+}
+
+void os::posix::named_pipe::handle_hangup(void *context) {
+	named_pipe *self = static_cast<named_pipe *>(context);
+
+	// Whatever the remote end sent before it went away can still be read, the last read disconnects then.
+	self->hung_up = true;
+	int bytes     = 0;
+	if (((ioctl(self->handle, FIONREAD, &bytes) != 0) || (bytes == 0)) && self->connected.exchange(false)) {
+		self->notify_disconnect();
+	}
+}
+
+void os::posix::named_pipe::disconnected() {
+	if (connected.exchange(false)) {
+		disconnect_pending = true;
+	}
+}
+
+void os::posix::named_pipe::notify_disconnect() {
+	std::function<void()> cb;
+	{
+		std::unique_lock<std::mutex> ul(callback_lock);
+		cb = disconnect_callback;
+	}
+	if (cb) {
+		cb();
+	}
+}
+
+void os::posix::named_pipe::tune(size_t sent, bool blocked, size_t message_length) {
+	if (!tuner.is_active()) {
+		return;
+	}
+	size_t size = tuner.on_send(sent, blocked, message_length);
+	if (size > 0) {
+		set_send_buffer_size(handle, size);
+	}
+}
+
+bool os::posix::named_pipe::progress_accept(async_request *ar) {
+	for (;;) {
+		int fd = accept4(owner->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				return false;
+			}
+			ar->set_complete(utility::translate_error(errno));
+			return true;
+		}
+
+		set_buffer_size(fd);
+		handle     = fd;
+		read_state = {0, 0, 0};
+		set_connected(true);
+		attach();
+		ar->set_complete(os::error::Success);
+		return true;
+	}
+}
+
+bool os::posix::named_pipe::progress_read(async_request *ar) {
+	// Messages from read_message() are never split, whatever the mode.
+	bool whole = (mode == pipe_read_mode::Message) || ar->pool;
+
+	for (;;) {
+		if (read_state.remaining == 0) {
+			// Next message, read its length first.
+			ssize_t res = recv(handle, reinterpret_cast<char *>(&read_state.header) + read_state.header_length,
+							   HEADER_SIZE - read_state.header_length, 0);
+			if (res == 0) {
+				disconnected();
+				ar->set_complete(os::error::Disconnected);
+				return true;
+			} else if (res < 0) {
+				if (errno == EINTR) {
+					continue;
+				} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+					if (!whole && (ar->bytes_transferred > 0)) {
+						ar->set_complete(os::error::Success);
+						return true;
+					}
+					return false;
+				}
+				ar->set_complete(utility::translate_error(errno));
+				if (ar->result == os::error::Disconnected) {
+					disconnected();
+				}
+				return true;
+			}
+
+			read_state.header_length += size_t(res);
+			if (read_state.header_length < HEADER_SIZE) {
+				continue;
+			}
+			read_state.header_length = 0;
+			read_state.remaining     = read_state.header;
+			if (read_state.remaining == 0) {
+				// Empty message.
+				counters.add(os::stats_counters::counter::MessagesIn);
+				if (whole) {
+					ar->set_complete(os::error::Success);
+					return true;
+				}
+			}
+			continue;
+		}
+
+		if (ar->pool && !ar->buffer) {
+			// The length is known now, take a buffer that fits.
+			*ar->message      = ar->pool->acquire(read_state.remaining);
+			ar->buffer        = ar->message->data();
+			ar->buffer_length = read_state.remaining;
+		}
+
+		size_t space = ar->buffer_length - ar->bytes_transferred;
+		if (space == 0) {
+			ar->set_complete(whole ? os::error::MoreData : os::error::Success);
+			return true;
+		}
+
+		ssize_t res = recv(handle, ar->buffer + ar->bytes_transferred, std::min(space, read_state.remaining), 0);
+		if (res == 0) {
+			disconnected();
+			ar->set_complete(os::error::Disconnected);
+			return true;
+		} else if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				if (!whole && (ar->bytes_transferred > 0)) {
+					ar->set_complete(os::error::Success);
+					return true;
+				}
+				return false;
+			}
+			ar->set_complete(utility::translate_error(errno));
+			if (ar->result == os::error::Disconnected) {
+				disconnected();
+			}
+			return true;
+		}
+
+		ar->bytes_transferred += size_t(res);
+		read_state.remaining -= size_t(res);
+		if (read_state.remaining == 0) {
+			counters.add(os::stats_counters::counter::MessagesIn);
+			if (whole) {
+				ar->set_complete(os::error::Success);
+				return true;
+			}
+		}
+	}
+}
+
+bool os::posix::named_pipe::progress_write(async_request *ar) {
+	for (;;) {
+		iovec  iov[2];
+		size_t iov_count = 0;
+		if (ar->header_offset < HEADER_SIZE) {
+			iov[iov_count].iov_base = reinterpret_cast<char *>(&ar->header) + ar->header_offset;
+			iov[iov_count].iov_len  = HEADER_SIZE - ar->header_offset;
+			iov_count++;
+		}
+		if (ar->bytes_transferred < ar->buffer_length) {
+			iov[iov_count].iov_base = ar->buffer + ar->bytes_transferred;
+			iov[iov_count].iov_len  = ar->buffer_length - ar->bytes_transferred;
+			iov_count++;
+		}
+		if (iov_count == 0) {
+			ar->set_complete(os::error::Success);
+			return true;
+		}
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msghdr));
+		msg.msg_iov    = iov;
+		msg.msg_iovlen = iov_count;
+
+		ssize_t res = sendmsg(handle, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				tune(0, true, ar->buffer_length + HEADER_SIZE);
+				return false;
+			}
+			ar->set_complete(utility::translate_error(errno));
+			if (ar->result == os::error::Disconnected) {
+				disconnected();
+			}
+			return true;
+		}
+
+		size_t sent = size_t(res);
+		tune(sent, false, ar->buffer_length + HEADER_SIZE);
+		if (ar->header_offset < HEADER_SIZE) {
+			size_t header_sent = std::min(sent, HEADER_SIZE - ar->header_offset);
+			ar->header_offset += header_sent;
+			sent -= header_sent;
+		}
+		ar->bytes_transferred += sent;
+	}
+}
+
+void os::posix::named_pipe::progress(async_request *ar) {
+	std::unique_lock<std::mutex> ul(lock);
+	advance(ar);
+	if ((ar->type != async_request::request_type::Write) && (backlog > 0)) {
+		// Whoever waits on a read sends what try_write() left behind too, the remote end may wait for it first.
+		drain();
+	}
+
+	// Callbacks may issue I/O on this pipe again, so they run without the lock.
+	if (disconnect_pending) {
+		disconnect_pending = false;
+		ul.unlock();
+		notify_disconnect();
+	}
+	notify_writable();
+}
+
+bool os::posix::named_pipe::message_ready() {
+	int bytes = 0;
+	if (ioctl(handle, FIONREAD, &bytes) != 0) {
+		// Let the read report it.
+		return true;
+	}
+
+	size_t ready = size_t(bytes);
+	if (read_state.remaining > 0) {
+		// The rest of a message that did not fit last time.
+		return ready >= read_state.remaining;
+	} else if (ready == 0) {
+		// Nothing, unless the remote end hung up, which the read reports.
+		char    byte = 0;
+		ssize_t res  = recv(handle, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+		return (res == 0) || ((res < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR));
+	}
+
+	size_t   missing = HEADER_SIZE - read_state.header_length;
+	uint32_t header  = read_state.header;
+	if ((ready < missing)
+		|| (recv(handle, reinterpret_cast<char *>(&header) + read_state.header_length, missing,
+				 MSG_PEEK | MSG_DONTWAIT)
+			!= ssize_t(missing))) {
+		return false;
+	}
+	return (ready - missing) >= header;
+}
+
+void os::posix::named_pipe::drain() {
+	while (!write_queue.empty()) {
+		async_request *head = write_queue.head;
+		advance(head);
+		if (!head->complete) {
+			break;
+		}
+	}
+}
+
+void os::posix::named_pipe::flush() {
+	std::unique_lock<std::mutex> ul(lock);
+	drain();
+
+	if (disconnect_pending) {
+		disconnect_pending = false;
+		ul.unlock();
+		notify_disconnect();
+	}
+	notify_writable();
+}
+
+void os::posix::named_pipe::recycle(async_request *ar) {
+	write_backlog::copy *copy = static_cast<write_backlog::copy *>(ar);
+	backlog -= copy->data.size() + HEADER_SIZE;
+	copy->data.release();
+	spill->spare.push_back(copy);
+
+	if (above_high && (backlog <= low_watermark)) {
+		above_high = false;
+		writable.signal();
+	}
+	if (backlog == 0) {
+		backlog_changed();
+	}
+}
+
+void os::posix::named_pipe::backlog_changed() {
+	writable.changed();
+
+	// Pending reads and the readiness also wait for room to send the backlog while there is one.
+	readable.changed();
+	for (async_request *ar = read_queue.head; ar; ar = ar->next_queued) {
+		ar->notify_changed();
+	}
+}
+
+void os::posix::named_pipe::notify_writable() {
+	bool is_writable = !above_high.load(std::memory_order_acquire);
+	if (writable_notified.load(std::memory_order_acquire) == is_writable) {
+		return;
+	} else if (writable_notified.exchange(is_writable) == is_writable) {
+		return;
+	}
+
+	std::function<void(bool)> cb;
+	{
+		std::unique_lock<std::mutex> ul(callback_lock);
+		cb = writable_callback;
+	}
+	if (cb) {
+		cb(is_writable);
+	}
+}
+
+void os::posix::named_pipe::advance(async_request *ar) {
+	if (ar->type == async_request::request_type::Accept) {
+		if ((accept_request == ar) && progress_accept(ar)) {
+			latency[size_t(os::latency_type::Accept)].record(std::chrono::steady_clock::now() - ar->submitted);
+			accept_request = nullptr;
+		}
+		return;
+	}
+
+	// Requests complete in the order they were issued, so progress is always made on the oldest one.
+	request_queue &queue = (ar->type == async_request::request_type::Write) ? write_queue : read_queue;
+	while (!queue.empty()) {
+		async_request *front = queue.head;
+		bool           done  = (ar->type == async_request::request_type::Write) ? progress_write(front)
+																				 : progress_read(front);
+		if (!done) {
+			break;
+		}
+		account(front);
+		queue.pop_front();
+		if (front->spilled) {
+			recycle(front);
+		}
+		if (front == ar) {
+			break;
+		}
+	}
+
+	if ((ar->type == async_request::request_type::Write) && !ar->complete
+		&& (ar->blocked_since == std::chrono::steady_clock::time_point())) {
+		ar->blocked_since = std::chrono::steady_clock::now();
+	}
+}
+
+void os::posix::named_pipe::remove(async_request *ar) {
+	std::unique_lock<std::mutex> ul(lock);
+	if (accept_request == ar) {
+		accept_request = nullptr;
+	}
+	dequeue(ar);
+}
+
+void os::posix::named_pipe::dequeue(async_request *ar) {
+	if (!ar->queued) {
+		return;
+	}
+	if (read_queue.erase(ar)) {
+		counters.add(os::stats_counters::counter::PendingReads, -1);
+	} else if (write_queue.erase(ar)) {
+		counters.add(os::stats_counters::counter::PendingWrites, -1);
+	}
+}
+
+int os::posix::named_pipe::get_fd(async_request *ar) {
+	std::unique_lock<std::mutex> ul(lock);
+	if (ar->complete) {
+		return -1;
+	}
+	if (ar->type == async_request::request_type::Accept) {
+		return owner ? owner->fd : -1;
+	}
+	return handle;
+}
+
+uint64_t os::posix::named_pipe::get_generation(async_request *ar) {
+	if (ar->type == async_request::request_type::Accept) {
+		return owner ? owner->generation : 0;
+	}
+	return generation;
+}
+
+bool os::posix::named_pipe::consume(async_request *ar) {
+	if (!ar->complete) {
+		progress(ar);
+	}
+
+	std::unique_lock<std::mutex> ul(lock);
+	if (ar->signalled) {
+		ar->signalled = false;
+		return true;
+	}
+	return false;
+}
+
+os::error os::posix::named_pipe::available(size_t &avail) {
+	std::unique_lock<std::mutex> ul(lock);
+
+	if (handle < 0) {
+		return os::error::Disconnected;
+	}
+
+	if (read_state.remaining > 0) {
+		avail = read_state.remaining;
+		return os::error::Success;
+	} else if (read_state.header_length > 0) {
+		// A read request is in the middle of the length header.
+		avail = 0;
+		return os::error::Success;
+	}
+
+	uint32_t header = 0;
+	ssize_t  res    = recv(handle, &header, HEADER_SIZE, MSG_PEEK | MSG_DONTWAIT);
+	if (res == 0) {
+		return os::error::Disconnected;
+	} else if (res < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+			avail = 0;
+			return os::error::Success;
+		}
+		os::error ec = utility::translate_error(errno);
+		return (ec == os::error::Disconnected) ? ec : os::error::Error;
+	}
+
+	avail = (size_t(res) == HEADER_SIZE) ? header : 0;
+	return os::error::Success;
+}
+
+os::error os::posix::named_pipe::total_available(size_t &avail) {
+	if (handle < 0) {
+		return os::error::Disconnected;
+	}
+
+	// Includes the length headers of all queued messages.
+	int bytes = 0;
+	if (ioctl(handle, FIONREAD, &bytes) != 0) {
+		return os::error::Error;
+	}
+	avail = size_t(bytes);
+	return os::error::Success;
+}
+
+os::error os::posix::named_pipe::read(char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op,
+									  os::async_op_cb_t cb) {
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	}
+
+	std::shared_ptr<os::posix::async_request> ar = std::static_pointer_cast<os::posix::async_request>(op);
+	if (!ar) {
+		ar = std::make_shared<os::posix::async_request>();
+	}
+	op = std::static_pointer_cast<os::async_op>(ar);
+	ar->set_callback(cb);
+	ar->set_system_callback(nullptr);
+	bind(ar.get());
+	ar->set_pipe(this, async_request::request_type::Read, buffer, buffer_length);
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		// A request that is issued again before it completed gives up its old place in line.
+		dequeue(ar.get());
+		read_queue.push_back(ar.get());
+		counters.add(os::stats_counters::counter::PendingReads);
+	}
+	ar->set_valid(true);
+	DATALANE_TRACE(Submit, ar.get(), ar->get_trace_name());
+	progress(ar.get());
+	// After the read had its go at whatever is waiting already.
+	readable.arm();
+
+	if (ar->complete && (ar->result != os::error::Success) && (ar->result != os::error::MoreData)) {
+		os::error ec = ar->result;
+		ar->call_callback(ec, ar->bytes_transferred);
+		ar->set_valid(false);
+		return ec;
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::named_pipe::read_message(os::buffer_pool &pool, os::buffer_pool::buffer &message,
+											  std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb) {
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	}
+
+	std::shared_ptr<os::posix::async_request> ar = std::static_pointer_cast<os::posix::async_request>(op);
+	if (!ar) {
+		ar = std::make_shared<os::posix::async_request>();
+	}
+	op = std::static_pointer_cast<os::async_op>(ar);
+	message.release();
+	ar->set_callback(cb);
+	ar->set_system_callback(nullptr);
+	bind(ar.get());
+	ar->set_pipe(this, async_request::request_type::Read, nullptr, 0);
+	ar->pool    = &pool;
+	ar->message = &message;
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		dequeue(ar.get());
+		read_queue.push_back(ar.get());
+		counters.add(os::stats_counters::counter::PendingReads);
+	}
+	ar->set_valid(true);
+	DATALANE_TRACE(Submit, ar.get(), ar->get_trace_name());
+	progress(ar.get());
+	readable.arm();
+
+	if (ar->complete && (ar->result != os::error::Success)) {
+		os::error ec = ar->result;
+		ar->call_callback(ec, ar->bytes_transferred);
+		ar->set_valid(false);
+		return ec;
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::named_pipe::write(const char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op,
+									   os::async_op_cb_t cb) {
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	} else if (buffer_length > std::numeric_limits<uint32_t>::max()) {
+		return os::error::BufferTooLarge;
+	}
+
+	std::shared_ptr<os::posix::async_request> ar = std::static_pointer_cast<os::posix::async_request>(op);
+	if (!ar) {
+		ar = std::make_shared<os::posix::async_request>();
+	}
+	op = std::static_pointer_cast<os::async_op>(ar);
+	ar->set_callback(cb);
+	ar->set_system_callback(nullptr);
+	// The buffer is only ever read from for writes.
+	bind(ar.get());
+	ar->set_pipe(this, async_request::request_type::Write, const_cast<char *>(buffer), buffer_length);
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		// A request that is issued again before it completed gives up its old place in line.
+		dequeue(ar.get());
+		write_queue.push_back(ar.get());
+		counters.add(os::stats_counters::counter::PendingWrites);
+	}
+	ar->set_valid(true);
+	DATALANE_TRACE(Submit, ar.get(), ar->get_trace_name());
+	progress(ar.get());
+
+	if (ar->complete && (ar->result != os::error::Success)) {
+		os::error ec = ar->result;
+		ar->call_callback(ec, ar->bytes_transferred);
+		ar->set_valid(false);
+		return ec;
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::named_pipe::try_read(char *buffer, size_t buffer_length, size_t &read_length) {
+	read_length = 0;
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	}
+
+	os::error                    ec = os::error::WouldBlock;
+	std::unique_lock<std::mutex> ul(lock);
+	if (handle < 0) {
+		ec = os::error::Disconnected;
+	} else if (read_queue.empty() && ((mode != pipe_read_mode::Message) || message_ready())) {
+		// Message reads only start once the whole message is there, a half read one could not be put back.
+		async_request direct;
+		direct.set_pipe(nullptr, async_request::request_type::Read, buffer, buffer_length);
+		if (progress_read(&direct)) {
+			counters.add(os::stats_counters::counter::PendingReads);
+			account(&direct);
+			ec          = direct.result;
+			read_length = direct.bytes_transferred;
+		}
+	}
+
+	if (disconnect_pending) {
+		disconnect_pending = false;
+		ul.unlock();
+		notify_disconnect();
+	} else {
+		ul.unlock();
+	}
+	readable.arm();
+	return ec;
+}
+
+os::error os::posix::named_pipe::try_write(const char *buffer, size_t buffer_length) {
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	} else if (buffer_length > std::numeric_limits<uint32_t>::max()) {
+		return os::error::BufferTooLarge;
+	}
+
+	os::error                    ec = os::error::Success;
+	std::unique_lock<std::mutex> ul(lock);
+	drain();
+	if (handle < 0) {
+		ec = os::error::Disconnected;
+	} else if (above_high) {
+		ec = os::error::WouldBlock;
+	} else {
+		// Straight to the kernel unless writes are queued already.
+		async_request direct;
+		direct.set_pipe(nullptr, async_request::request_type::Write, const_cast<char *>(buffer), buffer_length);
+		counters.add(os::stats_counters::counter::PendingWrites);
+		if (write_queue.empty() && progress_write(&direct)) {
+			account(&direct);
+			ec = direct.result;
+		} else {
+			// Copy what is left, the caller may reuse the buffer right away.
+			if (!spill) {
+				spill = std::make_unique<write_backlog>();
+			}
+			write_backlog::copy *copy = nullptr;
+			if (spill->spare.empty()) {
+				spill->copies.push_back(std::make_unique<write_backlog::copy>());
+				copy          = spill->copies.back().get();
+				copy->spilled = true;
+			} else {
+				copy = spill->spare.back();
+				spill->spare.pop_back();
+			}
+			copy->data = spill->pool.acquire(buffer_length);
+			memcpy(copy->data.data(), buffer, buffer_length);
+			copy->set_pipe(nullptr, async_request::request_type::Write, copy->data.data(), buffer_length);
+			copy->header_offset     = direct.header_offset;
+			copy->bytes_transferred = direct.bytes_transferred;
+			copy->submitted         = direct.submitted;
+			copy->blocked_since     = std::chrono::steady_clock::now();
+			write_queue.push_back(copy);
+
+			if (backlog == 0) {
+				backlog_changed();
+			}
+			backlog += buffer_length + HEADER_SIZE;
+			if (backlog > high_watermark) {
+				above_high = true;
+			}
+		}
+	}
+
+	if (disconnect_pending) {
+		disconnect_pending = false;
+		ul.unlock();
+		notify_disconnect();
+	} else {
+		ul.unlock();
+	}
+	notify_writable();
+	return ec;
+}
+
+size_t os::posix::named_pipe::get_backlog() {
+	std::unique_lock<std::mutex> ul(lock);
+	return backlog;
+}
+
+void os::posix::named_pipe::set_write_watermarks(size_t low, size_t high) {
+	if (low > high) {
+		throw std::invalid_argument("'low' can't be larger than 'high'.");
+	}
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		low_watermark  = low;
+		high_watermark = high;
+		if (!above_high && (backlog > high_watermark)) {
+			above_high = true;
+		} else if (above_high && (backlog <= low_watermark)) {
+			above_high = false;
+			writable.signal();
+		}
+	}
+	notify_writable();
+}
+
+void os::posix::named_pipe::set_writable_callback(std::function<void(bool writable)> cb) {
+	std::unique_lock<std::mutex> ul(callback_lock);
+	writable_callback = cb;
+}
+
+os::waitable *os::posix::named_pipe::get_writable() {
+	return &writable;
+}
+
+os::posix::named_pipe::writability::writability(named_pipe *pipe) : pipe(pipe) {}
+
+void os::posix::named_pipe::writability::signal() {
+	signalled.store(true, std::memory_order_release);
+	notify_changed();
+}
+
+void os::posix::named_pipe::writability::changed() {
+	notify_changed();
+}
+
+int os::posix::named_pipe::writability::get_fd() {
+	if (signalled.load(std::memory_order_acquire)) {
+		// Nothing to wait for, only to consume.
+		return -1;
+	}
+	std::unique_lock<std::mutex> ul(pipe->lock);
+	return (pipe->backlog > 0) ? pipe->handle : -1;
+}
+
+short os::posix::named_pipe::writability::get_events() {
+	return POLLOUT;
+}
+
+uint64_t os::posix::named_pipe::writability::get_generation() {
+	return pipe->generation;
+}
+
+bool os::posix::named_pipe::writability::try_consume() {
+	pipe->flush();
+	if (!signalled.exchange(false)) {
+		return false;
+	}
+	// Back to waiting for the rest of the backlog, if there is any.
+	notify_changed();
+	return true;
+}
+
+void *os::posix::named_pipe::writability::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+os::posix::named_pipe::readiness::readiness(named_pipe *pipe) : pipe(pipe) {}
+
+void os::posix::named_pipe::readiness::arm() {
+	armed.store(true, std::memory_order_release);
+	notify_changed();
+}
+
+void os::posix::named_pipe::readiness::changed() {
+	notify_changed();
+}
+
+int os::posix::named_pipe::readiness::get_fd() {
+	if (!armed.load(std::memory_order_acquire)) {
+		return -1;
+	}
+	std::unique_lock<std::mutex> ul(pipe->lock);
+	return pipe->handle;
+}
+
+short os::posix::named_pipe::readiness::get_events() {
+	return (pipe->backlog > 0) ? (POLLIN | POLLOUT) : POLLIN;
+}
+
+uint64_t os::posix::named_pipe::readiness::get_generation() {
+	return pipe->generation;
+}
+
+bool os::posix::named_pipe::readiness::try_consume() {
+	if (pipe->backlog > 0) {
+		pipe->flush();
+	}
+	if (!armed.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	{
+		std::unique_lock<std::mutex> ul(pipe->lock);
+		if ((pipe->handle < 0) || (pipe->read_state.header_length > 0) || (pipe->read_state.remaining > 0)) {
+			// Not connected, or a read is in the middle of a message and takes care of it.
+			return false;
+		}
+
+		// Any byte at a message boundary starts the next message, end of file means the remote end hung up.
+		char    byte = 0;
+		ssize_t res  = recv(pipe->handle, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+		if ((res < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+			return false;
+		}
+	}
+
+	if (!armed.exchange(false)) {
+		return false;
+	}
+	// Quiet until armed again, so sets stop polling the descriptor for this.
+	notify_changed();
+	return true;
+}
+
+void *os::posix::named_pipe::readiness::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+os::waitable *os::posix::named_pipe::get_readable() {
+	return &readable;
+}
+
+bool os::posix::named_pipe::is_created() {
+	return created;
+}
+
+bool os::posix::named_pipe::is_connected() {
+	return connected.load(std::memory_order_acquire);
+}
+
+void os::posix::named_pipe::set_connected(bool is_connected) {
+	connected.store(is_connected, std::memory_order_release);
+}
+
+void os::posix::named_pipe::set_disconnect_callback(std::function<void()> cb) {
+	std::unique_lock<std::mutex> ul(callback_lock);
+	disconnect_callback = cb;
+}
+
+void os::posix::named_pipe::set_capture(std::shared_ptr<os::capture::writer> capture, uint32_t lane) {
+	this->capture = capture;
+	this->lane    = lane;
+}
+
+os::pipe_stats os::posix::named_pipe::stats() {
+	os::pipe_stats st = counters.snapshot();
+	st.send_buffer    = tuner.get_size();
+	if (st.send_buffer == 0) {
+		st.send_buffer = DEFAULT_BUFFER_SIZE;
+	}
+	return st;
+}
+
+os::histogram os::posix::named_pipe::get_latency(os::latency_type type) {
+	if (type >= os::latency_type::_Count) {
+		return os::histogram();
+	}
+	return latency[size_t(type)].get();
+}
+
+void os::posix::named_pipe::set_latency_tracking(bool enabled) {
+	for (os::latency_recorder &recorder : latency) {
+		recorder.enable(enabled);
+	}
+}
+
+void os::posix::named_pipe::reset_latency() {
+	for (os::latency_recorder &recorder : latency) {
+		recorder.reset();
+	}
+}
+
+void os::posix::named_pipe::handle_accept_callback(os::error code, size_t /*length*/) {
+	// A successful accept already marked the pipe as connected, and it may have hung up again since.
+	if ((code != os::error::Connected) && (code != os::error::Success)) {
+		set_connected(false);
+	}
+}
+
+os::error os::posix::named_pipe::accept(std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb) {
+	if (!is_created()) {
+		return os::error::Error;
+	}
+
+	std::shared_ptr<os::posix::async_request> ar = std::static_pointer_cast<os::posix::async_request>(op);
+	if (!ar) {
+		ar = std::make_shared<os::posix::async_request>();
+	}
+	op = std::static_pointer_cast<os::async_op>(ar);
+	ar->set_callback(cb);
+	// Capture only 'this' so the callback fits std::function's inline storage, a bound member pointer does not.
+	ar->set_system_callback([this](os::error code, size_t length) { handle_accept_callback(code, length); });
+	bind(ar.get());
+	ar->set_pipe(this, async_request::request_type::Accept, nullptr, 0);
+
+	if (handle >= 0) {
+		if (is_connected()) {
+			ar->set_valid(true);
+			DATALANE_TRACE(Submit, ar.get(), ar->get_trace_name());
+			ar->set_complete(os::error::Connected);
+			ar->signalled = false;
+			ar->call_callback(os::error::Connected, 0);
+			return os::error::Connected;
+		}
+
+		// Previous client went away, make room for the next one.
+		std::unique_lock<std::mutex> ul(lock);
+		detach();
+		close(handle);
+		handle = -1;
+	}
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		if (accept_request && (accept_request != ar.get())) {
+			// Only one client can be waited for at a time.
+			return os::error::Error;
+		}
+		accept_request = ar.get();
+	}
+	ar->set_valid(true);
+	DATALANE_TRACE(Submit, ar.get(), ar->get_trace_name());
+	progress(ar.get());
+
+	if (ar->complete) {
+		os::error ec = (ar->result == os::error::Success) ? os::error::Connected : ar->result;
+		ar->signalled = false;
+		ar->call_callback(ec, 0);
+		if (ec != os::error::Connected) {
+			ar->set_valid(false);
+		}
+		return ec;
+	}
+	return os::error::Pending;
+}
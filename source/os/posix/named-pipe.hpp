@@ -0,0 +1,323 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_NAMED_PIPE_HPP
+#define OS_POSIX_NAMED_PIPE_HPP
+
+#include <atomic>
+#include <functional>
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "../buffer-tuner.hpp"
+#include "../capture.hpp"
+#include "../error.hpp"
+#include "../histogram.hpp"
+#include "../stats-page.hpp"
+#include "../stats.hpp"
+#include "../tags.hpp"
+#include "async_request.hpp"
+
+#define PIPE_UNLIMITED_INSTANCES 255
+
+namespace os {
+	namespace posix {
+		enum class pipe_type : int8_t {
+			Byte = 0x00,
+			//reserved = 0x01,
+			//reserved = 0x02,
+			//reserved = 0x03,
+			Message = 0x04,
+		};
+
+		enum class pipe_read_mode : int8_t {
+			Byte = 0x00,
+			//reserved = 0x01,
+			Message = 0x02,
+		};
+
+		// Named pipe on top of an abstract AF_UNIX stream socket.
+		/// Every write is sent as one length-prefixed message so that message read mode behaves like on Windows,
+		///  including os::error::MoreData for buffers that are too small. Instances with the same name share one
+		///  listening socket, which only works within a single process.
+		class named_pipe : public os::stats_source {
+			public:
+			// Listening socket shared by all instances with the same name.
+			struct listener;
+
+			// FIFO of requests linked through async_request::next_queued.
+			struct request_queue {
+				async_request *head = nullptr;
+				async_request *tail = nullptr;
+
+				bool empty() const;
+
+				void push_back(async_request *ar);
+
+				void pop_front();
+
+				// Returns false if 'ar' was not queued here.
+				bool erase(async_request *ar);
+			};
+
+			// Signalled when a message waits to be read, see get_readable().
+			class readiness : public os::waitable, public os::posix::waitable_handle {
+				named_pipe *      pipe;
+				std::atomic<bool> armed{true};
+
+				public:
+				readiness(named_pipe *pipe);
+
+				// Fire again for the next message, and look at the pipe again if it was replaced.
+				void arm();
+
+				// Look at the backlog again, it started or stopped needing room to send.
+				void changed();
+
+				// os::posix::waitable_handle
+				virtual int get_fd() override;
+
+				virtual short get_events() override;
+
+				virtual uint64_t get_generation() override;
+
+				virtual bool try_consume() override;
+
+				// os::waitable
+				protected:
+				virtual void *get_waitable() override;
+			};
+
+			// Signalled when the backlog of try_write() fell back to the low watermark, see get_writable().
+			class writability : public os::waitable, public os::posix::waitable_handle {
+				named_pipe *      pipe;
+				std::atomic<bool> signalled{false};
+
+				public:
+				writability(named_pipe *pipe);
+
+				void signal();
+
+				// Look at the backlog again, it started or stopped needing the descriptor.
+				void changed();
+
+				// os::posix::waitable_handle
+				virtual int get_fd() override;
+
+				virtual short get_events() override;
+
+				virtual uint64_t get_generation() override;
+
+				virtual bool try_consume() override;
+
+				// os::waitable
+				protected:
+				virtual void *get_waitable() override;
+			};
+
+			// Copies of messages that try_write() could not send right away, created on first use.
+			struct write_backlog;
+
+			private:
+			int                       handle = -1;
+			// Identifies the connection behind 'handle' for os::wait_set, numbers are reused after close().
+			std::atomic<uint64_t>     generation{0};
+			bool                      created   = false;
+			std::atomic<bool>         connected{false};
+			std::shared_ptr<listener> owner;
+			pipe_type                 type = pipe_type::Message;
+			pipe_read_mode            mode = pipe_read_mode::Message;
+
+			std::mutex                 lock;
+			async_request *            accept_request = nullptr;
+			request_queue              read_queue, write_queue;
+			struct {
+				uint32_t header;
+				size_t   header_length;
+				size_t   remaining;
+			} read_state;
+
+			// Every request that points at this pipe, so that none of them is left dangling on destruction.
+			async_request *bound = nullptr;
+
+			os::stats_counters counters;
+			os::latency_recorder latency[size_t(os::latency_type::_Count)];
+			os::buffer_tuner   tuner;
+
+			// Hang-ups are reported by os::posix::hangup, the remote end may have left data behind though.
+			uint64_t              hangup_id = 0;
+			std::atomic<bool>     hung_up{false};
+			bool                  disconnect_pending = false;
+			std::mutex            callback_lock;
+			std::function<void()> disconnect_callback;
+
+			std::shared_ptr<os::capture::writer> capture = os::capture::get_default();
+			uint32_t                             lane    = os::capture::next_lane();
+
+			readiness readable{this};
+
+			// What try_write() left behind, guarded by 'lock'.
+			std::unique_ptr<write_backlog> spill;
+			size_t                         backlog        = 0;
+			size_t                         low_watermark  = 0;
+			size_t                         high_watermark = 0;
+			std::atomic<bool>              above_high{false};
+			// Last state handed to the callback, which 'callback_lock' guards.
+			std::atomic<bool>         writable_notified{true};
+			std::function<void(bool)> writable_callback;
+			writability               writable{this};
+
+			private:
+			named_pipe();
+
+			void handle_accept_callback(os::error code, size_t length);
+
+			void bind(async_request *ar);
+
+			void unbind(async_request *ar);
+
+			void account(async_request *ar);
+
+			void attach();
+
+			void detach();
+
+			static void handle_hangup(void *context);
+
+			void disconnected();
+
+			void notify_disconnect();
+
+			void tune(size_t sent, bool blocked, size_t message_length);
+
+			bool progress_accept(async_request *ar);
+
+			bool progress_read(async_request *ar);
+
+			bool progress_write(async_request *ar);
+
+			void advance(async_request *ar);
+
+			void progress(async_request *ar);
+
+			bool message_ready();
+
+			void drain();
+
+			void flush();
+
+			void recycle(async_request *ar);
+
+			void notify_writable();
+
+			void backlog_changed();
+
+			void dequeue(async_request *ar);
+
+			void remove(async_request *ar);
+
+			int get_fd(async_request *ar);
+
+			uint64_t get_generation(async_request *ar);
+
+			bool consume(async_request *ar);
+
+			public:
+			named_pipe(os::create_only_t, std::string name, size_t max_instances = PIPE_UNLIMITED_INSTANCES,
+					   pipe_type type = pipe_type::Message, pipe_read_mode mode = pipe_read_mode::Message,
+					   bool is_unique = false);
+			named_pipe(os::create_or_open_t, std::string name, size_t max_instances = PIPE_UNLIMITED_INSTANCES,
+					   pipe_type type = pipe_type::Message, pipe_read_mode mode = pipe_read_mode::Message,
+					   bool is_unique = false);
+			named_pipe(os::open_only_t, std::string name, pipe_read_mode mode = pipe_read_mode::Message);
+			~named_pipe();
+
+			os::error available(size_t &avail);
+
+			os::error total_available(size_t &avail);
+
+			os::error read(char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
+
+			// Read one whole message into a buffer from 'pool' sized to fit it, regardless of the read mode. 'message'
+			//  is replaced on completion and must stay alive until then, the callback receives the message length.
+			os::error read_message(os::buffer_pool &pool, os::buffer_pool::buffer &message,
+								   std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
+
+			os::error write(const char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op,
+							os::async_op_cb_t cb);
+
+			// Read without waiting, os::error::WouldBlock unless a whole message is there already in message read
+			//  mode, or any data in byte read mode. Reads issued earlier and still pending come first.
+			os::error try_read(char *buffer, size_t buffer_length, size_t &read_length);
+
+			// Write without waiting, os::error::WouldBlock while the backlog is above the high watermark. Otherwise
+			//  the message is taken, whatever the kernel does not take right away is copied and sent in order with
+			//  other writes whenever the pipe makes progress: waiting on a write, a read, get_readable() or
+			//  get_writable() all send it.
+			os::error try_write(const char *buffer, size_t buffer_length);
+
+			// Bytes taken by try_write() that were not sent completely yet.
+			size_t get_backlog();
+
+			// Once the backlog rises above 'high', try_write() refuses messages until it fell back to 'low'.
+			void set_write_watermarks(size_t low, size_t high);
+
+			// Called with false once the backlog rises above the high watermark, and with true once it fell back to
+			//  the low one, on whichever thread noticed. It must not destroy the pipe.
+			void set_writable_callback(std::function<void(bool writable)> cb);
+
+			// Signalled once the backlog fell back to the low watermark. Waiting on it also sends the backlog.
+			os::waitable *get_writable();
+
+			// Signalled once a message waits to be read, so that callers learn when to read without a semaphore on
+			//  the side. Edge triggered: it fires once per message, or when the remote end hangs up, then stays quiet
+			//  until the next read(), read_message() or try_read() was issued. Lives as long as the pipe, can be added
+			//  to an os::wait_set.
+			os::waitable *get_readable();
+
+			bool is_created();
+
+			bool is_connected();
+
+			void set_connected(bool is_connected);
+
+			// Called once when the remote end is found to be gone, on whichever thread noticed. It must not destroy
+			//  the pipe.
+			void set_disconnect_callback(std::function<void()> cb);
+
+			virtual os::pipe_stats stats() override;
+
+			virtual os::histogram get_latency(os::latency_type type) override;
+
+			// Latency histograms are off until enabled here, or until the pipe is published on the stats page.
+			virtual void set_latency_tracking(bool enabled) override;
+
+			void reset_latency();
+
+			// Capture every completed message into 'capture', tagged with 'lane'. Call before issuing any I/O.
+			void set_capture(std::shared_ptr<os::capture::writer> capture, uint32_t lane);
+
+			public: // created only
+			os::error accept(std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
+
+			friend class os::posix::async_request;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_NAMED_PIPE_HPP
@@ -0,0 +1,231 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "semaphore.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define MAX_NAME_LENGTH 200
+
+inline std::string make_path(std::string name) {
+	for (char &v : name) {
+		if (v == '/' || v == '\\') {
+			v = '_';
+		}
+	}
+	return "/tmp/datalane-" + name + ".sem";
+}
+
+inline void validate_params(std::string name, int32_t initial_count, int32_t maximum_count) {
+	if (initial_count > maximum_count) {
+		throw std::invalid_argument("'initial_count' can't be larger than 'maximum_count'.");
+	} else if (initial_count < 0) {
+		throw std::invalid_argument("'initial_count' can't be negative.");
+	} else if (maximum_count == 0) {
+		throw std::invalid_argument("'maximum_count' can't be 0.");
+	} else if (maximum_count < 0) {
+		throw std::invalid_argument("'maximum_count' can't be negative.");
+	} else if (name.length() == 0) {
+		throw std::invalid_argument("'name' can't be empty.");
+	} else if (name.length() >= MAX_NAME_LENGTH) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "'name' can't be longer than %d characters.", MAX_NAME_LENGTH);
+		throw std::invalid_argument(msg.data());
+	}
+}
+
+inline void create_semaphore_impl(int &handle, std::string path, int32_t initial_count) {
+	if (mkfifo(path.c_str(), 0666) != 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Semaphore creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+
+	// O_RDWR keeps open() from blocking and the FIFO from reporting a hang-up when nobody else has it open.
+	handle = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Semaphore creation failed with error code %X.", errno);
+		unlink(path.c_str());
+		throw std::runtime_error(msg.data());
+	}
+
+	if (initial_count > 0) {
+		std::vector<char> counts(initial_count, 0);
+		if (write(handle, counts.data(), counts.size()) != ssize_t(counts.size())) {
+			close(handle);
+			unlink(path.c_str());
+			throw std::runtime_error("Semaphore creation failed, initial count too large.");
+		}
+	}
+}
+
+inline void open_semaphore_impl(int &handle, std::string path) {
+	struct stat st;
+	if ((stat(path.c_str(), &st) != 0) || !S_ISFIFO(st.st_mode)) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Semaphore failed with error code %X.", errno ? errno : ENOENT);
+		throw std::runtime_error(msg.data());
+	}
+
+	handle = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Opening Semaphore failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::posix::semaphore::semaphore(int32_t initial_count /*= 0*/, int32_t maximum_count /*= INT32_MAX*/) {
+	if (initial_count > maximum_count) {
+		throw std::invalid_argument("initial_count can't be larger than maximum_count");
+	} else if (maximum_count == 0) {
+		throw std::invalid_argument("maximum_count can't be 0");
+	}
+
+	handle = eventfd(uint32_t(initial_count), EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Semaphore creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::posix::semaphore::semaphore(os::create_only_t, std::string name, int32_t initial_count /*= 0*/,
+								int32_t maximum_count /*= INT32_MAX*/) {
+	validate_params(name, initial_count, maximum_count);
+	path = make_path(name);
+	create_semaphore_impl(handle, path, initial_count);
+	named = true;
+	owner = true;
+}
+
+os::posix::semaphore::semaphore(os::create_or_open_t, std::string name, int32_t initial_count /*= 0*/,
+								int32_t maximum_count /*= INT32_MAX*/) {
+	validate_params(name, initial_count, maximum_count);
+	path = make_path(name);
+	named = true;
+	try {
+		create_semaphore_impl(handle, path, initial_count);
+		owner = true;
+	} catch (...) {
+		// There's technically two errors here, but the latter is likely to be more interesting.
+		open_semaphore_impl(handle, path);
+	}
+}
+
+os::posix::semaphore::semaphore(os::open_only_t, std::string name) {
+	validate_params(name, 0, 1);
+	path = make_path(name);
+	named = true;
+	open_semaphore_impl(handle, path);
+}
+
+os::posix::semaphore::~semaphore() {
+	if (handle >= 0) {
+		close(handle);
+	}
+	if (owner) {
+		unlink(path.c_str());
+	}
+}
+
+os::error os::posix::semaphore::signal(uint32_t count /*= 1*/) {
+	if (count == 0) {
+		return os::error::Success;
+	}
+
+	if (!named) {
+		uint64_t value = count;
+		if (write(handle, &value, sizeof(value)) != sizeof(value)) {
+			if (errno == EAGAIN) {
+				return os::error::TooMuchData;
+			}
+			return os::error::Error;
+		}
+		return os::error::Success;
+	}
+
+	char     counts[64] = {0};
+	uint32_t left       = count;
+	while (left > 0) {
+		size_t  chunk  = left < sizeof(counts) ? left : sizeof(counts);
+		ssize_t result = write(handle, counts, chunk);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN) {
+				return os::error::TooMuchData;
+			}
+			return os::error::Error;
+		}
+		left -= uint32_t(result);
+	}
+	return os::error::Success;
+}
+
+int os::posix::semaphore::get_fd() {
+	return handle;
+}
+
+short os::posix::semaphore::get_events() {
+	return POLLIN;
+}
+
+bool os::posix::semaphore::try_consume() {
+	if (!named) {
+		uint64_t value = 0;
+		return read(handle, &value, sizeof(value)) == sizeof(value);
+	}
+
+	char value = 0;
+	return read(handle, &value, sizeof(value)) == sizeof(value);
+}
+
+void *os::posix::semaphore::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+std::shared_ptr<os::semaphore> os::semaphore::construct(uint32_t value /*= 0*/) {
+	int32_t val =
+		value <= uint32_t(std::numeric_limits<int32_t>::max()) ? int32_t(value) : std::numeric_limits<int32_t>::max();
+	return std::make_shared<os::posix::semaphore>(val);
+}
+
+std::shared_ptr<os::semaphore> os::semaphore::construct(os::create_only_t, std::string name, uint32_t value /*= 0*/) {
+	int32_t val =
+		value <= uint32_t(std::numeric_limits<int32_t>::max()) ? int32_t(value) : std::numeric_limits<int32_t>::max();
+	return std::make_shared<os::posix::semaphore>(os::create_only, name, val);
+}
+
+std::shared_ptr<os::semaphore> os::semaphore::construct(os::create_or_open_t, std::string name,
+														uint32_t value /*= 0*/) {
+	int32_t val =
+		value <= uint32_t(std::numeric_limits<int32_t>::max()) ? int32_t(value) : std::numeric_limits<int32_t>::max();
+	return std::make_shared<os::posix::semaphore>(os::create_or_open, name, val);
+}
+
+std::shared_ptr<os::semaphore> os::semaphore::construct(os::open_only_t, std::string name) {
+	return std::make_shared<os::posix::semaphore>(os::open_only, name);
+}
@@ -0,0 +1,64 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_SEMAPHORE_HPP
+#define OS_POSIX_SEMAPHORE_HPP
+
+#include <inttypes.h>
+#include <limits>
+#include <string>
+#include "../semaphore.hpp"
+#include "../tags.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	namespace posix {
+		// Semaphore that can be waited on with poll().
+		/// Unnamed semaphores are backed by an eventfd in semaphore mode, named ones by a FIFO in which every byte
+		///  is one count. The maximum count is only validated, not enforced.
+		class semaphore : public os::semaphore, public os::posix::waitable_handle {
+			int         handle = -1;
+			bool        named  = false;
+			std::string path;
+			bool        owner = false;
+
+			public:
+			semaphore(int32_t initial_count = 0, int32_t maximum_count = std::numeric_limits<int32_t>::max());
+			semaphore(os::create_only_t, std::string name, int32_t initial_count = 0,
+					  int32_t maximum_count = std::numeric_limits<int32_t>::max());
+			semaphore(os::create_or_open_t, std::string name, int32_t initial_count = 0,
+					  int32_t maximum_count = std::numeric_limits<int32_t>::max());
+			semaphore(os::open_only_t, std::string name);
+			virtual ~semaphore();
+
+			virtual os::error signal(uint32_t count = 1) override;
+
+			// os::posix::waitable_handle
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual bool try_consume() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_SEMAPHORE_HPP
@@ -0,0 +1,123 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../shared-mutex.hpp"
+#include <errno.h>
+#include <stdexcept>
+#include <time.h>
+#include "utility.hpp"
+
+inline timespec make_deadline(clockid_t clock, std::chrono::nanoseconds timeout) {
+	timespec now;
+	clock_gettime(clock, &now);
+	auto deadline = std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec) + timeout;
+	return os::posix::utility::to_timespec(deadline);
+}
+
+inline os::error translate_lock_result(int result, pthread_mutex_t &mutex) {
+	switch (result) {
+	case 0:
+		return os::error::Success;
+	case EOWNERDEAD:
+		// The lock is ours, mark it usable again so that it doesn't turn unrecoverable once we unlock it.
+		pthread_mutex_consistent(&mutex);
+		return os::error::Disconnected;
+	case EBUSY:
+	case ETIMEDOUT:
+		return os::error::TimedOut;
+	}
+	return os::error::Error;
+}
+
+os::shared_mutex::shared_mutex() {
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	int result = pthread_mutex_init(&mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (result != 0) {
+		throw std::runtime_error("Creating the shared mutex failed.");
+	}
+}
+
+os::shared_mutex::~shared_mutex() {
+	pthread_mutex_destroy(&mutex);
+}
+
+os::error os::shared_mutex::lock() {
+	return translate_lock_result(pthread_mutex_lock(&mutex), mutex);
+}
+
+os::error os::shared_mutex::lock(std::chrono::nanoseconds timeout) {
+	if (os::posix::utility::is_infinite(timeout)) {
+		return lock();
+	} else if (timeout.count() <= 0) {
+		return translate_lock_result(pthread_mutex_trylock(&mutex), mutex);
+	}
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 30))
+	timespec deadline = make_deadline(CLOCK_MONOTONIC, timeout);
+	return translate_lock_result(pthread_mutex_clocklock(&mutex, CLOCK_MONOTONIC, &deadline), mutex);
+#else
+	timespec deadline = make_deadline(CLOCK_REALTIME, timeout);
+	return translate_lock_result(pthread_mutex_timedlock(&mutex, &deadline), mutex);
+#endif
+}
+
+os::error os::shared_mutex::unlock() {
+	return (pthread_mutex_unlock(&mutex) == 0) ? os::error::Success : os::error::Error;
+}
+
+os::shared_condition::shared_condition() : watcher(0) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	int result = pthread_cond_init(&condition, &attr);
+	pthread_condattr_destroy(&attr);
+	if (result != 0) {
+		throw std::runtime_error("Creating the shared condition failed.");
+	}
+}
+
+os::shared_condition::~shared_condition() {
+	pthread_cond_destroy(&condition);
+}
+
+os::error os::shared_condition::wait(shared_mutex &mutex) {
+	return translate_lock_result(pthread_cond_wait(&condition, &mutex.mutex), mutex.mutex);
+}
+
+os::error os::shared_condition::wait(shared_mutex &mutex, std::chrono::nanoseconds timeout) {
+	if (os::posix::utility::is_infinite(timeout)) {
+		return wait(mutex);
+	}
+
+	timespec deadline = make_deadline(CLOCK_MONOTONIC, timeout);
+	return translate_lock_result(pthread_cond_timedwait(&condition, &mutex.mutex, &deadline), mutex.mutex);
+}
+
+os::error os::shared_condition::notify_one() {
+	ring_watcher();
+	return (pthread_cond_signal(&condition) == 0) ? os::error::Success : os::error::Error;
+}
+
+os::error os::shared_condition::notify_all() {
+	ring_watcher();
+	return (pthread_cond_broadcast(&condition) == 0) ? os::error::Success : os::error::Error;
+}
@@ -0,0 +1,69 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../timer-wheel.hpp"
+#include <algorithm>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "utility.hpp"
+
+os::timer_wheel::timer_wheel(std::chrono::nanoseconds resolution) : epoch(clock::now()), resolution(resolution) {
+	if (resolution.count() <= 0) {
+		throw std::invalid_argument("'resolution' must be positive.");
+	}
+
+	// std::chrono::steady_clock is CLOCK_MONOTONIC, so deadlines can be handed to the timer as they are.
+	timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer.fd < 0) {
+		throw std::runtime_error("Creating the timer failed.");
+	}
+}
+
+os::timer_wheel::~timer_wheel() {
+	clear();
+	close(timer.fd);
+}
+
+void os::timer_wheel::arm(uint64_t tick) {
+	itimerspec spec = {};
+	if (tick != UINT64_MAX) {
+		// A zero time would disarm the timer instead.
+		auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(to_time(tick).time_since_epoch());
+		spec.it_value = os::posix::utility::to_timespec(std::max(since, std::chrono::nanoseconds(1)));
+	}
+	timerfd_settime(timer.fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+	armed = tick;
+}
+
+void *os::timer_wheel::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(&timer);
+}
+
+int os::timer_wheel::driver::get_fd() {
+	return fd;
+}
+
+short os::timer_wheel::driver::get_events() {
+	return POLLIN;
+}
+
+bool os::timer_wheel::driver::try_consume() {
+	uint64_t expirations = 0;
+	return read(fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+}
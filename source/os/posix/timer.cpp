@@ -0,0 +1,90 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "timer.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <vector>
+#include "utility.hpp"
+
+os::posix::timer::timer() {
+	handle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (handle < 0) {
+		std::vector<char> msg(2048);
+		snprintf(msg.data(), msg.size(), "Timer creation failed with error code %X.", errno);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::posix::timer::~timer() {
+	if (handle >= 0) {
+		close(handle);
+	}
+}
+
+os::error os::posix::timer::start(std::chrono::nanoseconds delay,
+								  std::chrono::nanoseconds period /*= std::chrono::nanoseconds(0)*/) {
+	// A zero delay would disarm the timer instead.
+	itimerspec spec  = {};
+	spec.it_value    = os::posix::utility::to_timespec(std::max(delay, std::chrono::nanoseconds(1)));
+	spec.it_interval = os::posix::utility::to_timespec(period);
+	if (timerfd_settime(handle, 0, &spec, nullptr) != 0) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+os::error os::posix::timer::stop() {
+	itimerspec spec = {};
+	if (timerfd_settime(handle, 0, &spec, nullptr) != 0) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+uint64_t os::posix::timer::get_expirations() {
+	return expirations;
+}
+
+int os::posix::timer::get_fd() {
+	return handle;
+}
+
+short os::posix::timer::get_events() {
+	return POLLIN;
+}
+
+bool os::posix::timer::try_consume() {
+	uint64_t value = 0;
+	if (read(handle, &value, sizeof(value)) != sizeof(value)) {
+		return false;
+	}
+	expirations = value;
+	return true;
+}
+
+void *os::posix::timer::get_waitable() {
+	return static_cast<os::posix::waitable_handle *>(this);
+}
+
+std::shared_ptr<os::timer> os::timer::construct() {
+	return std::make_shared<os::posix::timer>();
+}
@@ -0,0 +1,56 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_TIMER_HPP
+#define OS_POSIX_TIMER_HPP
+
+#include "../timer.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	namespace posix {
+		// Timer backed by a timerfd on CLOCK_MONOTONIC.
+		class timer : public os::timer, public os::posix::waitable_handle {
+			int      handle      = -1;
+			uint64_t expirations = 0;
+
+			public:
+			timer();
+			virtual ~timer();
+
+			virtual os::error start(std::chrono::nanoseconds delay,
+									std::chrono::nanoseconds period = std::chrono::nanoseconds(0)) override;
+
+			virtual os::error stop() override;
+
+			virtual uint64_t get_expirations() override;
+
+			// os::posix::waitable_handle
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual bool try_consume() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_TIMER_HPP
@@ -0,0 +1,66 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "utility.hpp"
+#include <errno.h>
+
+os::error os::posix::utility::translate_error(int error_code) {
+	switch (error_code) {
+	case 0:
+		return os::error::Success;
+	case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+	case EWOULDBLOCK:
+#endif
+	case EINPROGRESS:
+		return os::error::Pending;
+	case EPIPE:
+	case ECONNRESET:
+	case ECONNREFUSED:
+	case ENOTCONN:
+		return os::error::Disconnected;
+	case EISCONN:
+		return os::error::Connected;
+	case ETIMEDOUT:
+		return os::error::TimedOut;
+	case EMSGSIZE:
+		return os::error::BufferTooLarge;
+	case EFAULT:
+		return os::error::InvalidBuffer;
+	case EOVERFLOW:
+		// !FIXME! Should this have its own error code?
+		return os::error::TooMuchData;
+	}
+
+	return os::error::Error;
+}
+
+bool os::posix::utility::is_infinite(std::chrono::nanoseconds timeout) {
+	// Matches INFINITE on Windows, which is roughly 49.7 days.
+	return timeout >= std::chrono::milliseconds(0xFFFFFFFFull);
+}
+
+timespec os::posix::utility::to_timespec(std::chrono::nanoseconds timeout) {
+	timespec ts;
+	if (timeout.count() < 0) {
+		timeout = std::chrono::nanoseconds(0);
+	}
+	auto secs  = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+	ts.tv_sec  = time_t(secs.count());
+	ts.tv_nsec = long((timeout - secs).count());
+	return ts;
+}
@@ -0,0 +1,38 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_UTILITY_HPP
+#define OS_POSIX_UTILITY_HPP
+
+#include <chrono>
+#include <time.h>
+#include "../error.hpp"
+
+namespace os {
+	namespace posix {
+		namespace utility {
+			os::error translate_error(int error_code);
+
+			// Anything longer than this is treated as an infinite timeout.
+			bool is_infinite(std::chrono::nanoseconds timeout);
+
+			timespec to_timespec(std::chrono::nanoseconds timeout);
+		}; // namespace utility
+	}      // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_UTILITY_HPP
@@ -0,0 +1,433 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../wait-set.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "../async_op.hpp"
+#include "../trace.hpp"
+#include "utility.hpp"
+#include "waitable.hpp"
+
+typedef std::chrono::steady_clock wait_clock;
+
+// Events reported per epoll_wait(), anything beyond is picked up by the next one.
+#define MAXIMUM_EVENTS 64
+
+inline uint32_t to_epoll(short events) {
+	return ((events & POLLIN) ? uint32_t(EPOLLIN) : 0) | ((events & POLLOUT) ? uint32_t(EPOLLOUT) : 0)
+		   | ((events & POLLPRI) ? uint32_t(EPOLLPRI) : 0);
+}
+
+void os::wait_set::member::changed() {
+	owner->mark(this);
+}
+
+os::wait_set::wait_set() {
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll < 0) {
+		throw std::runtime_error("Creating the wait set failed.");
+	}
+
+	timer  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	epoll_event timer_ev  = {};
+	timer_ev.events       = EPOLLIN;
+	timer_ev.data.fd      = timer;
+	epoll_event wakeup_ev = {};
+	wakeup_ev.events      = EPOLLIN;
+	wakeup_ev.data.fd     = wakeup;
+	if ((timer < 0) || (wakeup < 0) || (epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &timer_ev) != 0)
+		|| (epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &wakeup_ev) != 0)) {
+		if (timer >= 0) {
+			close(timer);
+		}
+		if (wakeup >= 0) {
+			close(wakeup);
+		}
+		close(epoll);
+		throw std::runtime_error("Creating the wait set failed.");
+	}
+}
+
+os::wait_set::~wait_set() {
+	for (auto &m : members) {
+		m->handle->watch(nullptr);
+	}
+	close(wakeup);
+	close(timer);
+	close(epoll);
+}
+
+void os::wait_set::mark(member *m) {
+	std::unique_lock<std::mutex> ul(dirty_lock);
+	if (!m->dirty) {
+		m->dirty = true;
+		dirty.push_back(m);
+	}
+
+	// Only another thread can mark a member while the wait blocks, nothing else would tell epoll_wait().
+	if (sleeping) {
+		sleeping     = false;
+		uint64_t one = 1;
+		(void)write(wakeup, &one, sizeof(one));
+	}
+}
+
+void os::wait_set::join(member *m) {
+	descriptor &d = descriptors[m->fd];
+	if (d.generation != m->generation) {
+		// The number now refers to another file, whatever was registered under it is stale.
+		if (d.added) {
+			epoll_ctl(epoll, EPOLL_CTL_DEL, m->fd, nullptr);
+		}
+		d.added      = false;
+		d.registered = 0;
+		d.generation = m->generation;
+	}
+	d.members.push_back(m);
+}
+
+void os::wait_set::leave(member *m) {
+	if (m->fd < 0) {
+		return;
+	}
+
+	auto it = descriptors.find(m->fd);
+	if (it != descriptors.end()) {
+		descriptor &d = it->second;
+		for (size_t idx = 0; idx < d.members.size(); idx++) {
+			if (d.members[idx] == m) {
+				d.members[idx] = d.members.back();
+				d.members.pop_back();
+				break;
+			}
+		}
+		if (d.members.empty()) {
+			// Fails harmlessly if the file was closed in the meantime.
+			if (d.added) {
+				epoll_ctl(epoll, EPOLL_CTL_DEL, m->fd, nullptr);
+			}
+			descriptors.erase(it);
+		}
+	}
+	m->fd     = -1;
+	m->active = false;
+}
+
+os::error os::wait_set::update(int fd, descriptor &d, bool drop_idle) {
+	uint32_t wanted = 0;
+	for (member *m : d.members) {
+		if (m->active) {
+			wanted |= m->events;
+		}
+	}
+
+	if (wanted == 0) {
+		// Descriptors nobody waits on right now stay registered until they report something, requests are usually
+		//  issued again right away.
+		if (drop_idle && d.added) {
+			epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+			d.added      = false;
+			d.registered = 0;
+		}
+		return os::error::Success;
+	} else if (d.added && (wanted == d.registered)) {
+		return os::error::Success;
+	}
+
+	epoll_event ev = {};
+	ev.events      = wanted;
+	ev.data.fd     = fd;
+	int result     = epoll_ctl(epoll, d.added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+	if ((result != 0) && (errno == ENOENT)) {
+		// Closed and reopened under the same number since the last wait.
+		result = epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+	} else if ((result != 0) && (errno == EEXIST)) {
+		result = epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &ev);
+	}
+	if (result != 0) {
+		return os::error::Error;
+	}
+	d.added      = true;
+	d.registered = wanted;
+	return os::error::Success;
+}
+
+os::error os::wait_set::refresh(std::vector<waitable *> &ready, size_t max) {
+	{
+		std::unique_lock<std::mutex> ul(dirty_lock);
+		dirty_scratch.swap(dirty);
+		for (member *m : dirty_scratch) {
+			m->dirty = false;
+		}
+	}
+
+	os::error ec = os::error::Success;
+	for (size_t idx = 0; idx < dirty_scratch.size(); idx++) {
+		member *m = dirty_scratch[idx];
+		if (ready.size() >= max) {
+			// Over budget, look at the rest next time.
+			mark(m);
+			continue;
+		}
+
+		int fd = m->handle->get_fd();
+		if (fd < 0) {
+			// Complete, or nothing to wait for, like in os::waitable::wait_any().
+			m->active = false;
+			if (m->handle->try_consume()) {
+				ready.push_back(m->item);
+			}
+			continue;
+		}
+
+		uint64_t generation = m->handle->get_generation();
+		if ((fd != m->fd) || (generation != m->generation)) {
+			leave(m);
+			m->fd         = fd;
+			m->generation = generation;
+			join(m);
+		}
+		m->active = true;
+		m->events = to_epoll(m->handle->get_events());
+		if (update(fd, descriptors[fd], false) != os::error::Success) {
+			ec = os::error::Error;
+		}
+	}
+	dirty_scratch.clear();
+	return ec;
+}
+
+bool os::wait_set::add(waitable *item) {
+	if (!item) {
+		return false;
+	}
+	for (auto &m : members) {
+		if (m->item == item) {
+			return false;
+		}
+	}
+
+	std::unique_ptr<member> m = std::make_unique<member>();
+	m->owner                  = this;
+	m->item                   = item;
+	m->handle                 = static_cast<os::posix::waitable_handle *>(item->get_waitable());
+	m->handle->watch(m.get());
+	mark(m.get());
+	members.push_back(std::move(m));
+	return true;
+}
+
+bool os::wait_set::remove(waitable *item) {
+	for (size_t idx = 0; idx < members.size(); idx++) {
+		member *m = members[idx].get();
+		if (m->item != item) {
+			continue;
+		}
+
+		m->handle->watch(nullptr);
+		{
+			std::unique_lock<std::mutex> ul(dirty_lock);
+			for (size_t pos = 0; pos < dirty.size(); pos++) {
+				if (dirty[pos] == m) {
+					dirty.erase(dirty.begin() + pos);
+					break;
+				}
+			}
+		}
+		leave(m);
+		members.erase(members.begin() + idx);
+		return true;
+	}
+	return false;
+}
+
+size_t os::wait_set::size() {
+	return members.size();
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready, size_t max, std::chrono::nanoseconds timeout) {
+	if (max == 0) {
+		throw std::invalid_argument("'max' must be at least one.");
+	}
+	DATALANE_TRACE_SCOPE(Wait, nullptr, "wait_set");
+
+	bool                   infinite = os::posix::utility::is_infinite(timeout);
+	wait_clock::time_point start    = wait_clock::now();
+	wait_clock::time_point deadline = start + (infinite ? std::chrono::nanoseconds(0) : timeout);
+
+	ready.clear();
+	bool                     armed      = false;
+	bool                     polled     = false;
+	bool                     slept      = false;
+	std::chrono::nanoseconds spin       = spinner.begin(start);
+	wait_clock::time_point   spin_until = infinite ? (start + spin) : std::min(start + spin, deadline);
+	for (;;) {
+		os::error ec = refresh(ready, max);
+		if (ec != os::error::Success) {
+			return ec;
+		} else if (!ready.empty()) {
+			break;
+		}
+
+		// Poll without blocking while the spin budget lasts. Completions from other threads only need the dirty
+		//  list, data from the other side of a pipe needs epoll_wait().
+		bool spinning = (spin.count() > 0) && (wait_clock::now() < spin_until);
+
+		// The timer wakes epoll_wait() up at the deadline, once that passed there is one last look without
+		//  blocking. It is left armed afterwards, a stale expiry only costs a spurious wakeup.
+		int  timeout_ms = -1;
+		bool last       = false;
+		if (spinning) {
+			timeout_ms = 0;
+			polled     = true;
+		} else if (!infinite) {
+			if ((deadline - wait_clock::now()).count() <= 0) {
+				timeout_ms = 0;
+				last       = true;
+			} else if (!armed) {
+				itimerspec spec = {};
+				spec.it_value   = os::posix::utility::to_timespec(
+					  std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()));
+				if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+					return os::error::Error;
+				}
+				armed = true;
+			}
+		}
+
+		if (timeout_ms != 0) {
+			// Members marked from here on wake the wait up, those marked since refresh() are looked at first.
+			std::unique_lock<std::mutex> ul(dirty_lock);
+			if (!dirty.empty()) {
+				continue;
+			}
+			sleeping = true;
+		}
+		slept = slept || (timeout_ms != 0);
+
+		epoll_event events[MAXIMUM_EVENTS];
+		int         count = epoll_wait(epoll, events, int(std::min<size_t>(MAXIMUM_EVENTS, max)), timeout_ms);
+		if (timeout_ms != 0) {
+			std::unique_lock<std::mutex> ul(dirty_lock);
+			sleeping = false;
+		}
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return os::error::Error;
+		}
+
+		for (int idx = 0; idx < count; idx++) {
+			if (events[idx].data.fd == timer) {
+				uint64_t expirations = 0;
+				(void)read(timer, &expirations, sizeof(expirations));
+				continue;
+			} else if (events[idx].data.fd == wakeup) {
+				// The marked members are picked up by the next refresh().
+				uint64_t marks = 0;
+				(void)read(wakeup, &marks, sizeof(marks));
+				continue;
+			}
+
+			auto it = descriptors.find(events[idx].data.fd);
+			if (it == descriptors.end()) {
+				continue;
+			}
+
+			// Level triggered, so members left over when the budget runs out are reported again. epoll hands out
+			//  ready descriptors round robin, which keeps the budget fair.
+			bool        wanted = false;
+			descriptor &d      = it->second;
+			size_t      count  = d.members.size();
+			size_t      offset = (count > 0) ? (d.next % count) : 0;
+			for (size_t pos = 0; pos < count; pos++) {
+				member *m = d.members[(offset + pos) % count];
+				if (!m->active || !(events[idx].events & (m->events | EPOLLERR | EPOLLHUP))) {
+					continue;
+				}
+				wanted = true;
+				if ((ready.size() < max) && m->handle->try_consume()) {
+					ready.push_back(m->item);
+					d.next = offset + pos + 1;
+				}
+			}
+			if (!wanted) {
+				// Nobody is interested, and errors or hang-ups would be reported on every wait from now on.
+				if (update(it->first, it->second, true) != os::error::Success) {
+					return os::error::Error;
+				}
+			}
+		}
+		if (!ready.empty()) {
+			break;
+		} else if (last) {
+			// A set timing out says nothing about any single member, so unlike wait_any() they are not told.
+			spinner.end(start, wait_clock::now(), spin, polled, slept, false);
+			return os::error::TimedOut;
+		} else if (spinning) {
+			spinner.relax();
+		}
+	}
+
+	wait_clock::time_point end = wait_clock::now();
+	spinner.end(start, end, spin, polled, slept, true);
+	std::chrono::nanoseconds blocked = end - start;
+	for (waitable *item : ready) {
+		static_cast<os::posix::waitable_handle *>(item->get_waitable())->on_wakeup(blocked);
+		os::async_op *aop = dynamic_cast<os::async_op *>(item);
+		if (aop) {
+			aop->call_callback();
+		}
+	}
+	return os::error::Success;
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready, std::chrono::nanoseconds timeout) {
+	return wait(ready, SIZE_MAX, timeout);
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready) {
+	return wait(ready, SIZE_MAX, std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+size_t os::wait_set::poll_completions(size_t max) {
+	if (wait(completed, max, std::chrono::nanoseconds(0)) != os::error::Success) {
+		return 0;
+	}
+	return completed.size();
+}
+
+void os::wait_set::set_spin_policy(const os::spin_policy &policy) {
+	spinner.set_policy(policy);
+}
+
+os::spin_policy os::wait_set::get_spin_policy() {
+	return spinner.get_policy();
+}
+
+os::spin_stats os::wait_set::get_spin_stats() {
+	return spinner.get_stats();
+}
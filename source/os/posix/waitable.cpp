@@ -0,0 +1,258 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdexcept>
+#include "../async_op.hpp"
+#include "../trace.hpp"
+#include "../waitable.hpp"
+#include "utility.hpp"
+#include "waitable.hpp"
+
+typedef std::chrono::steady_clock wait_clock;
+
+inline os::posix::waitable_handle *get_handle(os::waitable *item) {
+	return static_cast<os::posix::waitable_handle *>(item->get_waitable());
+}
+
+inline void call_callback(os::waitable *item) {
+	os::async_op *aop = dynamic_cast<os::async_op *>(item);
+	if (aop) {
+		aop->call_callback();
+	}
+}
+
+// Once the deadline passed there is one last look without blocking, 'last' tells the caller to give up after it.
+inline os::error poll_items(pollfd *fds, size_t fds_count, bool infinite, wait_clock::time_point deadline,
+							bool &last) {
+	timespec ts;
+	if (!infinite) {
+		auto remaining = deadline - wait_clock::now();
+		last           = remaining.count() <= 0;
+		ts = os::posix::utility::to_timespec(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining));
+	}
+
+	int result = ppoll(fds, nfds_t(fds_count), infinite ? nullptr : &ts, nullptr);
+	if ((result < 0) && (errno != EINTR)) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+os::error os::waitable::wait(waitable *item, std::chrono::nanoseconds timeout) {
+	size_t signalled_index = 0;
+	return wait_any(&item, 1, signalled_index, timeout);
+}
+
+os::error os::waitable::wait(waitable *item) {
+	return wait(item, std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+os::error os::waitable::wait_any(waitable **items, size_t items_count, size_t &signalled_index,
+								 std::chrono::nanoseconds timeout) {
+	size_t    signalled_count = 0;
+	os::error ec              = wait_many(items, items_count, &signalled_index, 1, signalled_count, timeout);
+	if (ec == os::error::TimedOut) {
+		signalled_index = -1;
+	}
+	return ec;
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, std::chrono::nanoseconds timeout) {
+	size_t cursor = 0;
+	return wait_many(items, items_count, signalled, max, signalled_count, cursor, timeout);
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, size_t &cursor, std::chrono::nanoseconds timeout) {
+	if (items == nullptr) {
+		throw std::invalid_argument("'items' can't be nullptr.");
+	} else if ((signalled == nullptr) || (max == 0)) {
+		throw std::invalid_argument("'signalled' needs room for at least one index.");
+	}
+	DATALANE_TRACE_SCOPE(Wait, (items_count == 1) ? items[0] : nullptr, (max == 1) ? "wait_any" : "wait_many");
+
+	bool                   infinite = os::posix::utility::is_infinite(timeout);
+	wait_clock::time_point begin    = wait_clock::now();
+	wait_clock::time_point deadline = begin + (infinite ? std::chrono::nanoseconds(0) : timeout);
+
+	// Waiting on a handful of requests is the common case and should not allocate.
+	pollfd              local_fds[16];
+	std::vector<pollfd> heap_fds;
+	pollfd *            fds = local_fds;
+	if (items_count > (sizeof(local_fds) / sizeof(pollfd))) {
+		heap_fds.resize(items_count);
+		fds = heap_fds.data();
+	}
+
+	signalled_count = 0;
+	for (;;) {
+		for (size_t idx = 0; idx < items_count; idx++) {
+			os::posix::waitable_handle *handle = items[idx] ? get_handle(items[idx]) : nullptr;
+			fds[idx].fd      = handle ? handle->get_fd() : -1;
+			fds[idx].events  = handle ? handle->get_events() : 0;
+			fds[idx].revents = 0;
+		}
+
+		// Items without a file descriptor are complete (or never will be) and can only be consumed. Everything
+		//  else only needs progress once poll() says so, which keeps a wait on thousands of items from making a
+		//  system call per item on every wakeup.
+		size_t start = (items_count > 0) ? (cursor % items_count) : 0;
+		for (size_t pos = 0; (pos < items_count) && (signalled_count < max); pos++) {
+			size_t idx = (start + pos) % items_count;
+			if (items[idx] && (fds[idx].fd < 0) && get_handle(items[idx])->try_consume()) {
+				signalled[signalled_count++] = idx;
+			}
+		}
+
+		if (signalled_count == 0) {
+			bool      last = false;
+			os::error ec   = poll_items(fds, items_count, infinite, deadline, last);
+			if (ec != os::error::Success) {
+				return ec;
+			}
+
+			for (size_t pos = 0; (pos < items_count) && (signalled_count < max); pos++) {
+				size_t idx = (start + pos) % items_count;
+				if (items[idx] && (fds[idx].revents != 0) && get_handle(items[idx])->try_consume()) {
+					signalled[signalled_count++] = idx;
+				}
+			}
+
+			if ((signalled_count == 0) && last) {
+				for (size_t idx = 0; idx < items_count; idx++) {
+					if (items[idx]) {
+						get_handle(items[idx])->on_timeout();
+					}
+				}
+				return os::error::TimedOut;
+			}
+		}
+
+		if (signalled_count > 0) {
+			break;
+		}
+	}
+
+	cursor = signalled[signalled_count - 1] + 1;
+
+	// Callbacks run once everything is consumed, they may issue new requests on the same items.
+	std::chrono::nanoseconds blocked = wait_clock::now() - begin;
+	for (size_t idx = 0; idx < signalled_count; idx++) {
+		get_handle(items[signalled[idx]])->on_wakeup(blocked);
+		call_callback(items[signalled[idx]]);
+	}
+	return os::error::Success;
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count) {
+	return wait_many(items, items_count, signalled, max, signalled_count, std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, size_t &cursor) {
+	return wait_many(items, items_count, signalled, max, signalled_count, cursor,
+					 std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+os::error os::waitable::wait_any(waitable **items, size_t items_count, size_t &signalled_index) {
+	return wait_any(items, items_count, signalled_index, std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+os::error os::waitable::wait_any(std::vector<waitable *> items, size_t &signalled_index,
+								 std::chrono::nanoseconds timeout) {
+	return wait_any(items.data(), items.size(), signalled_index, timeout);
+}
+
+os::error os::waitable::wait_any(std::vector<waitable *> items, size_t &signalled_index) {
+	return wait_any(items.data(), items.size(), signalled_index);
+}
+
+os::error os::waitable::wait_all(waitable **items, size_t items_count, size_t &signalled_index,
+								 std::chrono::nanoseconds timeout) {
+	if (items == nullptr) {
+		throw std::invalid_argument("'items' can't be nullptr.");
+	}
+	DATALANE_TRACE_SCOPE(Wait, (items_count == 1) ? items[0] : nullptr, "wait_all");
+
+	// Unlike WaitForMultipleObjects this is not atomic, items are consumed as they become signalled.
+	bool                   infinite = os::posix::utility::is_infinite(timeout);
+	wait_clock::time_point start    = wait_clock::now();
+	wait_clock::time_point deadline = start + (infinite ? std::chrono::nanoseconds(0) : timeout);
+	std::vector<pollfd>    fds(items_count);
+	std::vector<bool>      signalled(items_count, false);
+	bool                   last = false;
+
+	for (;;) {
+		size_t signalled_count = 0;
+		for (size_t idx = 0; idx < items_count; idx++) {
+			if (!items[idx] || signalled[idx] || get_handle(items[idx])->try_consume()) {
+				signalled[idx] = true;
+				signalled_count++;
+			}
+		}
+		if (signalled_count == items_count) {
+			break;
+		} else if (last) {
+			for (size_t idx = 0; idx < items_count; idx++) {
+				if (items[idx]) {
+					get_handle(items[idx])->on_timeout();
+				}
+			}
+			signalled_index = -1;
+			return os::error::TimedOut;
+		}
+
+		for (size_t idx = 0; idx < items_count; idx++) {
+			os::posix::waitable_handle *handle = signalled[idx] ? nullptr : get_handle(items[idx]);
+			fds[idx].fd      = handle ? handle->get_fd() : -1;
+			fds[idx].events  = handle ? handle->get_events() : 0;
+			fds[idx].revents = 0;
+		}
+
+		os::error ec = poll_items(fds.data(), fds.size(), infinite, deadline, last);
+		if (ec != os::error::Success) {
+			return ec;
+		}
+	}
+
+	signalled_index = 0;
+	std::chrono::nanoseconds blocked = wait_clock::now() - start;
+	for (size_t idx = 0; idx < items_count; idx++) {
+		if (items[idx]) {
+			get_handle(items[idx])->on_wakeup(blocked);
+			call_callback(items[idx]);
+		}
+	}
+	return os::error::Success;
+}
+
+os::error os::waitable::wait_all(waitable **items, size_t items_count, size_t &signalled_index) {
+	return wait_all(items, items_count, signalled_index, std::chrono::milliseconds(0xFFFFFFFFull));
+}
+
+os::error os::waitable::wait_all(std::vector<waitable *> items, size_t &signalled_index,
+								 std::chrono::nanoseconds timeout) {
+	return wait_all(items.data(), items.size(), signalled_index, timeout);
+}
+
+os::error os::waitable::wait_all(std::vector<waitable *> items, size_t &signalled_index) {
+	return wait_all(items.data(), items.size(), signalled_index);
+}
@@ -0,0 +1,85 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_POSIX_WAITABLE_HPP
+#define OS_POSIX_WAITABLE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include "../waitable.hpp"
+
+namespace os {
+	namespace posix {
+		// What os::waitable::get_waitable() points at on POSIX.
+		/// There is no kernel object that becomes signalled on completion like a Windows event, so every waitable
+		///  exposes a file descriptor to poll() on plus a way to check (and consume) its signalled state.
+		class waitable_handle {
+			public:
+			// Sets that keep a waitable registered between waits, so that they only need to look at it again after
+			//  it changed.
+			class watcher {
+				public:
+				virtual void changed() = 0;
+			};
+
+			private:
+			std::atomic<watcher *> watched_by{nullptr};
+
+			protected:
+			// Implementations call this whenever get_fd() or the signalled state may have changed, from any thread.
+			inline void notify_changed() {
+				watcher *w = watched_by.load(std::memory_order_acquire);
+				if (w) {
+					w->changed();
+				}
+			};
+
+			public:
+			virtual ~waitable_handle(){};
+
+			// Only one watcher at a time, nullptr stops watching.
+			inline void watch(watcher *w) {
+				watched_by.store(w, std::memory_order_release);
+			};
+
+			// File descriptor to poll on, or -1 if there is nothing to wait for right now.
+			virtual int get_fd() = 0;
+
+			// poll() events that indicate progress can be made.
+			virtual short get_events() = 0;
+
+			// Changes whenever get_fd() starts to refer to a different file, even if the number was reused. Sets that
+			//  keep descriptors registered between waits rely on it.
+			virtual uint64_t get_generation() {
+				return 0;
+			};
+
+			// Make progress if possible and consume the signalled state, like an auto-reset event.
+			/// Returns true if the waitable was signalled.
+			virtual bool try_consume() = 0;
+
+			// Called after a wait returned because of this waitable, with the time the wait was blocked.
+			virtual void on_wakeup(std::chrono::nanoseconds /*blocked*/){};
+
+			// Called after a wait on this waitable timed out.
+			virtual void on_timeout(){};
+		};
+	} // namespace posix
+} // namespace os
+
+#endif // OS_POSIX_WAITABLE_HPP
@@ -0,0 +1,89 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "shared-mutex.hpp"
+#include <inttypes.h>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <stdio.h>
+#include <unordered_map>
+
+inline std::string make_watcher_name(uint64_t id) {
+	char name[64];
+	snprintf(name, sizeof(name), "condition-%016" PRIx64, id);
+	return name;
+}
+
+// Like the kernel objects of the mutex on Windows, every process opens the doorbell of a watcher once and keeps it.
+//  Watchers are expected to live long, so the few that come and go are not worth forgetting.
+inline std::shared_ptr<os::doorbell> get_watcher(uint64_t id) {
+	static std::mutex                                                  lock;
+	static std::unordered_map<uint64_t, std::shared_ptr<os::doorbell>> doorbells;
+
+	std::unique_lock<std::mutex> ul(lock);
+	auto                         it = doorbells.find(id);
+	if (it != doorbells.end()) {
+		return it->second;
+	}
+
+	std::shared_ptr<os::doorbell> bell;
+	try {
+		bell = os::doorbell::construct(os::open_only, make_watcher_name(id));
+	} catch (const std::exception &) {
+		// The watcher went away without unwatch(), nobody to tell.
+		return nullptr;
+	}
+	doorbells.emplace(id, bell);
+	return bell;
+}
+
+void os::shared_condition::ring_watcher() {
+	uint64_t id = watcher.load(std::memory_order_acquire);
+	if (id == 0) {
+		return;
+	}
+
+	std::shared_ptr<os::doorbell> bell = get_watcher(id);
+	if (bell) {
+		bell->ring();
+	}
+}
+
+std::shared_ptr<os::doorbell> os::shared_condition::watch() {
+	if (watcher.load(std::memory_order_acquire) != 0) {
+		return nullptr;
+	}
+
+	std::random_device random;
+	uint64_t           id = 0;
+	while (id == 0) {
+		id = (uint64_t(random()) << 32) | uint64_t(random());
+	}
+	std::shared_ptr<os::doorbell> bell = os::doorbell::construct(os::create_only, make_watcher_name(id));
+
+	uint64_t expected = 0;
+	if (!watcher.compare_exchange_strong(expected, id, std::memory_order_acq_rel)) {
+		// Somebody else was faster.
+		return nullptr;
+	}
+	return bell;
+}
+
+void os::shared_condition::unwatch() {
+	watcher.store(0, std::memory_order_release);
+}
@@ -0,0 +1,112 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_SHARED_MUTEX_HPP
+#define OS_SHARED_MUTEX_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <memory>
+#include "doorbell.hpp"
+#include "error.hpp"
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace os {
+	// Mutex for memory that is shared between processes, such as a shared memory segment or a mapped file.
+	/// Construct it in place once, from the process that sets the memory up. Every process that maps the memory
+	///  then uses it as it is, and it must not be moved or destroyed while any of them still does.
+	/// Without contention, lock() and unlock() never enter the kernel. On Linux it is a robust process-shared
+	///  pthread mutex, a futex that the kernel releases when its owner dies. The next lock() then returns
+	///  os::error::Disconnected, like an abandoned mutex on Windows: the caller owns the mutex and should repair
+	///  whatever it protects. On Windows contended waits sleep on a named kernel event, and owner death is not
+	///  detected.
+	/// Timeouts work like os::waitable::wait(), and a zero timeout only tries to lock.
+	class shared_mutex {
+#ifdef _WIN32
+		// 0 is unlocked, 1 locked, 2 locked and somebody might be sleeping.
+		std::atomic<uint32_t> state;
+		// Names the kernel event that contended lockers sleep on.
+		uint64_t id;
+#else
+		pthread_mutex_t mutex;
+#endif
+
+		public:
+		shared_mutex();
+		~shared_mutex();
+
+		shared_mutex(const shared_mutex &) = delete;
+		shared_mutex &operator=(const shared_mutex &) = delete;
+
+		os::error lock();
+
+		os::error lock(std::chrono::nanoseconds timeout);
+
+		os::error unlock();
+
+		friend class shared_condition;
+	};
+
+	// Condition variable for an os::shared_mutex, with the same placement rules.
+	/// Waits may wake up without a notification, so check the condition again afterwards.
+	/// To wait on the condition together with other waitables, watch() it: every notification then also rings a
+	///  doorbell, on top of waking the threads in wait(). Without a watcher, notifying costs one more load.
+	class shared_condition {
+#ifdef _WIN32
+		// Threads in wait() in the high half, wakeups posted to the semaphore but not taken yet in the low half.
+		std::atomic<uint64_t> waiters;
+		// Names the kernel semaphore that waiters sleep on.
+		uint64_t id;
+#else
+		pthread_cond_t condition;
+#endif
+		// Names the doorbell of the watcher, 0 while nobody watches.
+		std::atomic<uint64_t> watcher;
+
+		void ring_watcher();
+
+		public:
+		shared_condition();
+		~shared_condition();
+
+		shared_condition(const shared_condition &) = delete;
+		shared_condition &operator=(const shared_condition &) = delete;
+
+		// Unlock 'mutex' and wait for a notification, then lock it again. Returns os::error::Disconnected if the
+		//  owner of 'mutex' died in the meantime, like shared_mutex::lock().
+		os::error wait(shared_mutex &mutex);
+
+		os::error wait(shared_mutex &mutex, std::chrono::nanoseconds timeout);
+
+		os::error notify_one();
+
+		os::error notify_all();
+
+		// Doorbell rung by every notification from now on, in whichever process it comes from. Take() it empty,
+		//  then check the condition under the mutex before waiting on the doorbell, like with wait(). There is one
+		//  watcher at a time, nullptr if somebody watches already.
+		std::shared_ptr<os::doorbell> watch();
+
+		// Stop ringing the doorbell of the watcher, it can be destroyed afterwards.
+		void unwatch();
+	};
+} // namespace os
+
+#endif // OS_SHARED_MUTEX_HPP
@@ -0,0 +1,87 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "spinner.hpp"
+#include <algorithm>
+#include <thread>
+
+double os::spin_stats::get_spin_ratio() const {
+	uint64_t total = spun + slept;
+	return total ? double(spun) / double(total) : 0.;
+}
+
+void os::spinner::set_policy(const spin_policy &policy) {
+	this->policy = policy;
+}
+
+os::spin_policy os::spinner::get_policy() {
+	return policy;
+}
+
+os::spin_stats os::spinner::get_stats() {
+	return stats;
+}
+
+std::chrono::nanoseconds os::spinner::begin(clock::time_point now) {
+	polls = 0;
+	if ((policy.budget.count() <= 0) || !policy.adaptive) {
+		return std::max(policy.budget, std::chrono::nanoseconds(0));
+	} else if (last_wakeup == clock::time_point()) {
+		// Nothing to go by yet.
+		return policy.budget;
+	} else if (gap > policy.budget) {
+		return std::chrono::nanoseconds(0);
+	}
+
+	// The next message is expected about one gap after the last wakeup, give it twice that.
+	auto until = last_wakeup + gap * 2;
+	if (until <= now) {
+		return std::chrono::nanoseconds(0);
+	}
+	return std::min(policy.budget, std::chrono::duration_cast<std::chrono::nanoseconds>(until - now));
+}
+
+void os::spinner::relax() {
+	polls++;
+	if (policy.yield_interval && ((polls % policy.yield_interval) == 0)) {
+		std::this_thread::yield();
+	} else {
+		cpu_relax();
+	}
+}
+
+void os::spinner::end(clock::time_point start, clock::time_point now, std::chrono::nanoseconds spin, bool polled,
+					  bool slept, bool woken) {
+	std::chrono::nanoseconds elapsed = now - start;
+	if (slept) {
+		spin = std::min(spin, elapsed);
+		stats.slept++;
+		stats.spin_time += spin;
+		stats.sleep_time += elapsed - spin;
+	} else if (polled) {
+		stats.spun++;
+		stats.spin_time += elapsed;
+	}
+
+	if (woken) {
+		// Moving average over roughly the last eight wakeups.
+		if (last_wakeup != clock::time_point()) {
+			gap += (std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_wakeup) - gap) / 8;
+		}
+		last_wakeup = now;
+	}
+}
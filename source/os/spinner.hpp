@@ -0,0 +1,101 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_SPINNER_HPP
+#define OS_SPINNER_HPP
+
+#include <chrono>
+#include <inttypes.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace os {
+	// Polling without blocking before a wait goes to sleep in the kernel.
+	/// Being put to sleep and woken up again costs several microseconds, which dominates on channels that carry a
+	///  message every few microseconds. There a core that keeps polling is the cheaper resource.
+	struct spin_policy {
+		// How long a wait polls before it blocks, zero never polls.
+		std::chrono::nanoseconds budget = std::chrono::nanoseconds(0);
+
+		// Only poll for about twice the recent time between wakeups, and not at all if that exceeds the budget.
+		bool adaptive = false;
+
+		// Polls between giving the core to other threads, zero only hints the core with pause.
+		uint32_t yield_interval = 0;
+	};
+
+	struct spin_stats {
+		// Waits that ended while polling, and waits that had to block.
+		uint64_t spun  = 0;
+		uint64_t slept = 0;
+
+		std::chrono::nanoseconds spin_time  = std::chrono::nanoseconds(0);
+		std::chrono::nanoseconds sleep_time = std::chrono::nanoseconds(0);
+
+		// Share of the waits that never blocked.
+		double get_spin_ratio() const;
+	};
+
+	// Tell the core that this is a busy loop, so it can save power and give way to its sibling thread.
+	inline void cpu_relax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+		__yield();
+#elif defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	// Spin state of one waiter, such as a wait set.
+	class spinner {
+		public:
+		typedef std::chrono::steady_clock clock;
+
+		private:
+		spin_policy policy;
+		spin_stats  stats;
+		uint32_t    polls = 0;
+
+		// Average time between wakeups, for the adaptive policy.
+		clock::time_point        last_wakeup;
+		std::chrono::nanoseconds gap = std::chrono::nanoseconds(0);
+
+		public:
+		void set_policy(const spin_policy &policy);
+
+		spin_policy get_policy();
+
+		spin_stats get_stats();
+
+		// How long the wait starting at 'now' should poll before it blocks.
+		std::chrono::nanoseconds begin(clock::time_point now);
+
+		// Between two polls that found nothing.
+		void relax();
+
+		// The wait that began at 'start' is over. 'polled' if it polled at all, 'slept' if it blocked afterwards,
+		//  'woken' unless it timed out.
+		void end(clock::time_point start, clock::time_point now, std::chrono::nanoseconds spin, bool polled,
+				 bool slept, bool woken);
+	};
+} // namespace os
+
+#endif // OS_SPINNER_HPP
@@ -0,0 +1,479 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "stats-page.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PAGE_PREFIX "datalane-stats-"
+
+static const size_t page_size =
+	sizeof(os::stats_page::header) + os::stats_page::slot_count * sizeof(os::stats_page::slot);
+
+static uint64_t get_timestamp() {
+	return uint64_t(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+			.count());
+}
+
+static uint64_t get_process_id() {
+#ifdef _WIN32
+	return uint64_t(GetCurrentProcessId());
+#else
+	return uint64_t(getpid());
+#endif
+}
+
+static std::string get_process_name() {
+	char buffer[260] = {0};
+#ifdef _WIN32
+	DWORD length = GetModuleFileNameA(NULL, buffer, sizeof(buffer) - 1);
+	std::string path(buffer, length);
+	size_t      pos = path.find_last_of("\\/");
+	return (pos != std::string::npos) ? path.substr(pos + 1) : path;
+#else
+	FILE *file = fopen("/proc/self/comm", "r");
+	if (!file) {
+		return "";
+	}
+	size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	while ((length > 0) && (buffer[length - 1] == '\n')) {
+		length--;
+	}
+	return std::string(buffer, length);
+#endif
+}
+
+static void copy_string(char *dest, size_t dest_length, const std::string &src) {
+	size_t length = std::min(src.length(), dest_length - 1);
+	memcpy(dest, src.c_str(), length);
+	memset(dest + length, 0, dest_length - length);
+}
+
+class publisher {
+	void *                   memory = nullptr;
+	os::stats_page::header * head   = nullptr;
+	os::stats_page::slot *   slots  = nullptr;
+	std::string              name;
+#ifdef _WIN32
+	HANDLE mapping = NULL;
+#endif
+
+	std::chrono::milliseconds interval;
+	std::thread               worker;
+	std::mutex                stop_lock;
+	std::condition_variable   stop_cv;
+	bool                      stop = false;
+
+	void run();
+
+	public:
+	publisher(std::chrono::milliseconds interval);
+	~publisher();
+
+	bool is_valid() {
+		return head != nullptr;
+	}
+
+	void write(size_t index, const os::stats_page::record &rec);
+
+	void update();
+};
+
+// Everything below is guarded by 'sources_lock', including the publisher reading from the sources.
+struct source_entry {
+	std::string name;
+	size_t      slot;
+};
+static std::mutex                                sources_lock;
+static std::map<os::stats_source *, source_entry> sources;
+static std::vector<bool>                          slots_used(os::stats_page::slot_count, false);
+static std::unique_ptr<publisher>                 active;
+static bool                                       checked_environment = false;
+
+publisher::publisher(std::chrono::milliseconds interval) : interval(interval) {
+	name = os::stats_page::get_page_name(get_process_id());
+
+#ifdef _WIN32
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DWORD(page_size), name.c_str());
+	if (!mapping) {
+		return;
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, page_size);
+	if (!memory) {
+		CloseHandle(mapping);
+		mapping = NULL;
+		return;
+	}
+#else
+	// A page left behind by a crashed process with a recycled pid is replaced.
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return;
+	}
+	if (ftruncate(fd, off_t(page_size)) != 0) {
+		close(fd);
+		shm_unlink(name.c_str());
+		return;
+	}
+	memory = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+		shm_unlink(name.c_str());
+		return;
+	}
+#endif
+
+	memset(memory, 0, page_size);
+	head  = reinterpret_cast<os::stats_page::header *>(memory);
+	slots = reinterpret_cast<os::stats_page::slot *>(reinterpret_cast<char *>(memory) + sizeof(os::stats_page::header));
+
+	head->version     = os::stats_page::version;
+	head->header_size = uint16_t(sizeof(os::stats_page::header));
+	head->slot_size   = uint32_t(sizeof(os::stats_page::slot));
+	head->slot_count  = uint32_t(os::stats_page::slot_count);
+	head->pid         = get_process_id();
+	head->heartbeat.store(get_timestamp(), std::memory_order_relaxed);
+	copy_string(head->process, sizeof(head->process), get_process_name());
+	// Readers only trust the page once the magic is there.
+	std::atomic_thread_fence(std::memory_order_release);
+	head->magic = os::stats_page::magic;
+
+	worker = std::thread(&publisher::run, this);
+}
+
+publisher::~publisher() {
+	if (worker.joinable()) {
+		{
+			std::unique_lock<std::mutex> ul(stop_lock);
+			stop = true;
+		}
+		stop_cv.notify_all();
+		worker.join();
+	}
+
+	if (memory) {
+#ifdef _WIN32
+		UnmapViewOfFile(memory);
+		CloseHandle(mapping);
+#else
+		munmap(memory, page_size);
+		shm_unlink(name.c_str());
+#endif
+	}
+}
+
+void publisher::run() {
+	std::unique_lock<std::mutex> ul(stop_lock);
+	while (!stop) {
+		ul.unlock();
+		{
+			std::unique_lock<std::mutex> sl(sources_lock);
+			update();
+		}
+		ul.lock();
+		stop_cv.wait_for(ul, interval, [this]() { return stop; });
+	}
+}
+
+void publisher::write(size_t index, const os::stats_page::record &rec) {
+	os::stats_page::slot &dest = slots[index];
+	uint32_t              seq  = dest.sequence.load(std::memory_order_relaxed);
+	dest.sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&dest.data, &rec, sizeof(os::stats_page::record));
+	dest.sequence.store(seq + 2, std::memory_order_release);
+}
+
+void publisher::update() {
+	static const double percentiles[] = {0.5, 0.9, 0.99, 0.999};
+
+	for (auto &kv : sources) {
+		if (kv.second.slot >= os::stats_page::slot_count) {
+			continue;
+		}
+
+		os::stats_page::record rec;
+		memset(&rec, 0, sizeof(rec));
+		rec.in_use = 1;
+		copy_string(rec.name, sizeof(rec.name), kv.second.name);
+
+		os::pipe_stats st    = kv.first->stats();
+		rec.messages_in      = st.messages_in;
+		rec.messages_out     = st.messages_out;
+		rec.bytes_in         = st.bytes_in;
+		rec.bytes_out        = st.bytes_out;
+		rec.partial_reads    = st.partial_reads;
+		rec.more_data        = st.more_data;
+		rec.pending_reads    = st.pending_reads;
+		rec.pending_writes   = st.pending_writes;
+		rec.write_blocked_ns = uint64_t(st.write_blocked_time.count());
+		rec.wakeups          = st.wakeups;
+		rec.timeouts         = st.timeouts;
+
+		for (size_t type = 0; type < size_t(os::latency_type::_Count); type++) {
+			os::histogram                    snap = kv.first->get_latency(os::latency_type(type));
+			os::stats_page::latency_summary &sum  = rec.latency[type];
+			sum.count = snap.count();
+			sum.p50   = uint64_t(snap.percentile(percentiles[0]).count());
+			sum.p90   = uint64_t(snap.percentile(percentiles[1]).count());
+			sum.p99   = uint64_t(snap.percentile(percentiles[2]).count());
+			sum.p999  = uint64_t(snap.percentile(percentiles[3]).count());
+			sum.max   = uint64_t(snap.max().count());
+		}
+
+		rec.updated = get_timestamp();
+		write(kv.second.slot, rec);
+	}
+	head->heartbeat.store(get_timestamp(), std::memory_order_release);
+}
+
+// Must be called with 'sources_lock' held.
+static bool enable_locked(std::chrono::milliseconds interval) {
+	if (active) {
+		return true;
+	}
+
+	std::unique_ptr<publisher> pub = std::make_unique<publisher>(interval);
+	if (!pub->is_valid()) {
+		return false;
+	}
+	active = std::move(pub);
+	for (auto &kv : sources) {
+		kv.first->set_latency_tracking(true);
+	}
+	return true;
+}
+
+std::string os::stats_page::get_page_name(uint64_t pid) {
+#ifdef _WIN32
+	return "Local\\" PAGE_PREFIX + std::to_string(pid);
+#else
+	return "/" PAGE_PREFIX + std::to_string(pid);
+#endif
+}
+
+bool os::stats_page::enable(std::chrono::milliseconds interval) {
+	std::unique_lock<std::mutex> ul(sources_lock);
+	checked_environment = true;
+	return enable_locked(interval);
+}
+
+void os::stats_page::disable() {
+	std::unique_ptr<publisher> pub;
+	{
+		std::unique_lock<std::mutex> ul(sources_lock);
+		pub = std::move(active);
+	}
+	// The publisher thread needs the lock to finish, so it is destroyed outside of it.
+	pub.reset();
+}
+
+bool os::stats_page::is_enabled() {
+	std::unique_lock<std::mutex> ul(sources_lock);
+	return !!active;
+}
+
+void os::stats_page::add(os::stats_source *source, std::string name) {
+	std::unique_lock<std::mutex> ul(sources_lock);
+
+	if (!checked_environment) {
+		checked_environment = true;
+		const char *value   = getenv("DATALANE_STATS_PAGE");
+		if (value && (atoi(value) > 0)) {
+			enable_locked(std::chrono::milliseconds(atoi(value)));
+		}
+	}
+
+	source_entry entry;
+	entry.name = name;
+	entry.slot = slot_count;
+	for (size_t idx = 0; idx < slot_count; idx++) {
+		if (!slots_used[idx]) {
+			slots_used[idx] = true;
+			entry.slot      = idx;
+			break;
+		}
+	}
+	sources[source] = entry;
+	if (active) {
+		source->set_latency_tracking(true);
+	}
+}
+
+void os::stats_page::remove(os::stats_source *source) {
+	std::unique_lock<std::mutex> ul(sources_lock);
+
+	auto kv = sources.find(source);
+	if (kv == sources.end()) {
+		return;
+	}
+
+	if (kv->second.slot < slot_count) {
+		if (active) {
+			os::stats_page::record rec;
+			memset(&rec, 0, sizeof(rec));
+			active->write(kv->second.slot, rec);
+		}
+		slots_used[kv->second.slot] = false;
+	}
+	sources.erase(kv);
+}
+
+std::vector<std::string> os::stats_page::find_pages() {
+	std::vector<std::string> pages;
+#ifndef _WIN32
+	DIR *dir = opendir("/dev/shm");
+	if (!dir) {
+		return pages;
+	}
+	while (dirent *ent = readdir(dir)) {
+		if (strncmp(ent->d_name, PAGE_PREFIX, sizeof(PAGE_PREFIX) - 1) == 0) {
+			pages.push_back(std::string("/") + ent->d_name);
+		}
+	}
+	closedir(dir);
+#endif
+	return pages;
+}
+
+os::stats_page::reader::reader(std::string name) {
+#ifdef _WIN32
+	mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (!mapping) {
+		return;
+	}
+	memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!memory) {
+		return;
+	}
+	MEMORY_BASIC_INFORMATION info;
+	if (VirtualQuery(memory, &info, sizeof(info)) == 0) {
+		return;
+	}
+	size = info.RegionSize;
+#else
+	int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0) {
+		return;
+	}
+	struct stat st;
+	if ((fstat(fd, &st) != 0) || (st.st_size < off_t(sizeof(header)))) {
+		close(fd);
+		return;
+	}
+	memory = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		memory = nullptr;
+		return;
+	}
+	size = size_t(st.st_size);
+#endif
+
+	header *ptr = reinterpret_cast<header *>(memory);
+	if ((size < sizeof(header)) || (ptr->magic != magic)) {
+		return;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if ((ptr->version != version) || (ptr->header_size != sizeof(header)) || (ptr->slot_size != sizeof(slot))
+		|| (size < sizeof(header) + size_t(ptr->slot_count) * sizeof(slot))) {
+		return;
+	}
+
+	head  = ptr;
+	slots = reinterpret_cast<slot *>(reinterpret_cast<char *>(memory) + sizeof(header));
+}
+
+os::stats_page::reader::~reader() {
+	if (memory) {
+#ifdef _WIN32
+		UnmapViewOfFile(memory);
+#else
+		munmap(memory, size);
+#endif
+	}
+#ifdef _WIN32
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+#endif
+}
+
+bool os::stats_page::reader::is_valid() {
+	return head != nullptr;
+}
+
+uint64_t os::stats_page::reader::get_pid() {
+	return head ? head->pid : 0;
+}
+
+std::string os::stats_page::reader::get_process() {
+	if (!head) {
+		return "";
+	}
+	return std::string(head->process, strnlen(head->process, sizeof(head->process)));
+}
+
+uint64_t os::stats_page::reader::get_heartbeat() {
+	return head ? head->heartbeat.load(std::memory_order_acquire) : 0;
+}
+
+size_t os::stats_page::reader::get_slot_count() {
+	return head ? head->slot_count : 0;
+}
+
+bool os::stats_page::reader::read(size_t index, record &out) {
+	if (!head || (index >= head->slot_count)) {
+		return false;
+	}
+
+	slot &src = slots[index];
+	for (size_t tries = 0; tries < 100; tries++) {
+		uint32_t before = src.sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		memcpy(&out, &src.data, sizeof(record));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (src.sequence.load(std::memory_order_relaxed) == before) {
+			out.name[name_length - 1] = 0;
+			return out.in_use != 0;
+		}
+	}
+	return false;
+}
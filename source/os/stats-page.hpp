@@ -0,0 +1,159 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_STATS_PAGE_HPP
+#define OS_STATS_PAGE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include "histogram.hpp"
+#include "stats.hpp"
+
+namespace os {
+	// Anything that can be published on the statistics page.
+	class stats_source {
+		public:
+		virtual ~stats_source(){};
+
+		virtual os::pipe_stats stats() = 0;
+
+		virtual os::histogram get_latency(os::latency_type type) = 0;
+
+		// Called with true once the source is published, histograms cost nothing until then.
+		virtual void set_latency_tracking(bool enabled) = 0;
+	};
+
+	// Per-process shared memory page with the counters of every pipe, for tools like datalane-top.
+	/// A background thread copies the counters of all registered sources into the page at a fixed interval, so the
+	///  I/O paths never touch it. Every slot is protected by a seqlock: the writer makes the sequence odd, copies the
+	///  record and makes it even again, readers retry until they saw the same even sequence before and after copying.
+	/// Publishing is off by default, it is enabled with enable() or by setting the environment variable
+	///  DATALANE_STATS_PAGE to the update interval in milliseconds before the first pipe is created.
+	namespace stats_page {
+		static const uint32_t magic       = 0x54534C44; // "DLST"
+		static const uint16_t version     = 1;
+		static const size_t   slot_count  = 256;
+		static const size_t   name_length = 96;
+
+		struct latency_summary {
+			uint64_t count;
+			uint64_t p50;
+			uint64_t p90;
+			uint64_t p99;
+			uint64_t p999;
+			uint64_t max;
+		};
+
+		struct record {
+			// Non-zero while the slot belongs to a source.
+			uint32_t in_use;
+			uint32_t reserved;
+			char     name[name_length];
+			// Time of the last update, in nanoseconds of the monotonic clock.
+			uint64_t updated;
+
+			uint64_t messages_in;
+			uint64_t messages_out;
+			uint64_t bytes_in;
+			uint64_t bytes_out;
+			uint64_t partial_reads;
+			uint64_t more_data;
+			int64_t  pending_reads;
+			int64_t  pending_writes;
+			uint64_t write_blocked_ns;
+			uint64_t wakeups;
+			uint64_t timeouts;
+
+			latency_summary latency[size_t(os::latency_type::_Count)];
+		};
+
+		struct slot {
+			std::atomic<uint32_t> sequence;
+			uint32_t              reserved;
+			record                data;
+		};
+
+		struct header {
+			uint32_t magic;
+			uint16_t version;
+			uint16_t header_size;
+			uint32_t slot_size;
+			uint32_t slot_count;
+			uint64_t pid;
+			// Time of the last update of any slot, to detect publishers that stopped.
+			std::atomic<uint64_t> heartbeat;
+			char                  process[64];
+		};
+
+		// Name of the page of a process.
+		std::string get_page_name(uint64_t pid);
+
+		// Start publishing, updating the page every 'interval'.
+		bool enable(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+		// Stop publishing and remove the page.
+		void disable();
+
+		bool is_enabled();
+
+		// Register a source under a human readable name, called by every pipe on creation.
+		void add(os::stats_source *source, std::string name);
+
+		// Unregister a source, after this returns it is never accessed again.
+		void remove(os::stats_source *source);
+
+		// Names of all pages on this host, where the platform allows enumerating them.
+		std::vector<std::string> find_pages();
+
+		// Read-only view of another process' page.
+		class reader {
+			void *    memory = nullptr;
+			size_t    size   = 0;
+			header *  head   = nullptr;
+			slot *    slots  = nullptr;
+#ifdef _WIN32
+			void *mapping = nullptr;
+#endif
+
+			public:
+			reader(std::string name);
+			~reader();
+
+			reader(const reader &) = delete;
+			reader &operator=(const reader &) = delete;
+
+			// Did the page exist and have a known layout?
+			bool is_valid();
+
+			uint64_t get_pid();
+
+			std::string get_process();
+
+			uint64_t get_heartbeat();
+
+			size_t get_slot_count();
+
+			// Consistent copy of a slot, false if it is not in use or kept changing.
+			bool read(size_t index, record &out);
+		};
+	} // namespace stats_page
+} // namespace os
+
+#endif // OS_STATS_PAGE_HPP
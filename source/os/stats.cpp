@@ -0,0 +1,123 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "stats.hpp"
+#include <mutex>
+#include <vector>
+
+namespace {
+	// Ids of exited threads, handed out again before new ones. Never destroyed, threads may exit during static
+	//  destruction.
+	struct thread_slots {
+		std::mutex            lock;
+		std::vector<uint64_t> released;
+		uint64_t              next_id = 1;
+	};
+
+	thread_slots &get_slots() {
+		static thread_slots *instance = new thread_slots;
+		return *instance;
+	}
+
+	struct thread_slot {
+		uint64_t id;
+
+		thread_slot() {
+			thread_slots &               slots = get_slots();
+			std::unique_lock<std::mutex> ul(slots.lock);
+			if (slots.released.empty()) {
+				id = slots.next_id++;
+			} else {
+				id = slots.released.back();
+				slots.released.pop_back();
+			}
+		}
+
+		~thread_slot() {
+			thread_slots &               slots = get_slots();
+			std::unique_lock<std::mutex> ul(slots.lock);
+			slots.released.push_back(id);
+		}
+	};
+} // namespace
+
+uint64_t os::stats_counters::get_thread_id() {
+	static thread_local thread_slot slot;
+	return slot.id;
+}
+
+os::stats_counters::shard *os::stats_counters::find_shard(cache_entry &entry) {
+	uint64_t id  = get_thread_id();
+	shard *  ptr = shards.load(std::memory_order_acquire);
+	while ((ptr != nullptr) && (ptr->owner != id)) {
+		ptr = ptr->next;
+	}
+
+	if (ptr == nullptr) {
+		ptr        = new shard();
+		ptr->owner = id;
+		for (std::atomic<int64_t> &v : ptr->values) {
+			v.store(0, std::memory_order_relaxed);
+		}
+
+		// Shards are only ever added to the front and freed on destruction, so a simple CAS push is enough.
+		ptr->next = shards.load(std::memory_order_relaxed);
+		while (!shards.compare_exchange_weak(ptr->next, ptr, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+	entry.serial = serial;
+	entry.ptr    = ptr;
+	return ptr;
+}
+
+os::stats_counters::stats_counters() : shards(nullptr) {
+	static std::atomic<uint64_t> next_serial(1);
+	serial = next_serial.fetch_add(1, std::memory_order_relaxed);
+}
+
+os::stats_counters::~stats_counters() {
+	shard *ptr = shards.load(std::memory_order_acquire);
+	while (ptr != nullptr) {
+		shard *next = ptr->next;
+		delete ptr;
+		ptr = next;
+	}
+}
+
+os::pipe_stats os::stats_counters::snapshot() {
+	int64_t sums[size_t(counter::_Count)] = {0};
+	for (shard *ptr = shards.load(std::memory_order_acquire); ptr != nullptr; ptr = ptr->next) {
+		for (size_t idx = 0; idx < size_t(counter::_Count); idx++) {
+			sums[idx] += ptr->values[idx].load(std::memory_order_relaxed);
+		}
+	}
+
+	os::pipe_stats stats;
+	stats.messages_in        = uint64_t(sums[size_t(counter::MessagesIn)]);
+	stats.messages_out       = uint64_t(sums[size_t(counter::MessagesOut)]);
+	stats.bytes_in           = uint64_t(sums[size_t(counter::BytesIn)]);
+	stats.bytes_out          = uint64_t(sums[size_t(counter::BytesOut)]);
+	stats.partial_reads      = uint64_t(sums[size_t(counter::PartialReads)]);
+	stats.more_data          = uint64_t(sums[size_t(counter::MoreData)]);
+	stats.pending_reads      = sums[size_t(counter::PendingReads)];
+	stats.pending_writes     = sums[size_t(counter::PendingWrites)];
+	stats.write_blocked_time = std::chrono::nanoseconds(sums[size_t(counter::WriteBlockedTime)]);
+	stats.wakeups            = uint64_t(sums[size_t(counter::Wakeups)]);
+	stats.timeouts           = uint64_t(sums[size_t(counter::Timeouts)]);
+	return stats;
+}
@@ -0,0 +1,127 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_STATS_HPP
+#define OS_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+
+namespace os {
+	// Snapshot of the counters of a single pipe.
+	struct pipe_stats {
+		uint64_t messages_in  = 0;
+		uint64_t messages_out = 0;
+		uint64_t bytes_in     = 0;
+		uint64_t bytes_out    = 0;
+
+		// Reads that completed with only part of a message.
+		uint64_t partial_reads = 0;
+		// Reads that completed with os::error::MoreData.
+		uint64_t more_data = 0;
+
+		// Requests that were issued but have not completed yet.
+		int64_t pending_reads  = 0;
+		int64_t pending_writes = 0;
+
+		// Time from issuing a write that could not complete immediately until its completion.
+		std::chrono::nanoseconds write_blocked_time = std::chrono::nanoseconds(0);
+
+		// Waits that returned because a request of this pipe completed, or that timed out on one.
+		uint64_t wakeups  = 0;
+		uint64_t timeouts = 0;
+
+		// Kernel send buffer size the connection asked for.
+		uint64_t send_buffer = 0;
+	};
+
+	// Counters that are sharded per thread.
+	/// Every thread that touches the counters gets its own padded shard, which only that thread ever writes to.
+	///  Threads remember their shard per counter set, so adding is a lookup in a small thread local cache and a
+	///  plain load and store. Summing up all shards happens in snapshot().
+	/// Shards belong to thread slots rather than threads. A slot is handed to the next new thread once its owner
+	///  exited, which then keeps adding to the shards it inherits, so their counts are kept and the number of
+	///  shards is bounded by the number of threads that run at the same time.
+	class stats_counters {
+		public:
+		enum class counter : uint8_t {
+			MessagesIn,
+			MessagesOut,
+			BytesIn,
+			BytesOut,
+			PartialReads,
+			MoreData,
+			PendingReads,
+			PendingWrites,
+			WriteBlockedTime,
+			Wakeups,
+			Timeouts,
+
+			_Count
+		};
+
+		private:
+		struct shard {
+			uint64_t             owner;
+			shard *              next;
+			std::atomic<int64_t> values[size_t(counter::_Count)];
+			// Keeps the shards of different threads off the same cache line.
+			char padding[64];
+		};
+
+		// Direct mapped by serial, which is never reused, so entries of destroyed counter sets can't match.
+		struct cache_entry {
+			uint64_t serial;
+			shard *  ptr;
+		};
+		static const size_t CACHE_SIZE = 8;
+
+		std::atomic<shard *> shards;
+		uint64_t             serial;
+
+		static uint64_t get_thread_id();
+
+		shard *find_shard(cache_entry &entry);
+
+		inline shard *get_shard() {
+			static thread_local cache_entry cache[CACHE_SIZE] = {};
+			cache_entry &                   entry             = cache[serial % CACHE_SIZE];
+			if (entry.serial == serial) {
+				return entry.ptr;
+			}
+			return find_shard(entry);
+		}
+
+		public:
+		stats_counters();
+		~stats_counters();
+
+		stats_counters(const stats_counters &) = delete;
+		stats_counters &operator=(const stats_counters &) = delete;
+
+		inline void add(counter which, int64_t value = 1) {
+			// Only this thread writes to the shard, so there is no need for a locked read-modify-write.
+			std::atomic<int64_t> &v = get_shard()->values[size_t(which)];
+			v.store(v.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		os::pipe_stats snapshot();
+	};
+} // namespace os
+
+#endif // OS_STATS_HPP
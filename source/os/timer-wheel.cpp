@@ -0,0 +1,268 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "timer-wheel.hpp"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Ticks the top level reaches, entries further away are parked at the end and moved on when they get there.
+#define MAXIMUM_DISTANCE ((uint64_t(1) << (os::timer_wheel::SLOT_BITS * os::timer_wheel::LEVELS)) - 1)
+
+inline size_t first_set(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index, value);
+	return size_t(index);
+#else
+	return size_t(__builtin_ctzll(value));
+#endif
+}
+
+inline uint64_t rotate_right(uint64_t value, size_t count) {
+	count &= 63;
+	return count ? ((value >> count) | (value << (64 - count))) : value;
+}
+
+os::timer_wheel::entry::~entry() {
+	cancel();
+}
+
+void os::timer_wheel::entry::set_callback(callback_t callback, void *data) {
+	this->callback = callback;
+	this->data     = data;
+}
+
+bool os::timer_wheel::entry::is_scheduled() {
+	return wheel != nullptr;
+}
+
+bool os::timer_wheel::entry::cancel() {
+	return wheel ? wheel->cancel(*this) : false;
+}
+
+uint64_t os::timer_wheel::to_tick(clock::time_point time, bool round_up) {
+	if (time <= epoch) {
+		return 0;
+	}
+	std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch);
+	uint64_t                 tick    = uint64_t(elapsed.count() / resolution.count());
+	if (round_up && (elapsed.count() % resolution.count())) {
+		tick++;
+	}
+	return tick;
+}
+
+os::timer_wheel::clock::time_point os::timer_wheel::to_time(uint64_t tick) {
+	return epoch + std::chrono::duration_cast<clock::duration>(resolution * int64_t(tick));
+}
+
+uint64_t os::timer_wheel::next_event() {
+	uint64_t next = UINT64_MAX;
+	for (size_t level = 0; level < LEVELS; level++) {
+		if (!occupied[level]) {
+			continue;
+		}
+
+		// Slots are numbered by absolute time, so the slot after the current one is the closest. A slot equal to
+		//  the current one is a whole turn away.
+		size_t   shift   = level * SLOT_BITS;
+		uint64_t current = now_tick >> shift;
+		size_t   offset  = first_set(rotate_right(occupied[level], size_t(current + 1)));
+		next             = std::min(next, (current + offset + 1) << shift);
+	}
+	return next;
+}
+
+uint64_t os::timer_wheel::link(entry &e) {
+	entry ** head  = &due;
+	uint64_t event = now_tick;
+	if (e.tick > now_tick) {
+		uint64_t distance = std::min(e.tick - now_tick, MAXIMUM_DISTANCE);
+		uint64_t place    = now_tick + distance;
+		size_t   level    = 0;
+		while (((level + 1) < LEVELS) && (distance >= (uint64_t(1) << ((level + 1) * SLOT_BITS)))) {
+			level++;
+		}
+
+		size_t shift = level * SLOT_BITS;
+		e.level      = uint8_t(level);
+		e.slot       = uint8_t((place >> shift) & (SLOTS - 1));
+		head         = &slots[e.level][e.slot];
+		event        = (place >> shift) << shift;
+		occupied[e.level] |= uint64_t(1) << e.slot;
+	} else {
+		e.level = uint8_t(LEVELS);
+		e.slot  = 0;
+	}
+
+	e.prev = nullptr;
+	e.next = *head;
+	if (*head) {
+		(*head)->prev = &e;
+	}
+	*head = &e;
+	return event;
+}
+
+void os::timer_wheel::unlink(entry &e) {
+	entry **head = (e.level == LEVELS) ? &due : &slots[e.level][e.slot];
+	if (e.prev) {
+		e.prev->next = e.next;
+	} else {
+		*head = e.next;
+	}
+	if (e.next) {
+		e.next->prev = e.prev;
+	}
+	if ((e.level < LEVELS) && !*head) {
+		occupied[e.level] &= ~(uint64_t(1) << e.slot);
+	}
+	e.prev = nullptr;
+	e.next = nullptr;
+}
+
+void os::timer_wheel::advance(uint64_t tick) {
+	for (;;) {
+		uint64_t next = next_event();
+		if (next > tick) {
+			break;
+		}
+		now_tick = next;
+
+		// Higher levels first, so that entries can drop more than one level at once. Entries on the lowest level
+		//  are due now, unless they were parked because they were out of reach.
+		for (size_t level = LEVELS; level-- > 0;) {
+			size_t shift = level * SLOT_BITS;
+			if (now_tick & ((uint64_t(1) << shift) - 1)) {
+				continue;
+			}
+
+			size_t slot = size_t((now_tick >> shift) & (SLOTS - 1));
+			entry *list = slots[level][slot];
+			slots[level][slot] = nullptr;
+			occupied[level] &= ~(uint64_t(1) << slot);
+			while (list) {
+				entry *e = list;
+				list     = e->next;
+				link(*e);
+			}
+		}
+	}
+	now_tick = std::max(now_tick, tick);
+}
+
+void os::timer_wheel::clear() {
+	for (size_t level = 0; level <= LEVELS; level++) {
+		for (size_t slot = 0; slot < ((level < LEVELS) ? SLOTS : 1); slot++) {
+			entry *list = (level < LEVELS) ? slots[level][slot] : due;
+			while (list) {
+				entry *e = list;
+				list     = e->next;
+				e->wheel = nullptr;
+				e->prev  = nullptr;
+				e->next  = nullptr;
+			}
+		}
+	}
+	std::fill(&slots[0][0], &slots[0][0] + (LEVELS * SLOTS), nullptr);
+	std::fill(occupied, occupied + LEVELS, 0);
+	due   = nullptr;
+	count = 0;
+}
+
+void os::timer_wheel::rearm() {
+	uint64_t next = due ? now_tick : next_event();
+	if (next != armed) {
+		arm(next);
+	}
+}
+
+void os::timer_wheel::schedule(entry &e, clock::time_point deadline) {
+	if (e.wheel) {
+		e.wheel->cancel(e);
+	}
+	e.wheel = this;
+	e.tick  = to_tick(deadline, true);
+	count++;
+
+	uint64_t event = link(e);
+	if (event < armed) {
+		arm(event);
+	}
+}
+
+void os::timer_wheel::schedule(entry &e, std::chrono::nanoseconds timeout) {
+	clock::time_point now = clock::now();
+	if (timeout >= (clock::time_point::max() - now)) {
+		schedule(e, clock::time_point::max());
+	} else {
+		schedule(e, now + std::chrono::duration_cast<clock::duration>(timeout));
+	}
+}
+
+bool os::timer_wheel::cancel(entry &e) {
+	if (e.wheel != this) {
+		return false;
+	}
+	// The timer stays armed, waking up once for nothing is cheaper than finding the next deadline again.
+	unlink(e);
+	e.wheel = nullptr;
+	count--;
+	return true;
+}
+
+size_t os::timer_wheel::size() {
+	return count;
+}
+
+std::chrono::nanoseconds os::timer_wheel::get_resolution() {
+	return resolution;
+}
+
+os::timer_wheel::clock::time_point os::timer_wheel::get_next_deadline() {
+	uint64_t next = due ? now_tick : next_event();
+	if (next == UINT64_MAX) {
+		return clock::time_point::max();
+	}
+	return to_time(next);
+}
+
+size_t os::timer_wheel::expire(clock::time_point now) {
+	advance(to_tick(now, false));
+
+	// Callbacks may schedule or cancel entries, including the ones still waiting here.
+	size_t expired = 0;
+	while (due) {
+		entry *e = due;
+		unlink(*e);
+		e->wheel = nullptr;
+		count--;
+		expired++;
+		if (e->callback) {
+			e->callback(e->data);
+		}
+	}
+
+	rearm();
+	return expired;
+}
+
+size_t os::timer_wheel::expire() {
+	return expire(clock::now());
+}
@@ -0,0 +1,160 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_TIMER_WHEEL_HPP
+#define OS_TIMER_WHEEL_HPP
+
+#include <chrono>
+#include <inttypes.h>
+#include "waitable.hpp"
+#ifndef _WIN32
+#include "posix/waitable.hpp"
+#endif
+
+namespace os {
+	// Deadlines for thousands of pending operations, scheduled and cancelled in constant time.
+	/// A hierarchical timing wheel: LEVELS levels of SLOTS slots, where one slot of a level spans a whole turn of
+	///  the level below. Entries sit in the slot of the level that matches how far away they are, and move down a
+	///  level whenever the wheel reaches their slot, so every entry is touched at most once per level. Occupancy
+	///  bitmaps let the wheel jump straight to the next slot that has entries instead of ticking through idle time.
+	/// The wheel is a waitable: a timer (timerfd on Linux, a high resolution waitable timer on Windows) is armed for
+	///  the next time something is due. It becomes signalled once that time is reached, and expire() then calls the
+	///  callbacks of every entry whose deadline passed. Deadlines are rounded up to the resolution of the wheel, so
+	///  an entry never expires early and at most one tick late.
+	/// Not thread safe. Entries are scheduled, cancelled and expired on the thread that waits on the wheel.
+	class timer_wheel : public os::waitable {
+		public:
+		typedef std::chrono::steady_clock clock;
+		typedef void (*callback_t)(void *data);
+
+		static const size_t SLOT_BITS = 6;
+		static const size_t SLOTS     = size_t(1) << SLOT_BITS;
+		static const size_t LEVELS    = 7;
+
+		class entry {
+			timer_wheel *wheel = nullptr;
+			entry *      prev  = nullptr;
+			entry *      next  = nullptr;
+			uint64_t     tick  = 0;
+			uint8_t      level = 0;
+			uint8_t      slot  = 0;
+
+			callback_t callback = nullptr;
+			void *     data     = nullptr;
+
+			public:
+			entry(){};
+			entry(callback_t callback, void *data) : callback(callback), data(data){};
+			~entry();
+
+			entry(const entry &) = delete;
+			entry &operator=(const entry &) = delete;
+
+			void set_callback(callback_t callback, void *data);
+
+			bool is_scheduled();
+
+			// Cancel with whichever wheel it is scheduled on, returns false if it was not.
+			bool cancel();
+
+			friend class timer_wheel;
+		};
+
+		private:
+		clock::time_point        epoch;
+		std::chrono::nanoseconds resolution;
+		uint64_t                 now_tick = 0;
+		size_t                   count    = 0;
+
+		entry *  slots[LEVELS][SLOTS] = {};
+		uint64_t occupied[LEVELS]     = {};
+
+		// Entries that are due and wait for their callback.
+		entry *due = nullptr;
+
+		// Tick the timer is armed for, UINT64_MAX while disarmed.
+		uint64_t armed = UINT64_MAX;
+
+#ifdef _WIN32
+		void *timer = nullptr;
+#else
+		struct driver : public os::posix::waitable_handle {
+			int fd = -1;
+
+			virtual int get_fd() override;
+
+			virtual short get_events() override;
+
+			virtual bool try_consume() override;
+		} timer;
+#endif
+
+		uint64_t to_tick(clock::time_point time, bool round_up);
+
+		clock::time_point to_time(uint64_t tick);
+
+		// Tick at which the next slot is reached that has entries, UINT64_MAX if there is none.
+		uint64_t next_event();
+
+		// Returns the tick at which the slot 'e' went into is reached.
+		uint64_t link(entry &e);
+
+		void unlink(entry &e);
+
+		void advance(uint64_t tick);
+
+		// Unschedule everything, for the destructor.
+		void clear();
+
+		// Platform specific, in os/<platform>/timer-wheel.cpp.
+		void arm(uint64_t tick);
+
+		void rearm();
+
+		public:
+		timer_wheel(std::chrono::nanoseconds resolution = std::chrono::microseconds(1));
+		~timer_wheel();
+
+		timer_wheel(const timer_wheel &) = delete;
+		timer_wheel &operator=(const timer_wheel &) = delete;
+
+		// Schedule 'e' for 'deadline', moving it if it already is scheduled.
+		void schedule(entry &e, clock::time_point deadline);
+
+		void schedule(entry &e, std::chrono::nanoseconds timeout);
+
+		// Returns false if 'e' was not scheduled.
+		bool cancel(entry &e);
+
+		size_t size();
+
+		std::chrono::nanoseconds get_resolution();
+
+		// When expire() has something to do next, clock::time_point::max() if nothing is scheduled.
+		clock::time_point get_next_deadline();
+
+		// Call the callback of every entry whose deadline passed, returns how many were called.
+		size_t expire(clock::time_point now);
+
+		size_t expire();
+
+		// os::waitable
+		virtual void *get_waitable() override;
+	};
+} // namespace os
+
+#endif // OS_TIMER_WHEEL_HPP
@@ -0,0 +1,46 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_TIMER_HPP
+#define OS_TIMER_HPP
+
+#include <chrono>
+#include <inttypes.h>
+#include <memory>
+#include "error.hpp"
+#include "waitable.hpp"
+
+namespace os {
+	// Becomes signalled once 'delay' passed, then every 'period' if that is not zero. A wait consumes the signal
+	///  no matter how many periods passed since the last one.
+	class timer : public os::waitable {
+		public:
+		virtual os::error start(std::chrono::nanoseconds delay,
+								std::chrono::nanoseconds period = std::chrono::nanoseconds(0)) = 0;
+
+		virtual os::error stop() = 0;
+
+		// How many periods the last consumed signal stood for, more than one if the waiter fell behind. Windows
+		//  does not tell and always reports one.
+		virtual uint64_t get_expirations() = 0;
+
+		public:
+		static std::shared_ptr<os::timer> construct();
+	};
+} // namespace os
+
+#endif // OS_TIMER_HPP
@@ -0,0 +1,194 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "trace.hpp"
+
+#ifdef DATALANE_TRACING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Number of events kept per thread, must be a power of two.
+#ifndef DATALANE_TRACE_RING_SIZE
+#define DATALANE_TRACE_RING_SIZE 65536
+#endif
+
+struct trace_event {
+	int64_t               timestamp;
+	const void *          op;
+	const char *          name;
+	os::trace::event_type type;
+};
+
+// Ring buffer with a single writer, the thread it belongs to.
+struct trace_ring {
+	uint64_t                 thread_id;
+	std::atomic<uint64_t>    head;
+	std::atomic<uint64_t>    cleared;
+	std::vector<trace_event> events;
+};
+
+// Rings are never freed while the process runs, so events of threads that already exited can still be written.
+static std::mutex                               rings_lock;
+static std::vector<std::unique_ptr<trace_ring>> rings;
+
+inline uint64_t get_thread_id() {
+#ifdef _WIN32
+	return uint64_t(GetCurrentThreadId());
+#else
+	return uint64_t(syscall(SYS_gettid));
+#endif
+}
+
+inline uint64_t get_process_id() {
+#ifdef _WIN32
+	return uint64_t(GetCurrentProcessId());
+#else
+	return uint64_t(getpid());
+#endif
+}
+
+static trace_ring *get_ring() {
+	static thread_local trace_ring *ring = nullptr;
+	if (!ring) {
+		std::unique_ptr<trace_ring> new_ring = std::make_unique<trace_ring>();
+		new_ring->thread_id = get_thread_id();
+		new_ring->head.store(0);
+		new_ring->cleared.store(0);
+		new_ring->events.resize(DATALANE_TRACE_RING_SIZE);
+
+		std::unique_lock<std::mutex> ul(rings_lock);
+		ring = new_ring.get();
+		rings.push_back(std::move(new_ring));
+	}
+	return ring;
+}
+
+void os::trace::record(event_type type, const void *op, const char *name) {
+	trace_ring * ring = get_ring();
+	uint64_t     idx  = ring->head.load(std::memory_order_relaxed);
+	trace_event &ev   = ring->events[idx & (DATALANE_TRACE_RING_SIZE - 1)];
+
+	ev.timestamp =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+	ev.op   = op;
+	ev.name = name;
+	ev.type = type;
+	ring->head.store(idx + 1, std::memory_order_release);
+}
+
+bool os::trace::write_chrome_trace(std::string path) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	uint64_t pid   = get_process_id();
+	bool     first = true;
+	fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+	std::unique_lock<std::mutex> ul(rings_lock);
+	std::vector<trace_event>     events;
+	for (auto &ring : rings) {
+		uint64_t head  = ring->head.load(std::memory_order_acquire);
+		uint64_t begin = std::max<uint64_t>(ring->cleared.load(std::memory_order_relaxed),
+											(head > DATALANE_TRACE_RING_SIZE) ? head - DATALANE_TRACE_RING_SIZE : 0);
+		events.clear();
+		for (uint64_t idx = begin; idx < head; idx++) {
+			events.push_back(ring->events[idx & (DATALANE_TRACE_RING_SIZE - 1)]);
+		}
+
+		// The owner may have kept writing while copying, drop everything it could have overwritten.
+		uint64_t after = ring->head.load(std::memory_order_acquire);
+		if (after > DATALANE_TRACE_RING_SIZE + begin) {
+			size_t lost = size_t(std::min<uint64_t>(after - DATALANE_TRACE_RING_SIZE - begin, events.size()));
+			events.erase(events.begin(), events.begin() + lost);
+		}
+
+		for (trace_event &ev : events) {
+			const char *phase = "i";
+			switch (ev.type) {
+			case event_type::Submit:
+				phase = "b";
+				break;
+			case event_type::Complete:
+				phase = "e";
+				break;
+			case event_type::CallbackBegin:
+			case event_type::WaitBegin:
+				phase = "B";
+				break;
+			case event_type::CallbackEnd:
+			case event_type::WaitEnd:
+				phase = "E";
+				break;
+			}
+
+			// Operations are async events keyed by their address, everything else is a slice on the thread.
+			fprintf(file,
+					"%s\n\t{\"name\": \"%s\", \"cat\": \"datalane\", \"ph\": \"%s\", \"pid\": %" PRIu64
+					", \"tid\": %" PRIu64 ", \"ts\": %.3f, \"id\": \"0x%" PRIxPTR "\", \"args\": {\"op\": \"0x%" PRIxPTR
+					"\"}}",
+					first ? "" : ",", ev.name, phase, pid, ring->thread_id, double(ev.timestamp) / 1000.0,
+					uintptr_t(ev.op), uintptr_t(ev.op));
+			first = false;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	bool success = (ferror(file) == 0);
+	fclose(file);
+	return success;
+}
+
+void os::trace::clear() {
+	std::unique_lock<std::mutex> ul(rings_lock);
+	for (auto &ring : rings) {
+		ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+bool os::trace::is_enabled() {
+	return true;
+}
+
+#else
+
+void os::trace::record(event_type, const void *, const char *) {}
+
+bool os::trace::write_chrome_trace(std::string) {
+	return false;
+}
+
+void os::trace::clear() {}
+
+bool os::trace::is_enabled() {
+	return false;
+}
+
+#endif
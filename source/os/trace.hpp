@@ -0,0 +1,92 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_TRACE_HPP
+#define OS_TRACE_HPP
+
+#include <inttypes.h>
+#include <string>
+
+// Tracing of async_op events for chrome://tracing and Perfetto.
+/// Only compiled in when DATALANE_TRACING is defined (CMake option ENABLE_TRACING), otherwise DATALANE_TRACE expands
+///  to nothing and no event is ever recorded.
+#ifdef DATALANE_TRACING
+#define DATALANE_TRACE_CONCAT_(a, b) a##b
+#define DATALANE_TRACE_CONCAT(a, b) DATALANE_TRACE_CONCAT_(a, b)
+#define DATALANE_TRACE(type, op, name) ::os::trace::record(::os::trace::event_type::type, op, name)
+// Records type##Begin now and type##End when the enclosing scope is left.
+#define DATALANE_TRACE_SCOPE(type, op, name)                                                                  \
+	::os::trace::scope DATALANE_TRACE_CONCAT(trace_scope_, __LINE__)(::os::trace::event_type::type##Begin, \
+																	 ::os::trace::event_type::type##End, op, name)
+#else
+#define DATALANE_TRACE(type, op, name) \
+	do {                               \
+	} while (false)
+#define DATALANE_TRACE_SCOPE(type, op, name) \
+	do {                                     \
+	} while (false)
+#endif
+
+namespace os {
+	namespace trace {
+		enum class event_type : uint8_t {
+			// An operation was issued.
+			Submit,
+			// An operation finished, successfully or not.
+			Complete,
+			// A user callback starts or returns.
+			CallbackBegin,
+			CallbackEnd,
+			// A thread starts or stops blocking in os::waitable.
+			WaitBegin,
+			WaitEnd,
+		};
+
+		// Record an event in the ring buffer of the calling thread.
+		/// 'name' must be a string literal, only the pointer is stored.
+		void record(event_type type, const void *op, const char *name);
+
+		// Write all recorded events of all threads as Chrome trace JSON.
+		/// Timestamps come from a monotonic system-wide clock, so traces of several processes can be merged onto one
+		///  timeline. Threads that are still recording may lose their oldest events. Returns false if tracing is not
+		///  compiled in or the file could not be written.
+		bool write_chrome_trace(std::string path);
+
+		// Drop all recorded events.
+		void clear();
+
+		// Is tracing compiled in?
+		bool is_enabled();
+
+		class scope {
+			event_type  end;
+			const void *op;
+			const char *name;
+
+			public:
+			scope(event_type begin, event_type end, const void *op, const char *name)
+				: end(end), op(op), name(name) {
+				record(begin, op, name);
+			}
+			~scope() {
+				record(end, op, name);
+			}
+		};
+	} // namespace trace
+} // namespace os
+
+#endif // OS_TRACE_HPP
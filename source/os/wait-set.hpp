@@ -0,0 +1,141 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_WAIT_SET_HPP
+#define OS_WAIT_SET_HPP
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "error.hpp"
+#include "spinner.hpp"
+#include "waitable.hpp"
+#ifndef _WIN32
+#include "posix/waitable.hpp"
+#endif
+
+namespace os {
+	// Waitables that are waited on together over and over, like the requests of a server loop.
+	/// Members are added and removed once instead of being handed to every wait. On Linux the set keeps an epoll
+	///  instance and members report when they change, so a wait only looks at members that are ready or were
+	///  reissued instead of all of them. A member completed on another thread, like a request cancelled there,
+	///  wakes a blocking wait up. On Windows the handle array is kept between waits and limited to
+	///  MAXIMUM_WAIT_OBJECTS members.
+	/// Not thread safe. Members must be removed before they are destroyed, and while no other thread issues I/O on
+	///  them.
+	class wait_set {
+#ifdef _WIN32
+		std::vector<waitable *> members;
+		std::vector<void *>     handles;
+		// Waits see the handles starting at the cursor, as only the lowest signalled one is reported.
+		std::vector<void *> rotated;
+		size_t              cursor = 0;
+#else
+		struct member : public os::posix::waitable_handle::watcher {
+			wait_set *                  owner;
+			waitable *                  item;
+			os::posix::waitable_handle *handle;
+			int                         fd         = -1;
+			uint64_t                    generation = 0;
+			uint32_t                    events     = 0;
+			bool                        active     = false;
+			// Guarded by the dirty lock of the owner.
+			bool dirty = false;
+
+			virtual void changed() override;
+		};
+
+		// Members sharing a file descriptor, which epoll only accepts once.
+		struct descriptor {
+			std::vector<member *> members;
+			uint64_t              generation = 0;
+			uint32_t              registered = 0;
+			bool                  added      = false;
+			// Where the next look at 'members' starts, so that one busy member can't starve the others.
+			size_t next = 0;
+		};
+
+		int                                  epoll = -1;
+		std::vector<std::unique_ptr<member>> members;
+
+		// Registered with epoll to end waits at the exact deadline, epoll_wait() only counts milliseconds.
+		int timer = -1;
+		std::unordered_map<int, descriptor>  descriptors;
+
+		// Members that changed since they were last looked at, reported from any thread.
+		std::mutex            dirty_lock;
+		std::vector<member *> dirty;
+		std::vector<member *> dirty_scratch;
+		// Set while a wait blocks in epoll_wait(), the first member marked then writes to the eventfd to wake it up.
+		bool sleeping = false;
+		int  wakeup   = -1;
+
+		void mark(member *m);
+
+		void join(member *m);
+
+		void leave(member *m);
+
+		os::error update(int fd, descriptor &d, bool drop_idle);
+
+		os::error refresh(std::vector<waitable *> &ready, size_t max);
+#endif
+
+		// For poll_completions(), which does not hand out what it dispatched.
+		std::vector<waitable *> completed;
+
+		os::spinner spinner;
+
+		public:
+		wait_set();
+		~wait_set();
+
+		wait_set(const wait_set &) = delete;
+		wait_set &operator=(const wait_set &) = delete;
+
+		// Returns false if 'item' already is a member or the set is full.
+		bool add(waitable *item);
+
+		// Returns false if 'item' is not a member.
+		bool remove(waitable *item);
+
+		size_t size();
+
+		// Wait until at least one member is signalled, then consume every signalled member and call its callback.
+		///  'ready' receives them in the order they were found. At most 'max' are consumed so that a burst on some
+		///  members can not starve the others, the rest is picked up by the next wait.
+		os::error wait(std::vector<waitable *> &ready, size_t max, std::chrono::nanoseconds timeout);
+
+		os::error wait(std::vector<waitable *> &ready, std::chrono::nanoseconds timeout);
+
+		os::error wait(std::vector<waitable *> &ready);
+
+		// Dispatch up to 'max' members that are signalled already without blocking, returns how many.
+		size_t poll_completions(size_t max);
+
+		// Poll members for a while before blocking, see os::spin_policy. Off by default.
+		void set_spin_policy(const os::spin_policy &policy);
+
+		os::spin_policy get_spin_policy();
+
+		os::spin_stats get_spin_stats();
+	};
+} // namespace os
+
+#endif // OS_WAIT_SET_HPP
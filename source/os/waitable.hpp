@@ -48,6 +48,23 @@ namespace os {
 		static os::error wait_any(std::vector<waitable *> items, size_t &signalled_index,
 								  std::chrono::nanoseconds timeout);
 
+		// Like wait_any(), but consumes every signalled item in one pass, at most 'max' of them. 'signalled'
+		//  receives their indices in the order they were found, the rest is picked up by the next call.
+		/// The scan starts at 'cursor' and wraps around, afterwards 'cursor' points past the last consumed item.
+		///  Keeping one cursor per item list lets every item take its turn, so that a burst on some items can not
+		///  starve the others. Without a cursor the scan starts at index 0 every time, like wait_any().
+		static os::error wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								   size_t &signalled_count);
+
+		static os::error wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								   size_t &signalled_count, std::chrono::nanoseconds timeout);
+
+		static os::error wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								   size_t &signalled_count, size_t &cursor);
+
+		static os::error wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								   size_t &signalled_count, size_t &cursor, std::chrono::nanoseconds timeout);
+
 		static os::error wait_all(waitable **items, size_t items_count, size_t &signalled_index);
 
 		static os::error wait_all(waitable **items, size_t items_count, size_t &signalled_index,
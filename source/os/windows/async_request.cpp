@@ -16,6 +16,8 @@
 */
 
 #include "async_request.hpp"
+#include <cstring>
+#include "../trace.hpp"
 #include "utility.hpp"
 #include <versionhelpers.h>
 
@@ -28,6 +30,30 @@ void os::windows::async_request::set_handle(HANDLE handle) {
 	this->handle          = handle;
 	this->valid           = false;
 	this->callback_called = false;
+	this->timed_out       = false;
+	clear_deadline();
+}
+
+void os::windows::async_request::set_metrics(os::stats_counters *counters, os::latency_recorder *latency) {
+	this->counters      = counters;
+	this->latency       = latency;
+	this->submitted     = std::chrono::high_resolution_clock::now();
+	this->blocked_since = std::chrono::high_resolution_clock::time_point();
+}
+
+void os::windows::async_request::on_wakeup(std::chrono::nanoseconds blocked) {
+	if (counters) {
+		counters->add(os::stats_counters::counter::Wakeups);
+	}
+	if (latency) {
+		latency[size_t(os::latency_type::Wait)].record(blocked);
+	}
+}
+
+void os::windows::async_request::on_timeout() {
+	if (counters) {
+		counters->add(os::stats_counters::counter::Timeouts);
+	}
 }
 
 void os::windows::async_request::set_valid(bool valid) {
@@ -42,6 +68,38 @@ void os::windows::async_request::completion_routine(DWORD dwErrorCode, DWORD dwB
 	if (!ovp) {
 		return;
 	}
+	DATALANE_TRACE(Complete, static_cast<async_request *>(ovp), static_cast<async_request *>(ovp)->trace_name);
+	ovp->signal();
+}
+
+void os::windows::async_request::message_routine(DWORD dwErrorCode, DWORD dwBytesTransmitted, LPVOID ov) {
+	os::windows::overlapped *ovp =
+		os::windows::overlapped::get_pointer_from_overlapped(static_cast<LPOVERLAPPED>(ov));
+
+	if (!ovp) {
+		return;
+	}
+	async_request *ar = static_cast<async_request *>(ovp);
+	ar->message_length += dwBytesTransmitted;
+
+	if (dwErrorCode == ERROR_MORE_DATA) {
+		// The guess was too small, the rest of the message is in the pipe already. Read it with the same overlapped
+		//  structure, the request completes once that read did.
+		DWORD left = 0;
+		if (PeekNamedPipe(ar->handle, NULL, 0, NULL, NULL, &left) && (left > 0)) {
+			os::buffer_pool::buffer grown = ar->pool->acquire(ar->message_length + left);
+			memcpy(grown.data(), ar->message->data(), ar->message_length);
+			*ar->message = std::move(grown);
+			ar->buffer   = ar->message->data();
+
+			if (ReadFileEx(ar->handle, ar->message->data() + ar->message_length, left, static_cast<LPOVERLAPPED>(ov),
+						   (LPOVERLAPPED_COMPLETION_ROUTINE)&os::windows::async_request::message_routine)) {
+				return;
+			}
+			ar->message_result = os::windows::utility::translate_error(GetLastError());
+		}
+	}
+	DATALANE_TRACE(Complete, ar, ar->trace_name);
 	ovp->signal();
 }
 
@@ -97,6 +155,15 @@ bool os::windows::async_request::cancel() {
 	return true;
 }
 
+bool os::windows::async_request::time_out() {
+	if (!is_valid() || is_complete()) {
+		return false;
+	}
+
+	timed_out = true;
+	return CancelIoEx(handle, this->get_overlapped_pointer()) != FALSE;
+}
+
 void os::windows::async_request::call_callback() {
 	DWORD       bytes = 0;
 	OVERLAPPED *ov    = get_overlapped_pointer();
@@ -120,8 +187,22 @@ void os::windows::async_request::call_callback(os::error ec, size_t length) {
 		system.callback_called = true;
 		system.callback(ec, length);
 	}
+	if (message) {
+		ec     = message_result;
+		length = message->size();
+	}
+	if (timed_out && (ec != os::error::Success)) {
+		ec = os::error::TimedOut;
+	}
 	if (callback && !callback_called) {
 		callback_called = true;
-		callback(ec, length);
+		DATALANE_TRACE_SCOPE(Callback, this, "callback");
+		if (latency && latency[size_t(os::latency_type::Callback)].is_enabled()) {
+			auto begin = std::chrono::high_resolution_clock::now();
+			callback(ec, length);
+			latency[size_t(os::latency_type::Callback)].record(std::chrono::high_resolution_clock::now() - begin);
+		} else {
+			callback(ec, length);
+		}
 	}
 }
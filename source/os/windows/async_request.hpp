@@ -21,11 +21,17 @@
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
+#include <chrono>
 #include <windows.h>
 #include "../async_op.hpp"
+#include "../buffer-pool.hpp"
+#include "../histogram.hpp"
+#include "../stats.hpp"
 #include "overlapped.hpp"
 
 namespace os {
+	class wait_set;
+
 	namespace windows {
 		class named_pipe;
 
@@ -33,12 +39,50 @@ namespace os {
 			protected:
 			HANDLE                  handle = {0};
 
+			// Counters and latency histograms of the pipe that issued this request, if any.
+			os::stats_counters *  counters = nullptr;
+			os::latency_recorder *latency  = nullptr;
+
+			// When the request was issued.
+			std::chrono::high_resolution_clock::time_point submitted;
+
+			// Name of the operation in traces.
+			const char *trace_name = "io";
+
+			// Data of a read or write, for os::capture.
+			const char *buffer = nullptr;
+
+			// Reads issued by read_message() grow 'message' from 'pool' until the whole message arrived, the
+			//  callback then sees 'message_result' and the final length.
+			os::buffer_pool *        pool           = nullptr;
+			os::buffer_pool::buffer *message        = nullptr;
+			os::error                message_result = os::error::Success;
+			// Bytes of the message read so far, the overlapped result only covers the last read.
+			size_t message_length = 0;
+
+			// Set once a write could not complete immediately, for os::pipe_stats::write_blocked_time.
+			std::chrono::high_resolution_clock::time_point blocked_since;
+
+			// Cancelled by its deadline, the callback reports os::error::TimedOut instead of the abort.
+			bool timed_out = false;
+
 			void set_handle(HANDLE handle);
 
+			void set_metrics(os::stats_counters *counters, os::latency_recorder *latency);
+
+			void on_wakeup(std::chrono::nanoseconds blocked);
+
+			void on_timeout();
+
 			void set_valid(bool valid);
 
 			static void completion_routine(DWORD dwErrorCode, DWORD dwBytesTransmitted, LPVOID ov);
 
+			// For read_message(), continues into a larger buffer while the message does not fit.
+			static void message_routine(DWORD dwErrorCode, DWORD dwBytesTransmitted, LPVOID ov);
+
+			virtual bool time_out() override;
+
 			public:
 			~async_request();
 
@@ -62,6 +106,7 @@ namespace os {
 			public:
 			friend class os::windows::named_pipe;
 			friend class os::waitable;
+			friend class os::wait_set;
 		};
 	} // namespace windows
 } // namespace os
@@ -0,0 +1,153 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "doorbell.hpp"
+#include <codecvt>
+#include <limits>
+#include <locale>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+inline std::wstring make_wide_string(std::string name) {
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+	return converter.from_bytes(name);
+}
+
+inline void close_handle(HANDLE &handle) {
+	if (handle) {
+		CloseHandle(handle);
+		handle = NULL;
+	}
+}
+
+void os::windows::doorbell::create(std::wstring name) {
+	SetLastError(ERROR_SUCCESS);
+	mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DWORD(sizeof(shared_state)),
+								 (name + L".state").c_str());
+	if (!mapping || (GetLastError() != ERROR_SUCCESS)) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Doorbell creation failed with error code %lX.\0", GetLastError());
+		close_handle(mapping);
+		throw std::runtime_error(msg.data());
+	}
+
+	SetLastError(ERROR_SUCCESS);
+	bell = CreateSemaphoreW(NULL, 0, std::numeric_limits<LONG>::max(), (name + L".bell").c_str());
+	if (!bell || (GetLastError() != ERROR_SUCCESS)) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Doorbell creation failed with error code %lX.\0", GetLastError());
+		close_handle(bell);
+		close_handle(mapping);
+		throw std::runtime_error(msg.data());
+	}
+
+	void *memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(shared_state));
+	if (!memory) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Doorbell creation failed with error code %lX.\0", GetLastError());
+		close_handle(bell);
+		close_handle(mapping);
+		throw std::runtime_error(msg.data());
+	}
+
+	state = new (memory) shared_state();
+	state->rings.store(0);
+	state->armed.store(1);
+}
+
+void os::windows::doorbell::open(std::wstring name) {
+	SetLastError(ERROR_SUCCESS);
+	mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, false, (name + L".state").c_str());
+	bell    = OpenSemaphoreW(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, false, (name + L".bell").c_str());
+	void *memory = (mapping && bell) ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(shared_state)) : NULL;
+	if (!memory) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Opening Doorbell failed with error code %lX.\0", GetLastError());
+		close_handle(bell);
+		close_handle(mapping);
+		throw std::runtime_error(msg.data());
+	}
+	state = static_cast<shared_state *>(memory);
+}
+
+os::windows::doorbell::doorbell() {
+	local.rings.store(0);
+	local.armed.store(1);
+	state = &local;
+
+	SetLastError(ERROR_SUCCESS);
+	bell = CreateSemaphoreW(NULL, 0, std::numeric_limits<LONG>::max(), NULL);
+	if (!bell || (GetLastError() != ERROR_SUCCESS)) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Doorbell creation failed with error code %lX.\0", GetLastError());
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::windows::doorbell::doorbell(os::create_only_t, std::string name) {
+	create(make_wide_string(name));
+}
+
+os::windows::doorbell::doorbell(os::create_or_open_t, std::string name) {
+	std::wstring wide_name = make_wide_string(name);
+	try {
+		create(wide_name);
+	} catch (...) {
+		// There's technically two errors here, but the latter is likely to be more interesting.
+		open(wide_name);
+	}
+}
+
+os::windows::doorbell::doorbell(os::open_only_t, std::string name) {
+	open(make_wide_string(name));
+}
+
+os::windows::doorbell::~doorbell() {
+	if (state && (state != &local)) {
+		UnmapViewOfFile(state);
+	}
+	close_handle(bell);
+	close_handle(mapping);
+}
+
+os::error os::windows::doorbell::post() {
+	if (!ReleaseSemaphore(bell, 1, NULL)) {
+		return (GetLastError() == ERROR_TOO_MANY_POSTS) ? os::error::TooMuchData : os::error::Error;
+	}
+	return os::error::Success;
+}
+
+void *os::windows::doorbell::get_waitable() {
+	return (void *)bell;
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct() {
+	return std::make_shared<os::windows::doorbell>();
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::create_only_t, std::string name) {
+	return std::make_shared<os::windows::doorbell>(os::create_only, name);
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::create_or_open_t, std::string name) {
+	return std::make_shared<os::windows::doorbell>(os::create_or_open, name);
+}
+
+std::shared_ptr<os::doorbell> os::doorbell::construct(os::open_only_t, std::string name) {
+	return std::make_shared<os::windows::doorbell>(os::open_only, name);
+}
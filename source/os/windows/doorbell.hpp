@@ -0,0 +1,59 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_WINDOWS_DOORBELL_HPP
+#define OS_WINDOWS_DOORBELL_HPP
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <string>
+#include <windows.h>
+#include "../doorbell.hpp"
+#include "../tags.hpp"
+
+namespace os {
+	namespace windows {
+		// Unnamed doorbells keep their counter in the object itself, named ones in a file mapping.
+		///  The consumer sleeps on a semaphore of the same name.
+		class doorbell : public os::doorbell {
+			shared_state local;
+			HANDLE       mapping = NULL;
+			HANDLE       bell    = NULL;
+
+			void create(std::wstring name);
+
+			void open(std::wstring name);
+
+			protected:
+			virtual os::error post() override;
+
+			public:
+			doorbell();
+			doorbell(os::create_only_t, std::string name);
+			doorbell(os::create_or_open_t, std::string name);
+			doorbell(os::open_only_t, std::string name);
+			virtual ~doorbell();
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace windows
+} // namespace os
+
+#endif // OS_WINDOWS_DOORBELL_HPP
@@ -0,0 +1,131 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <codecvt>
+#include <locale>
+#include <string>
+#include <vector>
+#include "event.hpp"
+
+inline std::wstring make_wide_string(std::string name) {
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+	return converter.from_bytes(name);
+}
+
+inline void validate_name(std::wstring name) {
+	if (name.length() >= MAX_PATH) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "'name' can't be longer than %lld characters.\0", uint64_t(MAX_PATH));
+		throw std::invalid_argument(msg.data());
+	}
+}
+
+inline void create_event_impl(HANDLE &handle, std::wstring name, bool manual_reset, bool initial_state) {
+	SetLastError(ERROR_SUCCESS);
+	handle    = CreateEventW(NULL, manual_reset, initial_state, name.data());
+	DWORD err = GetLastError();
+	if (!handle || (err != ERROR_SUCCESS)) {
+		if (handle) {
+			CloseHandle(handle);
+		}
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Event creation failed with error code %lX.\0", err);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+inline void open_event_impl(HANDLE &handle, std::wstring name) {
+	SetLastError(ERROR_SUCCESS);
+	handle    = OpenEventW(SYNCHRONIZE | EVENT_MODIFY_STATE, false, name.data());
+	DWORD err = GetLastError();
+	if (!handle || (err != ERROR_SUCCESS)) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Opening Event failed with error code %lX.\0", err);
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::windows::event::event(bool manual_reset /*= false*/, bool initial_state /*= false*/) {
+	SetLastError(ERROR_SUCCESS);
+	handle = CreateEventW(NULL, manual_reset, initial_state, NULL);
+	if (!handle) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Event creation failed with error code %lX.\0", GetLastError());
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::windows::event::event(os::create_only_t, std::string name, bool manual_reset /*= false*/,
+						  bool initial_state /*= false*/) {
+	std::wstring wide_name = make_wide_string(name + '\0');
+	validate_name(wide_name);
+	create_event_impl(handle, wide_name, manual_reset, initial_state);
+}
+
+os::windows::event::event(os::create_or_open_t, std::string name, bool manual_reset /*= false*/,
+						  bool initial_state /*= false*/) {
+	std::wstring wide_name = make_wide_string(name + '\0');
+	validate_name(wide_name);
+	try {
+		create_event_impl(handle, wide_name, manual_reset, initial_state);
+	} catch (...) {
+		// There's technically two errors here, but the latter is likely to be more interesting.
+		open_event_impl(handle, wide_name);
+	}
+}
+
+os::windows::event::event(os::open_only_t, std::string name) {
+	std::wstring wide_name = make_wide_string(name + '\0');
+	validate_name(wide_name);
+	open_event_impl(handle, wide_name);
+}
+
+os::windows::event::~event() {
+	if (handle) {
+		CloseHandle(handle);
+	}
+}
+
+os::error os::windows::event::set() {
+	return SetEvent(handle) ? os::error::Success : os::error::Error;
+}
+
+os::error os::windows::event::reset() {
+	return ResetEvent(handle) ? os::error::Success : os::error::Error;
+}
+
+void *os::windows::event::get_waitable() {
+	return (void *)handle;
+}
+
+std::shared_ptr<os::event> os::event::construct(bool manual_reset /*= false*/, bool initial_state /*= false*/) {
+	return std::make_shared<os::windows::event>(manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::create_only_t, std::string name, bool manual_reset /*= false*/,
+												bool initial_state /*= false*/) {
+	return std::make_shared<os::windows::event>(os::create_only, name, manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::create_or_open_t, std::string name,
+												bool manual_reset /*= false*/, bool initial_state /*= false*/) {
+	return std::make_shared<os::windows::event>(os::create_or_open, name, manual_reset, initial_state);
+}
+
+std::shared_ptr<os::event> os::event::construct(os::open_only_t, std::string name) {
+	return std::make_shared<os::windows::event>(os::open_only, name);
+}
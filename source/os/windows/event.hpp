@@ -0,0 +1,51 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_WINDOWS_EVENT_HPP
+#define OS_WINDOWS_EVENT_HPP
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include "../event.hpp"
+#include "../tags.hpp"
+
+namespace os {
+	namespace windows {
+		class event : public os::event {
+			HANDLE handle;
+
+			public:
+			event(bool manual_reset = false, bool initial_state = false);
+			event(os::create_only_t, std::string name, bool manual_reset = false, bool initial_state = false);
+			event(os::create_or_open_t, std::string name, bool manual_reset = false, bool initial_state = false);
+			event(os::open_only_t, std::string name);
+			virtual ~event();
+
+			virtual os::error set() override;
+
+			virtual os::error reset() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace windows
+} // namespace os
+
+#endif // OS_WINDOWS_EVENT_HPP
@@ -16,9 +16,14 @@
 */
 
 #include <codecvt>
+#include <cstring>
+#include <limits>
 #include <locale>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include "named-pipe.hpp"
+#include "../trace.hpp"
 #include "utility.hpp"
 
 #define STRINGIFY(x) #x
@@ -26,6 +31,11 @@
 
 #define DEFAULT_BUFFER_SIZE 16 * 1024 * 1024
 #define DEFAULT_WAIT_TIME 100
+// First guess for read_message() when no message is waiting yet.
+#define DEFAULT_MESSAGE_SIZE 4096
+// Backlog of try_write() at which it starts refusing messages, and at which it takes them again.
+#define DEFAULT_HIGH_WATERMARK 64 * 1024
+#define DEFAULT_LOW_WATERMARK 16 * 1024
 
 #define MAX_PATH_MINUS_PREFIX (MAX_PATH - 9)
 
@@ -131,9 +141,26 @@ inline void open_logic(HANDLE &handle, std::wstring name, os::windows::pipe_read
 	}
 }
 
+struct os::windows::named_pipe::backlog_copy {
+	OVERLAPPED                                     overlapped = {};
+	named_pipe *                                   pipe       = nullptr;
+	os::buffer_pool::buffer                        data;
+	std::chrono::high_resolution_clock::time_point submitted;
+	bool                                           pending = false;
+};
+
+struct os::windows::named_pipe::write_backlog {
+	// Declared first, the copies hand their memory back to it.
+	os::buffer_pool             pool;
+	std::vector<backlog_copy *> copies;
+	std::vector<backlog_copy *> spare;
+};
+
 os::windows::named_pipe::named_pipe() {
-	handle  = INVALID_HANDLE_VALUE;
-	created = false;
+	handle         = INVALID_HANDLE_VALUE;
+	created        = false;
+	low_watermark  = DEFAULT_LOW_WATERMARK;
+	high_watermark = DEFAULT_HIGH_WATERMARK;
 	security_attributes.nLength              = sizeof(SECURITY_ATTRIBUTES);
 	security_attributes.lpSecurityDescriptor = nullptr;
 	security_attributes.bInheritHandle       = true;
@@ -150,6 +177,7 @@ os::windows::named_pipe::named_pipe(os::create_only_t, std::string name,
 	std::wstring wide_name = make_wide_string(make_windows_compatible(name + '\0'));
 	create_logic(handle, wide_name, max_instances, type, mode, is_unique, security_attributes);
 	created = true;
+	os::stats_page::add(this, name + " (server)");
 }
 
 os::windows::named_pipe::named_pipe(os::create_or_open_t, std::string name,
@@ -167,6 +195,7 @@ os::windows::named_pipe::named_pipe(os::create_or_open_t, std::string name,
 		open_logic(handle, wide_name, mode);
 		set_connected(true);
 	}
+	os::stats_page::add(this, name + (created ? " (server)" : " (client)"));
 }
 
 os::windows::named_pipe::named_pipe(os::open_only_t, std::string name,
@@ -177,9 +206,34 @@ os::windows::named_pipe::named_pipe(os::open_only_t, std::string name,
 	std::wstring wide_name = make_wide_string(make_windows_compatible(name + '\0'));
 	open_logic(handle, wide_name, mode);
 	set_connected(true);
+	os::stats_page::add(this, name + " (client)");
 }
 
 os::windows::named_pipe::~named_pipe() {
+	os::stats_page::remove(this);
+
+	readable.cancel();
+	if (spill) {
+		std::unique_lock<std::mutex> ul(write_lock);
+		for (backlog_copy *copy : spill->copies) {
+			if (!copy->pending) {
+				delete copy;
+				continue;
+			}
+
+			// The completion routine may still be queued for the thread that wrote, it frees orphaned copies.
+			CancelIoEx(handle, &copy->overlapped);
+			while (!HasOverlappedIoCompleted(&copy->overlapped)) {
+				SleepEx(1, false);
+			}
+			copy->data.release();
+			copy->pipe = nullptr;
+		}
+		spill->copies.clear();
+	}
+	if (read_event) {
+		CloseHandle(read_event);
+	}
 	if (handle) {
 		DisconnectNamedPipe(handle);
 		CloseHandle(handle);
@@ -192,6 +246,7 @@ os::error os::windows::named_pipe::available(size_t &avail) {
 	if (!PeekNamedPipe(handle, NULL, NULL, NULL, NULL, &bytes) || (GetLastError() != ERROR_SUCCESS)) {
 		switch (GetLastError()) {
 		case ERROR_BROKEN_PIPE:
+			disconnected();
 			return os::error::Disconnected;
 		default:
 			return os::error::Error;
@@ -207,6 +262,7 @@ os::error os::windows::named_pipe::total_available(size_t &avail) {
 	if (!PeekNamedPipe(handle, NULL, NULL, NULL, &bytes, NULL) || (GetLastError() != ERROR_SUCCESS)) {
 		switch (GetLastError()) {
 		case ERROR_BROKEN_PIPE:
+			disconnected();
 			return os::error::Disconnected;
 		default:
 			return os::error::Error;
@@ -229,8 +285,18 @@ os::error os::windows::named_pipe::read(char *buffer, size_t buffer_length, std:
 		ar = std::make_shared<os::windows::async_request>();
 	}
 	op = std::static_pointer_cast<os::async_op>(ar);
+	async_request *arp = ar.get();
 	ar->set_callback(cb);
+	ar->set_system_callback(
+		[this, arp](os::error ec, size_t length) { handle_read_callback(arp, ec, length); });
 	ar->set_handle(handle);
+	ar->set_metrics(&counters, latency);
+	counters.add(os::stats_counters::counter::PendingReads);
+	ar->trace_name = "read";
+	ar->buffer     = buffer;
+	ar->pool       = nullptr;
+	ar->message    = nullptr;
+	DATALANE_TRACE(Submit, ar.get(), ar->trace_name);
 
 	SetLastError(ERROR_SUCCESS);
 	BOOL suc = ReadFileEx(
@@ -249,6 +315,66 @@ os::error os::windows::named_pipe::read(char *buffer, size_t buffer_length, std:
 	}
 
 	ar->set_valid(true);
+	readable.arm();
+	return ec;
+}
+
+os::error os::windows::named_pipe::read_message(os::buffer_pool &pool, os::buffer_pool::buffer &message,
+												std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb) {
+	os::error ec;
+
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	}
+
+	// Size the buffer to a message that is already waiting, otherwise guess and grow on ERROR_MORE_DATA.
+	DWORD left = 0;
+	if (!PeekNamedPipe(handle, NULL, 0, NULL, NULL, &left) && (GetLastError() == ERROR_BROKEN_PIPE)) {
+		disconnected();
+		return os::error::Disconnected;
+	}
+	message = pool.acquire(left > 0 ? left : DEFAULT_MESSAGE_SIZE);
+
+	std::shared_ptr<os::windows::async_request> ar = std::static_pointer_cast<os::windows::async_request>(op);
+	if (!ar) {
+		ar = std::make_shared<os::windows::async_request>();
+	}
+	op = std::static_pointer_cast<os::async_op>(ar);
+	async_request *arp = ar.get();
+	ar->set_callback(cb);
+	ar->set_system_callback(
+		[this, arp](os::error ec, size_t length) { handle_read_message_callback(arp, ec, length); });
+	ar->set_handle(handle);
+	ar->set_metrics(&counters, latency);
+	counters.add(os::stats_counters::counter::PendingReads);
+	ar->trace_name     = "read_message";
+	ar->buffer         = message.data();
+	ar->pool           = &pool;
+	ar->message        = &message;
+	ar->message_result = os::error::Success;
+	ar->message_length = 0;
+	DATALANE_TRACE(Submit, ar.get(), ar->trace_name);
+
+	SetLastError(ERROR_SUCCESS);
+	BOOL suc = ReadFileEx(
+		handle, message.data(), DWORD(message.size()),
+		ar->get_overlapped_pointer(),
+		(LPOVERLAPPED_COMPLETION_ROUTINE)&os::windows::async_request::message_routine
+	);
+
+	DWORD error = GetLastError();
+	ec          = utility::translate_error(error);
+
+	if (suc == 0) {
+		message.release();
+		ar->message_result = ec;
+		ar->call_callback(ec, 0);
+		ar->cancel();
+		return ec;
+	}
+
+	ar->set_valid(true);
+	readable.arm();
 	return ec;
 }
 
@@ -265,8 +391,16 @@ os::error os::windows::named_pipe::write(const char *buffer, size_t buffer_lengt
 		ar = std::make_shared<os::windows::async_request>();
 	}
 	op = std::static_pointer_cast<os::async_op>(ar);
+	async_request *arp = ar.get();
 	ar->set_callback(cb);
+	ar->set_system_callback(
+		[this, arp](os::error ec, size_t length) { handle_write_callback(arp, ec, length); });
 	ar->set_handle(handle);
+	ar->set_metrics(&counters, latency);
+	counters.add(os::stats_counters::counter::PendingWrites);
+	ar->trace_name = "write";
+	ar->buffer     = buffer;
+	DATALANE_TRACE(Submit, ar.get(), ar->trace_name);
 
 	SetLastError(ERROR_SUCCESS);
 	BOOL  suc   = WriteFileEx(
@@ -285,81 +419,339 @@ os::error os::windows::named_pipe::write(const char *buffer, size_t buffer_lengt
 		return ec;
 	}
 
+	if (!HasOverlappedIoCompleted(ar->get_overlapped_pointer())) {
+		ar->blocked_since = std::chrono::high_resolution_clock::now();
+	}
 	ar->set_valid(true);
 	return ec;
 }
 
-bool os::windows::named_pipe::is_created() {
-	return created;
+os::windows::named_pipe::readiness::readiness(named_pipe *pipe) : pipe(pipe) {
+	// Auto-reset, so that a completion wakes up a single wait.
+	overlapped.hEvent = CreateEventW(NULL, false, false, NULL);
+	if (!overlapped.hEvent) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Event creation failed with error code %lX.\0", GetLastError());
+		throw std::runtime_error(msg.data());
+	}
 }
 
-bool os::windows::named_pipe::is_connected() {
-	ULONG processId, sessionId;
+os::windows::named_pipe::readiness::~readiness() {
+	cancel();
+	CloseHandle(overlapped.hEvent);
+}
+
+void os::windows::named_pipe::readiness::arm() {
+	std::unique_lock<std::mutex> ul(lock);
+	if (!pipe->is_connected() || (pipe->handle == INVALID_HANDLE_VALUE)) {
+		return;
+	} else if (issued && !HasOverlappedIoCompleted(&overlapped)) {
+		// Still waiting for the next message.
+		return;
+	}
+
+	// Completes right away if a message is waiting already, with ERROR_MORE_DATA in message read mode.
+	SetLastError(ERROR_SUCCESS);
+	if (ReadFile(pipe->handle, &nothing, 0, NULL, &overlapped)
+		|| (GetLastError() == ERROR_IO_PENDING) || (GetLastError() == ERROR_MORE_DATA)) {
+		issued = true;
+	} else {
+		// Most likely a broken pipe, which the next read reports.
+		issued = false;
+		SetEvent(overlapped.hEvent);
+	}
+}
+
+void os::windows::named_pipe::readiness::cancel() {
+	std::unique_lock<std::mutex> ul(lock);
+	if (issued && !HasOverlappedIoCompleted(&overlapped)) {
+		DWORD bytes = 0;
+		CancelIoEx(pipe->handle, &overlapped);
+		GetOverlappedResult(pipe->handle, &overlapped, &bytes, TRUE);
+	}
+	issued = false;
+}
+
+void *os::windows::named_pipe::readiness::get_waitable() {
+	return (void *)overlapped.hEvent;
+}
+
+os::waitable *os::windows::named_pipe::get_readable() {
+	return &readable;
+}
+
+os::error os::windows::named_pipe::try_read(char *buffer, size_t buffer_length, size_t &read_length) {
+	read_length = 0;
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	}
 
-	if (created) {
-		if (!GetNamedPipeClientProcessId(handle, &processId)) {
-			return false;
+	DWORD avail = 0;
+	SetLastError(ERROR_SUCCESS);
+	if (!PeekNamedPipe(handle, NULL, 0, NULL, &avail, NULL)) {
+		if (GetLastError() == ERROR_BROKEN_PIPE) {
+			disconnected();
+			return os::error::Disconnected;
 		}
-		if (!GetNamedPipeClientSessionId(handle, &sessionId)) {
-			return false;
+		return os::error::Error;
+	} else if (avail == 0) {
+		readable.arm();
+		return os::error::WouldBlock;
+	}
+
+	auto  start = std::chrono::high_resolution_clock::now();
+	DWORD bytes = 0;
+	DWORD error = ERROR_SUCCESS;
+	{
+		std::unique_lock<std::mutex> ul(read_lock);
+		if (!read_event) {
+			read_event = CreateEventW(NULL, true, false, NULL);
+			if (!read_event) {
+				return os::error::Error;
+			}
 		}
-	} else {
-		if (!GetNamedPipeServerProcessId(handle, &processId)) {
-			return false;
+
+		OVERLAPPED ov = {};
+		ov.hEvent     = read_event;
+		SetLastError(ERROR_SUCCESS);
+		BOOL suc = ReadFile(handle, buffer, DWORD(buffer_length), NULL, &ov);
+		error    = suc ? ERROR_SUCCESS : GetLastError();
+		if (suc || (error == ERROR_IO_PENDING) || (error == ERROR_MORE_DATA)) {
+			// Only pending if a read issued earlier took the data first, which is not waited for.
+			if (error == ERROR_IO_PENDING) {
+				CancelIoEx(handle, &ov);
+			}
+			error = GetOverlappedResult(handle, &ov, &bytes, TRUE) ? ERROR_SUCCESS : GetLastError();
 		}
-		if (!GetNamedPipeServerSessionId(handle, &sessionId)) {
-			return false;
+	}
+
+	os::error ec = os::error::WouldBlock;
+	if (error != ERROR_OPERATION_ABORTED) {
+		auto now    = std::chrono::high_resolution_clock::now();
+		ec          = utility::translate_error(error);
+		read_length = bytes;
+		latency[size_t(os::latency_type::Read)].record(now - start);
+		if (capture && ((ec == os::error::Success) || (ec == os::error::MoreData))) {
+			capture->append(os::capture::direction::In, lane, buffer, bytes, ec,
+							std::chrono::duration_cast<std::chrono::nanoseconds>(now - start));
+		}
+		if (ec == os::error::Disconnected) {
+			disconnected();
+		} else if (ec == os::error::Success) {
+			counters.add(os::stats_counters::counter::MessagesIn);
+			counters.add(os::stats_counters::counter::BytesIn, int64_t(bytes));
+		} else if (ec == os::error::MoreData) {
+			counters.add(os::stats_counters::counter::MoreData);
+			counters.add(os::stats_counters::counter::PartialReads);
+			counters.add(os::stats_counters::counter::BytesIn, int64_t(bytes));
 		}
 	}
+	readable.arm();
+	return ec;
+}
 
-	if ((processId != remoteId.processId) || (processId == 0)) {
-		remoteId.processId = 0;
-		remoteId.sessionId = 0;
-		return false;
+os::error os::windows::named_pipe::try_write(const char *buffer, size_t buffer_length) {
+	if (!is_connected()) {
+		return os::error::Disconnected;
+	} else if (buffer_length > std::numeric_limits<DWORD>::max()) {
+		return os::error::BufferTooLarge;
 	}
 
-	if ((sessionId != remoteId.sessionId) || (sessionId == 0)) {
-		remoteId.processId = 0;
-		remoteId.sessionId = 0;
-		return false;
+	backlog_copy *copy = nullptr;
+	{
+		std::unique_lock<std::mutex> ul(write_lock);
+		if (above_high) {
+			return os::error::WouldBlock;
+		}
+
+		if (!spill) {
+			spill = std::make_unique<write_backlog>();
+		}
+		if (spill->spare.empty()) {
+			copy = new backlog_copy();
+			spill->copies.push_back(copy);
+		} else {
+			copy = spill->spare.back();
+			spill->spare.pop_back();
+		}
+		// The caller may reuse the buffer right away, the kernel may not be done with it by then.
+		copy->overlapped = {};
+		copy->pipe       = this;
+		copy->data       = spill->pool.acquire(buffer_length);
+		copy->submitted  = std::chrono::high_resolution_clock::now();
+		copy->pending    = true;
+		memcpy(copy->data.data(), buffer, buffer_length);
+
+		backlog += buffer_length;
+		if (backlog > high_watermark) {
+			above_high = true;
+		}
+	}
+	counters.add(os::stats_counters::counter::PendingWrites);
+
+	SetLastError(ERROR_SUCCESS);
+	if (!WriteFileEx(handle, copy->data.data(), DWORD(buffer_length), &copy->overlapped,
+					 &named_pipe::write_completed)) {
+		DWORD error = GetLastError();
+		complete(copy, error, 0);
+		return utility::translate_error(error);
+	}
+	notify_writable();
+	return os::error::Success;
+}
+
+void CALLBACK os::windows::named_pipe::write_completed(DWORD error, DWORD bytes, LPOVERLAPPED ov) {
+	backlog_copy *copy = CONTAINING_RECORD(ov, backlog_copy, overlapped);
+	if (!copy->pipe) {
+		// The pipe is gone already.
+		delete copy;
+		return;
+	}
+	copy->pipe->complete(copy, error, bytes);
+}
+
+void os::windows::named_pipe::complete(backlog_copy *copy, DWORD error, DWORD bytes) {
+	auto      now  = std::chrono::high_resolution_clock::now();
+	os::error code = utility::translate_error(error);
+	latency[size_t(os::latency_type::Write)].record(now - copy->submitted);
+	if (capture && (code == os::error::Success)) {
+		capture->append(os::capture::direction::Out, lane, copy->data.data(), bytes, code,
+						std::chrono::duration_cast<std::chrono::nanoseconds>(now - copy->submitted));
+	}
+	counters.add(os::stats_counters::counter::PendingWrites, -1);
+	if (code == os::error::Success) {
+		counters.add(os::stats_counters::counter::MessagesOut);
+		counters.add(os::stats_counters::counter::BytesOut, int64_t(bytes));
+	}
+
+	{
+		std::unique_lock<std::mutex> ul(write_lock);
+		backlog -= copy->data.size();
+		copy->data.release();
+		copy->pending = false;
+		spill->spare.push_back(copy);
+		if (above_high && (backlog <= low_watermark)) {
+			above_high = false;
+			writable.signal();
+		}
+	}
+
+	if (code == os::error::Disconnected) {
+		disconnected();
+	}
+	notify_writable();
+}
+
+void os::windows::named_pipe::notify_writable() {
+	bool is_writable = !above_high.load(std::memory_order_acquire);
+	if (writable_notified.load(std::memory_order_acquire) == is_writable) {
+		return;
+	} else if (writable_notified.exchange(is_writable) == is_writable) {
+		return;
+	}
+
+	std::function<void(bool)> cb;
+	{
+		std::unique_lock<std::mutex> ul(callback_lock);
+		cb = writable_callback;
+	}
+	if (cb) {
+		cb(is_writable);
 	}
+}
+
+size_t os::windows::named_pipe::get_backlog() {
+	std::unique_lock<std::mutex> ul(write_lock);
+	return backlog;
+}
 
-	if (!PeekNamedPipe(handle, NULL, NULL, NULL, NULL, NULL)) {
-		DWORD err = GetLastError();
-		return false;
+void os::windows::named_pipe::set_write_watermarks(size_t low, size_t high) {
+	if (low > high) {
+		throw std::invalid_argument("'low' can't be larger than 'high'.");
+	}
+
+	{
+		std::unique_lock<std::mutex> ul(write_lock);
+		low_watermark  = low;
+		high_watermark = high;
+		if (!above_high && (backlog > high_watermark)) {
+			above_high = true;
+		} else if (above_high && (backlog <= low_watermark)) {
+			above_high = false;
+			writable.signal();
+		}
 	}
+	notify_writable();
+}
+
+void os::windows::named_pipe::set_writable_callback(std::function<void(bool writable)> cb) {
+	std::unique_lock<std::mutex> ul(callback_lock);
+	writable_callback = cb;
+}
+
+os::waitable *os::windows::named_pipe::get_writable() {
+	return &writable;
+}
+
+os::windows::named_pipe::writability::writability() {
+	// Auto-reset, so that it wakes up a single wait.
+	event = CreateEventW(NULL, false, false, NULL);
+	if (!event) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Event creation failed with error code %lX.\0", GetLastError());
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::windows::named_pipe::writability::~writability() {
+	CloseHandle(event);
+}
+
+void os::windows::named_pipe::writability::signal() {
+	SetEvent(event);
+}
+
+void *os::windows::named_pipe::writability::get_waitable() {
+	return (void *)event;
+}
+
+bool os::windows::named_pipe::is_created() {
+	return created;
+}
 
-	remoteId = {sessionId, processId};
-	return true;
+bool os::windows::named_pipe::is_connected() {
+	return connected.load(std::memory_order_acquire);
 }
 
 void os::windows::named_pipe::set_connected(bool is_connected) {
+	connected.store(is_connected, std::memory_order_release);
 	if (is_connected) {
-		ULONG processId, sessionId;
+		readable.arm();
+	}
+}
 
-		if (created) {
-			if (!GetNamedPipeClientProcessId(handle, &processId)) {
-				return;
-			}
-			if (!GetNamedPipeClientSessionId(handle, &sessionId)) {
-				return;
-			}
-		} else {
-			if (!GetNamedPipeServerProcessId(handle, &processId)) {
-				return;
-			}
-			if (!GetNamedPipeServerSessionId(handle, &sessionId)) {
-				return;
-			}
-		}
+void os::windows::named_pipe::set_disconnect_callback(std::function<void()> cb) {
+	std::unique_lock<std::mutex> ul(callback_lock);
+	disconnect_callback = cb;
+}
 
-		remoteId = {sessionId, processId};
-	} else {
-		remoteId = {0, 0};
+void os::windows::named_pipe::disconnected() {
+	if (!connected.exchange(false)) {
+		return;
+	}
+
+	std::function<void()> cb;
+	{
+		std::unique_lock<std::mutex> ul(callback_lock);
+		cb = disconnect_callback;
+	}
+	if (cb) {
+		cb();
 	}
 }
 
-void os::windows::named_pipe::handle_accept_callback(os::error code, size_t length) {
+void os::windows::named_pipe::handle_accept_callback(async_request *ar, os::error code, size_t length) {
+	latency[size_t(os::latency_type::Accept)].record(std::chrono::high_resolution_clock::now() - ar->submitted);
 	if (code == os::error::Connected || code == os::error::Success) {
 		set_connected(true);
 	} else {
@@ -367,6 +759,96 @@ void os::windows::named_pipe::handle_accept_callback(os::error code, size_t leng
 	}
 }
 
+void os::windows::named_pipe::handle_read_callback(async_request *ar, os::error code, size_t length) {
+	auto now = std::chrono::high_resolution_clock::now();
+	latency[size_t(os::latency_type::Read)].record(now - ar->submitted);
+	if (capture && ((code == os::error::Success) || (code == os::error::MoreData))) {
+		capture->append(os::capture::direction::In, lane, ar->buffer, length, code,
+						std::chrono::duration_cast<std::chrono::nanoseconds>(now - ar->submitted));
+	}
+	counters.add(os::stats_counters::counter::PendingReads, -1);
+	if (code == os::error::Disconnected) {
+		disconnected();
+	} else if (code == os::error::Success) {
+		counters.add(os::stats_counters::counter::MessagesIn);
+		counters.add(os::stats_counters::counter::BytesIn, int64_t(length));
+	} else if (code == os::error::MoreData) {
+		counters.add(os::stats_counters::counter::MoreData);
+		counters.add(os::stats_counters::counter::PartialReads);
+		counters.add(os::stats_counters::counter::BytesIn, int64_t(length));
+	}
+}
+
+void os::windows::named_pipe::handle_read_message_callback(async_request *ar, os::error code, size_t /*length*/) {
+	os::buffer_pool::buffer &message = *ar->message;
+
+	// The completion routine grew the message as far as it had to, a read that failed on the way counts instead.
+	size_t length = ar->message_length;
+	if (ar->message_result != os::error::Success) {
+		code = ar->message_result;
+	}
+
+	if ((code == os::error::Success) || (code == os::error::MoreData)) {
+		message.resize(length);
+	} else {
+		message.release();
+	}
+	ar->buffer         = message.data();
+	ar->message_result = code;
+	handle_read_callback(ar, code, length);
+}
+
+void os::windows::named_pipe::handle_write_callback(async_request *ar, os::error code, size_t length) {
+	auto now = std::chrono::high_resolution_clock::now();
+	latency[size_t(os::latency_type::Write)].record(now - ar->submitted);
+	if (capture && (code == os::error::Success)) {
+		capture->append(os::capture::direction::Out, lane, ar->buffer, length, code,
+						std::chrono::duration_cast<std::chrono::nanoseconds>(now - ar->submitted));
+	}
+	counters.add(os::stats_counters::counter::PendingWrites, -1);
+	if (code == os::error::Disconnected) {
+		disconnected();
+	} else if (code == os::error::Success) {
+		counters.add(os::stats_counters::counter::MessagesOut);
+		counters.add(os::stats_counters::counter::BytesOut, int64_t(length));
+	}
+	if (ar->blocked_since != std::chrono::high_resolution_clock::time_point()) {
+		counters.add(os::stats_counters::counter::WriteBlockedTime,
+					 std::chrono::duration_cast<std::chrono::nanoseconds>(now - ar->blocked_since).count());
+	}
+}
+
+void os::windows::named_pipe::set_capture(std::shared_ptr<os::capture::writer> capture, uint32_t lane) {
+	this->capture = capture;
+	this->lane    = lane;
+}
+
+os::pipe_stats os::windows::named_pipe::stats() {
+	// The buffer quota is fixed when the pipe is created.
+	os::pipe_stats st = counters.snapshot();
+	st.send_buffer    = DEFAULT_BUFFER_SIZE;
+	return st;
+}
+
+os::histogram os::windows::named_pipe::get_latency(os::latency_type type) {
+	if (type >= os::latency_type::_Count) {
+		return os::histogram();
+	}
+	return latency[size_t(type)].get();
+}
+
+void os::windows::named_pipe::set_latency_tracking(bool enabled) {
+	for (os::latency_recorder &recorder : latency) {
+		recorder.enable(enabled);
+	}
+}
+
+void os::windows::named_pipe::reset_latency() {
+	for (os::latency_recorder &recorder : latency) {
+		recorder.reset();
+	}
+}
+
 os::error os::windows::named_pipe::accept(std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb) {
 	os::error ec;
 
@@ -380,9 +862,13 @@ os::error os::windows::named_pipe::accept(std::shared_ptr<os::async_op> &op, os:
 	}
 	op = std::static_pointer_cast<os::async_op>(ar);
 	ar->set_callback(cb);
+	async_request *arp = ar.get();
 	ar->set_system_callback(
-		std::bind(&named_pipe::handle_accept_callback, this, std::placeholders::_1, std::placeholders::_2));
+		[this, arp](os::error ec, size_t length) { handle_accept_callback(arp, ec, length); });
 	ar->set_handle(handle);
+	ar->set_metrics(&counters, latency);
+	ar->trace_name = "accept";
+	DATALANE_TRACE(Submit, ar.get(), ar->trace_name);
 
 	SetLastError(ERROR_SUCCESS);
 	BOOL suc = ConnectNamedPipe(handle, ar->get_overlapped_pointer());
@@ -22,11 +22,18 @@
 #define WIN32_LEAN_AND_MEAN
 #endif
 
+#include <atomic>
+#include <functional>
 #include <inttypes.h>
+#include <mutex>
 #include <memory>
 #include <string>
 #include <windows.h>
+#include "../capture.hpp"
 #include "../error.hpp"
+#include "../histogram.hpp"
+#include "../stats-page.hpp"
+#include "../stats.hpp"
 #include "../tags.hpp"
 #include "async_request.hpp"
 
@@ -46,19 +53,105 @@ namespace os {
 			Message = 0x02,
 		};
 
-		class named_pipe {
+		class named_pipe : public os::stats_source {
+			public:
+			// Signalled when a message waits to be read, see get_readable().
+			/// Keeps a zero byte read outstanding, which completes once data arrives without consuming any of it.
+			class readiness : public os::waitable {
+				named_pipe *pipe;
+				std::mutex  lock;
+				OVERLAPPED  overlapped = {};
+				bool        issued     = false;
+				char        nothing    = 0;
+
+				public:
+				readiness(named_pipe *pipe);
+				~readiness();
+
+				// Fire again for the next message.
+				void arm();
+
+				// Withdraw the outstanding read, before the handle is closed.
+				void cancel();
+
+				// os::waitable
+				protected:
+				virtual void *get_waitable() override;
+			};
+
+			// Signalled when the backlog of try_write() fell back to the low watermark, see get_writable().
+			class writability : public os::waitable {
+				HANDLE event = NULL;
+
+				public:
+				writability();
+				~writability();
+
+				void signal();
+
+				// os::waitable
+				protected:
+				virtual void *get_waitable() override;
+			};
+
+			// Copy of a message written by try_write(), created on first use and recycled once it completed.
+			struct backlog_copy;
+
+			// Copies and the memory for them.
+			struct write_backlog;
+
+			private:
 			HANDLE              handle;
 			bool                created = false;
 			SECURITY_ATTRIBUTES security_attributes;
-			struct {
-				ULONG sessionId;
-				ULONG processId;
-			} remoteId;
+
+			// Cleared by the first completion that reports a broken pipe.
+			std::atomic<bool>     connected{false};
+			std::mutex            callback_lock;
+			std::function<void()> disconnect_callback;
+
+			os::stats_counters counters;
+			os::latency_recorder latency[size_t(os::latency_type::_Count)];
+
+			std::shared_ptr<os::capture::writer> capture = os::capture::get_default();
+			uint32_t                             lane    = os::capture::next_lane();
+
+			readiness readable{this};
+
+			// Waited on by try_read(), created on first use.
+			std::mutex read_lock;
+			HANDLE     read_event = NULL;
+
+			// What try_write() has in flight, guarded by 'write_lock'.
+			std::mutex                     write_lock;
+			std::unique_ptr<write_backlog> spill;
+			size_t                         backlog        = 0;
+			size_t                         low_watermark  = 0;
+			size_t                         high_watermark = 0;
+			std::atomic<bool>              above_high{false};
+			// Last state handed to the callback, which 'callback_lock' guards.
+			std::atomic<bool>         writable_notified{true};
+			std::function<void(bool)> writable_callback;
+			writability               writable;
 
 			private:
 			named_pipe();
 
-			void handle_accept_callback(os::error code, size_t length);
+			void handle_accept_callback(async_request *ar, os::error code, size_t length);
+
+			void disconnected();
+
+			void handle_read_callback(async_request *ar, os::error code, size_t length);
+
+			void handle_read_message_callback(async_request *ar, os::error code, size_t length);
+
+			void handle_write_callback(async_request *ar, os::error code, size_t length);
+
+			static void CALLBACK write_completed(DWORD error, DWORD bytes, LPOVERLAPPED ov);
+
+			void complete(backlog_copy *copy, DWORD error, DWORD bytes);
+
+			void notify_writable();
 
 			public:
 			named_pipe(os::create_only_t, std::string name, size_t max_instances = PIPE_UNLIMITED_INSTANCES,
@@ -76,15 +169,64 @@ namespace os {
 
 			os::error read(char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
 
+			// Read one whole message into a buffer from 'pool' sized to fit it. 'message' is replaced on completion
+			//  and must stay alive until then, the callback receives the message length.
+			os::error read_message(os::buffer_pool &pool, os::buffer_pool::buffer &message,
+								   std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
+
 			os::error write(const char *buffer, size_t buffer_length, std::shared_ptr<os::async_op> &op,
 							os::async_op_cb_t cb);
 
+			// Read without waiting, os::error::WouldBlock unless data is there already and no read issued earlier
+			//  takes it first.
+			os::error try_read(char *buffer, size_t buffer_length, size_t &read_length);
+
+			// Write without waiting, os::error::WouldBlock while the backlog is above the high watermark. Otherwise
+			//  a copy of the message is written in the background, in order with other writes. Completions are
+			//  delivered by alertable waits of the calling thread, only then does the backlog shrink.
+			os::error try_write(const char *buffer, size_t buffer_length);
+
+			// Bytes taken by try_write() whose completion was not delivered yet.
+			size_t get_backlog();
+
+			// Once the backlog rises above 'high', try_write() refuses messages until it fell back to 'low'.
+			void set_write_watermarks(size_t low, size_t high);
+
+			// Called with false once the backlog rises above the high watermark, and with true once it fell back to
+			//  the low one, on whichever thread noticed. It must not destroy the pipe.
+			void set_writable_callback(std::function<void(bool writable)> cb);
+
+			// Signalled once the backlog fell back to the low watermark. Waiting on it delivers completions, so it
+			//  belongs in the wait set while try_write() reports a backlog.
+			os::waitable *get_writable();
+
+			// Signalled once a message waits to be read, so that callers learn when to read without a semaphore on
+			//  the side. Edge triggered: it fires once per message, or when the remote end hangs up, then stays quiet
+			//  until the next read(), read_message() or try_read() was issued. Lives as long as the pipe.
+			os::waitable *get_readable();
+
 			bool is_created();
 
 			bool is_connected();
 
 			void set_connected(bool is_connected);
 
+			// Called once when the remote end is found to be gone, on whichever thread noticed. It must not destroy
+			//  the pipe.
+			void set_disconnect_callback(std::function<void()> cb);
+
+			virtual os::pipe_stats stats() override;
+
+			virtual os::histogram get_latency(os::latency_type type) override;
+
+			// Latency histograms are off until enabled here, or until the pipe is published on the stats page.
+			virtual void set_latency_tracking(bool enabled) override;
+
+			void reset_latency();
+
+			// Capture every completed message into 'capture', tagged with 'lane'. Call before issuing any I/O.
+			void set_capture(std::shared_ptr<os::capture::writer> capture, uint32_t lane);
+
 			public: // created only
 			os::error accept(std::shared_ptr<os::async_op> &op, os::async_op_cb_t cb);
 		};
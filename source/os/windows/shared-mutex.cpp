@@ -0,0 +1,170 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include "../shared-mutex.hpp"
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <windows.h>
+#include "utility.hpp"
+
+// Shared memory can't hold handles, so every process opens the kernel objects by name once and keeps them.
+inline HANDLE get_object(uint64_t id, bool semaphore) {
+	static std::mutex                         lock;
+	static std::unordered_map<uint64_t, HANDLE> handles;
+
+	std::unique_lock<std::mutex> ul(lock);
+	auto                         it = handles.find(id);
+	if (it != handles.end()) {
+		return it->second;
+	}
+
+	wchar_t name[64];
+	swprintf_s(name, L"datalane-shared-%016llx", (unsigned long long)id);
+	HANDLE handle = semaphore ? CreateSemaphoreW(NULL, 0, LONG_MAX, name) : CreateEventW(NULL, FALSE, FALSE, name);
+	if (handle) {
+		handles.emplace(id, handle);
+	}
+	return handle;
+}
+
+// One registered waiter in shared_condition::waiters.
+const uint64_t WAITER = uint64_t(1) << 32;
+
+inline uint64_t make_id() {
+	static std::atomic<uint64_t> counter{0};
+	std::random_device           random;
+	uint64_t                     id = (uint64_t(random()) << 32) | uint64_t(random());
+	return id ^ (uint64_t(GetCurrentProcessId()) << 16) ^ counter.fetch_add(1);
+}
+
+os::shared_mutex::shared_mutex() : state(0), id(make_id()) {}
+
+os::shared_mutex::~shared_mutex() {}
+
+os::error os::shared_mutex::lock() {
+	return lock(std::chrono::milliseconds(INFINITE));
+}
+
+os::error os::shared_mutex::lock(std::chrono::nanoseconds timeout) {
+	uint32_t expected = 0;
+	if (state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+		return os::error::Success;
+	} else if (timeout.count() <= 0) {
+		return os::error::TimedOut;
+	}
+
+	HANDLE event = get_object(id, false);
+	if (!event) {
+		return os::error::Error;
+	}
+
+	// Whoever finds the mutex locked marks it contended, so that unlock() knows to wake somebody up.
+	bool infinite = os::windows::utility::to_milliseconds(timeout) >= INFINITE;
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (state.exchange(2, std::memory_order_acquire) != 0) {
+		DWORD ms = INFINITE;
+		if (!infinite) {
+			auto remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining.count() <= 0) {
+				return os::error::TimedOut;
+			}
+			ms = DWORD(os::windows::utility::to_milliseconds(remaining));
+		}
+		if (WaitForSingleObject(event, ms) == WAIT_FAILED) {
+			return os::error::Error;
+		}
+	}
+	return os::error::Success;
+}
+
+os::error os::shared_mutex::unlock() {
+	if (state.exchange(0, std::memory_order_release) == 2) {
+		HANDLE event = get_object(id, false);
+		if (!event || !SetEvent(event)) {
+			return os::error::Error;
+		}
+	}
+	return os::error::Success;
+}
+
+os::shared_condition::shared_condition() : waiters(0), id(make_id()), watcher(0) {}
+
+os::shared_condition::~shared_condition() {}
+
+os::error os::shared_condition::wait(shared_mutex &mutex) {
+	return wait(mutex, std::chrono::milliseconds(INFINITE));
+}
+
+os::error os::shared_condition::wait(shared_mutex &mutex, std::chrono::nanoseconds timeout) {
+	HANDLE semaphore = get_object(id, true);
+	if (!semaphore) {
+		return os::error::Error;
+	}
+
+	waiters.fetch_add(WAITER);
+	mutex.unlock();
+
+	os::error ec     = os::error::Success;
+	DWORD     result = WaitForSingleObject(semaphore, DWORD(os::windows::utility::to_milliseconds(timeout)));
+	if (result == WAIT_OBJECT_0) {
+		waiters.fetch_sub(WAITER + 1);
+	} else {
+		// Only the registration goes, a wakeup posted meanwhile stays in the semaphore for whoever waits now or
+		//  next. Taking it here instead could take the one meant for a thread that is still waiting.
+		waiters.fetch_sub(WAITER);
+		ec = (result == WAIT_TIMEOUT) ? os::error::TimedOut : os::error::Error;
+	}
+
+	os::error lock_ec = mutex.lock();
+	return (lock_ec != os::error::Success) ? lock_ec : ec;
+}
+
+// Only wakes threads that don't have a wakeup waiting for them already.
+os::error os::shared_condition::notify_one() {
+	ring_watcher();
+
+	uint64_t state = waiters.load();
+	do {
+		if ((state >> 32) <= (state & UINT32_MAX)) {
+			return os::error::Success;
+		}
+	} while (!waiters.compare_exchange_weak(state, state + 1));
+
+	HANDLE semaphore = get_object(id, true);
+	return (semaphore && ReleaseSemaphore(semaphore, 1, NULL)) ? os::error::Success : os::error::Error;
+}
+
+os::error os::shared_condition::notify_all() {
+	ring_watcher();
+
+	uint64_t state = waiters.load();
+	uint64_t count = 0;
+	do {
+		if ((state >> 32) <= (state & UINT32_MAX)) {
+			return os::error::Success;
+		}
+		count = (state >> 32) - (state & UINT32_MAX);
+	} while (!waiters.compare_exchange_weak(state, state + count));
+
+	HANDLE semaphore = get_object(id, true);
+	return (semaphore && ReleaseSemaphore(semaphore, LONG(count), NULL)) ? os::error::Success : os::error::Error;
+}
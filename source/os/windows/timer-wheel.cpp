@@ -0,0 +1,68 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include "../timer-wheel.hpp"
+#include <stdexcept>
+#include <windows.h>
+
+// Windows 10 1803 and later, older versions fall back to a timer at the resolution of the system clock.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+os::timer_wheel::timer_wheel(std::chrono::nanoseconds resolution) : epoch(clock::now()), resolution(resolution) {
+	if (resolution.count() <= 0) {
+		throw std::invalid_argument("'resolution' must be positive.");
+	}
+
+	timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!timer) {
+		timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+	}
+	if (!timer) {
+		throw std::runtime_error("Creating the timer failed.");
+	}
+}
+
+os::timer_wheel::~timer_wheel() {
+	clear();
+	CloseHandle((HANDLE)timer);
+}
+
+void os::timer_wheel::arm(uint64_t tick) {
+	if (tick == UINT64_MAX) {
+		CancelWaitableTimer((HANDLE)timer);
+	} else {
+		// Relative due times are negative and in units of 100 nanoseconds, rounded up so it never fires early.
+		auto          remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(to_time(tick) - clock::now());
+		LARGE_INTEGER due;
+		due.QuadPart = -LONGLONG((remaining.count() + 99) / 100);
+		if (due.QuadPart >= 0) {
+			due.QuadPart = -1;
+		}
+		SetWaitableTimer((HANDLE)timer, &due, 0, NULL, NULL, FALSE);
+	}
+	armed = tick;
+}
+
+void *os::timer_wheel::get_waitable() {
+	return timer;
+}
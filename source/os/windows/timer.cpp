@@ -0,0 +1,81 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdexcept>
+#include <vector>
+#include "timer.hpp"
+
+// Windows 10 1803 and later, older versions fall back to a timer at the resolution of the system clock.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+os::windows::timer::timer() {
+	handle = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!handle) {
+		handle = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+	}
+	if (!handle) {
+		std::vector<char> msg(2048);
+		sprintf_s(msg.data(), msg.size(), "Timer creation failed with error code %lX.\0", GetLastError());
+		throw std::runtime_error(msg.data());
+	}
+}
+
+os::windows::timer::~timer() {
+	if (handle) {
+		CloseHandle(handle);
+	}
+}
+
+os::error os::windows::timer::start(std::chrono::nanoseconds delay,
+									std::chrono::nanoseconds period /*= std::chrono::nanoseconds(0)*/) {
+	// Relative due times are negative and in units of 100 nanoseconds, periods are milliseconds. Both are rounded
+	//  up so that the timer never fires early.
+	LARGE_INTEGER due;
+	due.QuadPart = -LONGLONG((delay.count() + 99) / 100);
+	if (due.QuadPart >= 0) {
+		due.QuadPart = -1;
+	}
+	LONG period_ms = 0;
+	if (period.count() > 0) {
+		period_ms = LONG(std::chrono::duration_cast<std::chrono::milliseconds>(
+							 period + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1))
+							 .count());
+	}
+
+	if (!SetWaitableTimer(handle, &due, period_ms, NULL, NULL, FALSE)) {
+		return os::error::Error;
+	}
+	return os::error::Success;
+}
+
+os::error os::windows::timer::stop() {
+	return CancelWaitableTimer(handle) ? os::error::Success : os::error::Error;
+}
+
+uint64_t os::windows::timer::get_expirations() {
+	return 1;
+}
+
+void *os::windows::timer::get_waitable() {
+	return (void *)handle;
+}
+
+std::shared_ptr<os::timer> os::timer::construct() {
+	return std::make_shared<os::windows::timer>();
+}
@@ -0,0 +1,51 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OS_WINDOWS_TIMER_HPP
+#define OS_WINDOWS_TIMER_HPP
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include "../timer.hpp"
+
+namespace os {
+	namespace windows {
+		// Synchronization timer, so that a wait consumes it. Periods are whole milliseconds.
+		class timer : public os::timer {
+			HANDLE handle;
+
+			public:
+			timer();
+			virtual ~timer();
+
+			virtual os::error start(std::chrono::nanoseconds delay,
+									std::chrono::nanoseconds period = std::chrono::nanoseconds(0)) override;
+
+			virtual os::error stop() override;
+
+			virtual uint64_t get_expirations() override;
+
+			// os::waitable
+			protected:
+			virtual void *get_waitable() override;
+		};
+	} // namespace windows
+} // namespace os
+
+#endif // OS_WINDOWS_TIMER_HPP
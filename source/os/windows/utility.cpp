@@ -25,6 +25,8 @@ os::error os::windows::utility::translate_error(DWORD error_code) {
 		// !FIXME! Should this have its own error code?
 		return os::error::Pending;
 	case ERROR_BROKEN_PIPE:
+	case ERROR_NO_DATA:
+	case ERROR_PIPE_NOT_CONNECTED:
 		return os::error::Disconnected;
 	case ERROR_MORE_DATA:
 		return os::error::MoreData;
@@ -39,3 +41,12 @@ os::error os::windows::utility::translate_error(DWORD error_code) {
 
 	return os::error::Error;
 }
+
+int64_t os::windows::utility::to_milliseconds(std::chrono::nanoseconds timeout) {
+	if (timeout.count() <= 0) {
+		return 0;
+	}
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			   timeout + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1))
+		.count();
+}
@@ -22,6 +22,7 @@
 #define WIN32_LEAN_AND_MEAN
 #endif
 
+#include <chrono>
 #include <windows.h>
 #include "../error.hpp"
 
@@ -29,6 +30,9 @@ namespace os {
 	namespace windows {
 		namespace utility {
 			os::error translate_error(DWORD error_code);
+
+			// Timeout for the Wait* functions, rounded up so that waits shorter than a millisecond still block.
+			int64_t to_milliseconds(std::chrono::nanoseconds timeout);
 		};
 	} // namespace windows
 } // namespace os
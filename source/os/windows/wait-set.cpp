@@ -0,0 +1,183 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include "../wait-set.hpp"
+#include <stdexcept>
+#include <windows.h>
+#include "../async_op.hpp"
+#include "../trace.hpp"
+#include "async_request.hpp"
+#include "utility.hpp"
+
+os::wait_set::wait_set() {}
+
+os::wait_set::~wait_set() {}
+
+bool os::wait_set::add(waitable *item) {
+	if (!item || (members.size() >= MAXIMUM_WAIT_OBJECTS)) {
+		return false;
+	}
+	for (waitable *member : members) {
+		if (member == item) {
+			return false;
+		}
+	}
+	members.push_back(item);
+	handles.push_back(item->get_waitable());
+	return true;
+}
+
+bool os::wait_set::remove(waitable *item) {
+	for (size_t idx = 0; idx < members.size(); idx++) {
+		if (members[idx] != item) {
+			continue;
+		}
+		members.erase(members.begin() + idx);
+		handles.erase(handles.begin() + idx);
+		return true;
+	}
+	return false;
+}
+
+size_t os::wait_set::size() {
+	return members.size();
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready, size_t max, std::chrono::nanoseconds timeout) {
+	if (max == 0) {
+		throw std::invalid_argument("'max' must be at least one.");
+	}
+	DATALANE_TRACE_SCOPE(Wait, nullptr, "wait_set");
+	auto wait_begin = std::chrono::high_resolution_clock::now();
+
+	ready.clear();
+	int64_t ms_timeout = os::windows::utility::to_milliseconds(timeout);
+
+	// Start where the last wait stopped, so that members signalled all the time can't starve the others.
+	size_t count  = handles.size();
+	size_t offset = (count > 0) ? (cursor % count) : 0;
+	rotated.resize(count);
+	for (size_t pos = 0; pos < count; pos++) {
+		rotated[pos] = handles[(offset + pos) % count];
+	}
+
+	// Poll without blocking while the spin budget lasts.
+	auto                     spin_start = os::spinner::clock::now();
+	std::chrono::nanoseconds spin       = spinner.begin(spin_start);
+	bool                     polled     = false;
+	DWORD                    result     = WAIT_TIMEOUT;
+	if (spin > timeout) {
+		spin = timeout;
+	}
+	while ((spin.count() > 0) && (os::spinner::clock::now() < (spin_start + spin))) {
+		polled = true;
+		result = WaitForMultipleObjectsEx(DWORD(count), (HANDLE *)rotated.data(), FALSE, 0, FALSE);
+		if (result != WAIT_TIMEOUT) {
+			break;
+		}
+		spinner.relax();
+	}
+	bool block = (result == WAIT_TIMEOUT);
+	bool slept = block && (ms_timeout > 0);
+
+wait_set_retry:
+	auto start = std::chrono::high_resolution_clock::now();
+	if (ms_timeout < 0) {
+		ms_timeout = 0;
+	}
+
+	if (block) {
+		result = WaitForMultipleObjectsEx(DWORD(count), (HANDLE *)rotated.data(), FALSE, DWORD(ms_timeout), TRUE);
+	}
+	if (result != WAIT_IO_COMPLETION) {
+		spinner.end(spin_start, os::spinner::clock::now(), spin, polled, slept, result != WAIT_TIMEOUT);
+	}
+	if ((result >= WAIT_OBJECT_0) && result < (WAIT_OBJECT_0 + MAXIMUM_WAIT_OBJECTS)) {
+		// Only the lowest signalled index is reported, collect the rest without waiting.
+		size_t first = result - WAIT_OBJECT_0;
+		size_t last  = first;
+		ready.push_back(members[(offset + first) % count]);
+		for (size_t pos = first + 1; (pos < count) && (ready.size() < max); pos++) {
+			if (WaitForSingleObjectEx((HANDLE)rotated[pos], 0, FALSE) == WAIT_OBJECT_0) {
+				ready.push_back(members[(offset + pos) % count]);
+				last = pos;
+			}
+		}
+		cursor = offset + last + 1;
+
+		std::chrono::nanoseconds blocked = std::chrono::high_resolution_clock::now() - wait_begin;
+		for (waitable *item : ready) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(item);
+			if (ar) {
+				ar->on_wakeup(blocked);
+			}
+			os::async_op *aop = dynamic_cast<os::async_op *>(item);
+			if (aop) {
+				aop->call_callback();
+			}
+		}
+		return os::error::Success;
+	} else if (result == WAIT_TIMEOUT) {
+		for (waitable *item : members) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(item);
+			if (ar) {
+				ar->on_timeout();
+			}
+		}
+		return os::error::TimedOut;
+	} else if ((result >= WAIT_ABANDONED_0) && result < (WAIT_ABANDONED_0 + MAXIMUM_WAIT_OBJECTS)) {
+		ready.push_back(members[(offset + result - WAIT_ABANDONED_0) % count]);
+		return os::error::Disconnected; // Disconnected Semaphore from original Owner
+	} else if (result == WAIT_IO_COMPLETION) {
+		ms_timeout -=
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start)
+				.count();
+		goto wait_set_retry;
+	}
+	return os::error::Error;
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready, std::chrono::nanoseconds timeout) {
+	return wait(ready, SIZE_MAX, timeout);
+}
+
+os::error os::wait_set::wait(std::vector<waitable *> &ready) {
+	return wait(ready, SIZE_MAX, std::chrono::milliseconds(INFINITE));
+}
+
+size_t os::wait_set::poll_completions(size_t max) {
+	if (wait(completed, max, std::chrono::nanoseconds(0)) != os::error::Success) {
+		return 0;
+	}
+	return completed.size();
+}
+
+void os::wait_set::set_spin_policy(const os::spin_policy &policy) {
+	spinner.set_policy(policy);
+}
+
+os::spin_policy os::wait_set::get_spin_policy() {
+	return spinner.get_policy();
+}
+
+os::spin_stats os::wait_set::get_spin_stats() {
+	return spinner.get_stats();
+}
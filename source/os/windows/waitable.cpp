@@ -21,11 +21,16 @@
 
 #include <windows.h>
 #include "../async_op.hpp"
+#include "../trace.hpp"
 #include "../waitable.hpp"
+#include "async_request.hpp"
+#include "utility.hpp"
 
 os::error os::waitable::wait(waitable *item, std::chrono::nanoseconds timeout) {
 	HANDLE  handle     = (HANDLE)item->get_waitable();
-	int64_t ms_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+	int64_t ms_timeout = os::windows::utility::to_milliseconds(timeout);
+	DATALANE_TRACE_SCOPE(Wait, item, "wait");
+	auto wait_begin = std::chrono::high_resolution_clock::now();
 
 wait_retry:
 	auto start = std::chrono::high_resolution_clock::now();
@@ -35,12 +40,20 @@ wait_retry:
 
 	DWORD result = WaitForSingleObjectEx(handle, DWORD(ms_timeout), TRUE);
 	if (result == WAIT_OBJECT_0) {
+		os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(item);
+		if (ar) {
+			ar->on_wakeup(std::chrono::high_resolution_clock::now() - wait_begin);
+		}
 		os::async_op *aop = dynamic_cast<os::async_op *>(item);
 		if (aop) {
 			aop->call_callback();
 		}
 		return os::error::Success;
 	} else if (result == WAIT_TIMEOUT) {
+		os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(item);
+		if (ar) {
+			ar->on_timeout();
+		}
 		return os::error::TimedOut;
 	} else if (result == WAIT_ABANDONED) {
 		return os::error::Disconnected; // Disconnected Semaphore from original Owner
@@ -59,58 +72,111 @@ os::error os::waitable::wait(waitable *item) {
 
 os::error os::waitable::wait_any(waitable **items, size_t items_count, size_t &signalled_index,
 								 std::chrono::nanoseconds timeout) {
+	size_t    signalled_count = 0;
+	os::error ec              = wait_many(items, items_count, &signalled_index, 1, signalled_count, timeout);
+	if (ec == os::error::TimedOut) {
+		signalled_index = -1;
+	}
+	return ec;
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, std::chrono::nanoseconds timeout) {
+	size_t cursor = 0;
+	return wait_many(items, items_count, signalled, max, signalled_count, cursor, timeout);
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, size_t &cursor, std::chrono::nanoseconds timeout) {
 	if (items == nullptr) {
 		throw std::invalid_argument("'items' can't be nullptr.");
+	} else if ((signalled == nullptr) || (max == 0)) {
+		throw std::invalid_argument("'signalled' needs room for at least one index.");
 	} else if (items_count > MAXIMUM_WAIT_OBJECTS) {
 		throw std::invalid_argument("Too many items to wait for.");
 	}
+	DATALANE_TRACE_SCOPE(Wait, (items_count == 1) ? items[0] : nullptr, (max == 1) ? "wait_any" : "wait_many");
+	auto wait_begin = std::chrono::high_resolution_clock::now();
 
-	// Need to create a sequential array of HANDLEs here.
-	size_t              valid_handles = 0;
-	std::vector<HANDLE> handles(items_count);
-	std::vector<size_t> idxToTrueIdx(items_count);
-	for (size_t idx = 0, eidx = items_count; idx < eidx; idx++) {
+	// Need to create a sequential array of HANDLEs here, starting at the cursor as the lowest signalled one wins.
+	size_t valid_handles = 0;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	size_t indices[MAXIMUM_WAIT_OBJECTS];
+	size_t offset = (items_count > 0) ? (cursor % items_count) : 0;
+	for (size_t pos = 0; pos < items_count; pos++) {
+		size_t    idx = (offset + pos) % items_count;
 		waitable *obj = items[idx];
 		if (obj) {
 			handles[valid_handles] = (HANDLE)obj->get_waitable();
-			idxToTrueIdx[idx]      = valid_handles;
+			indices[valid_handles] = idx;
 			valid_handles++;
 		}
 	}
 
-	int64_t ms_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+	signalled_count    = 0;
+	int64_t ms_timeout = os::windows::utility::to_milliseconds(timeout);
 
-wait_any_retry:
+wait_many_retry:
 	auto start = std::chrono::high_resolution_clock::now();
 	if (ms_timeout < 0) {
 		ms_timeout = 0;
 	}
 
-	DWORD result = WaitForMultipleObjectsEx(DWORD(valid_handles), handles.data(), FALSE, DWORD(ms_timeout), TRUE);
+	DWORD result = WaitForMultipleObjectsEx(DWORD(valid_handles), handles, FALSE, DWORD(ms_timeout), TRUE);
 	if ((result >= WAIT_OBJECT_0) && result < (WAIT_OBJECT_0 + MAXIMUM_WAIT_OBJECTS)) {
-		signalled_index = idxToTrueIdx[result - WAIT_OBJECT_0];
-
-		os::async_op *aop = dynamic_cast<os::async_op *>(items[signalled_index]);
-		if (aop) {
-			aop->call_callback();
+		// Only the lowest signalled index is reported, collect the rest without waiting.
+		size_t first                 = result - WAIT_OBJECT_0;
+		signalled[signalled_count++] = indices[first];
+		for (size_t idx = first + 1; (idx < valid_handles) && (signalled_count < max); idx++) {
+			if (WaitForSingleObjectEx(handles[idx], 0, FALSE) == WAIT_OBJECT_0) {
+				signalled[signalled_count++] = indices[idx];
+			}
 		}
 
+		cursor = signalled[signalled_count - 1] + 1;
+
+		std::chrono::nanoseconds blocked = std::chrono::high_resolution_clock::now() - wait_begin;
+		for (size_t idx = 0; idx < signalled_count; idx++) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(items[signalled[idx]]);
+			if (ar) {
+				ar->on_wakeup(blocked);
+			}
+			os::async_op *aop = dynamic_cast<os::async_op *>(items[signalled[idx]]);
+			if (aop) {
+				aop->call_callback();
+			}
+		}
 		return os::error::Success;
 	} else if (result == WAIT_TIMEOUT) {
-		signalled_index = -1;
+		for (size_t idx = 0; idx < items_count; idx++) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(items[idx]);
+			if (ar) {
+				ar->on_timeout();
+			}
+		}
 		return os::error::TimedOut;
 	} else if ((result >= WAIT_ABANDONED_0) && result < (WAIT_ABANDONED_0 + MAXIMUM_WAIT_OBJECTS)) {
-		signalled_index = idxToTrueIdx[result - WAIT_ABANDONED_0];
+		signalled[signalled_count++] = indices[result - WAIT_ABANDONED_0];
 		return os::error::Disconnected; // Disconnected Semaphore from original Owner
 	} else if (result == WAIT_IO_COMPLETION) {
 		ms_timeout -=
 			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start)
 				.count();
-		goto wait_any_retry;
+		goto wait_many_retry;
 	}
 	return os::error::Error;
 }
 
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count) {
+	return wait_many(items, items_count, signalled, max, signalled_count, std::chrono::milliseconds(INFINITE));
+}
+
+os::error os::waitable::wait_many(waitable **items, size_t items_count, size_t *signalled, size_t max,
+								  size_t &signalled_count, size_t &cursor) {
+	return wait_many(items, items_count, signalled, max, signalled_count, cursor, std::chrono::milliseconds(INFINITE));
+}
+
 os::error os::waitable::wait_any(waitable **items, size_t items_count, size_t &signalled_index) {
 	return wait_any(items, items_count, signalled_index, std::chrono::milliseconds(INFINITE));
 }
@@ -131,6 +197,8 @@ os::error os::waitable::wait_all(waitable **items, size_t items_count, size_t &s
 	} else if (items_count >= MAXIMUM_WAIT_OBJECTS) {
 		throw std::invalid_argument("Too many items to wait for.");
 	}
+	DATALANE_TRACE_SCOPE(Wait, nullptr, "wait_all");
+	auto wait_begin = std::chrono::high_resolution_clock::now();
 
 	// Need to create a sequential array of HANDLEs here.
 	size_t              valid_handles = 0;
@@ -145,7 +213,7 @@ os::error os::waitable::wait_all(waitable **items, size_t items_count, size_t &s
 		}
 	}
 
-	int64_t ms_timeout = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+	int64_t ms_timeout = os::windows::utility::to_milliseconds(timeout);
 
 wait_all_retry:
 	auto start = std::chrono::high_resolution_clock::now();
@@ -157,7 +225,12 @@ wait_all_retry:
 	if ((result >= WAIT_OBJECT_0) && result < (WAIT_OBJECT_0 + MAXIMUM_WAIT_OBJECTS)) {
 		signalled_index = result - WAIT_OBJECT_0;
 
+		std::chrono::nanoseconds blocked = std::chrono::high_resolution_clock::now() - wait_begin;
 		for (size_t idx = 0; idx < items_count; idx++) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(items[idx]);
+			if (ar) {
+				ar->on_wakeup(blocked);
+			}
 			os::async_op *aop = dynamic_cast<os::async_op *>(items[idx]);
 			if (aop) {
 				aop->call_callback();
@@ -166,6 +239,12 @@ wait_all_retry:
 
 		return os::error::Success;
 	} else if (result == WAIT_TIMEOUT) {
+		for (size_t idx = 0; idx < items_count; idx++) {
+			os::windows::async_request *ar = dynamic_cast<os::windows::async_request *>(items[idx]);
+			if (ar) {
+				ar->on_timeout();
+			}
+		}
 		signalled_index = -1;
 		return os::error::TimedOut;
 	} else if ((result >= WAIT_ABANDONED_0) && result < (WAIT_ABANDONED_0 + MAXIMUM_WAIT_OBJECTS)) {
@@ -0,0 +1,114 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "hooks.hpp"
+#include <cstdlib>
+#include <errno.h>
+#include <new>
+
+static thread_local uint64_t allocations = 0;
+static thread_local uint64_t bytes       = 0;
+
+static inline void count(size_t size) {
+	allocations++;
+	bytes += size;
+}
+
+alloc::counts alloc::get() {
+	alloc::counts result;
+	result.allocations = allocations;
+	result.bytes       = bytes;
+	return result;
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+	count(size);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+	count(num * size);
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	count(size);
+	return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+	count(size);
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	count(size);
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr ? 0 : ENOMEM;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	count(size);
+	return __libc_memalign(alignment, size);
+}
+}
+#else
+void *operator new(size_t size) {
+	count(size);
+	void *ptr = std::malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	count(size);
+	return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+#endif
@@ -0,0 +1,35 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef DATALANE_ALLOC_HOOKS_HPP
+#define DATALANE_ALLOC_HOOKS_HPP
+
+#include <inttypes.h>
+
+namespace alloc {
+	struct counts {
+		uint64_t allocations = 0;
+		uint64_t bytes       = 0;
+	};
+
+	// Allocations made by the calling thread so far.
+	/// malloc, calloc and realloc are interposed with glibc, which also covers operator new. Elsewhere only
+	///  operator new is replaced, so plain malloc calls are not seen.
+	counts get();
+} // namespace alloc
+
+#endif // DATALANE_ALLOC_HOOKS_HPP
@@ -0,0 +1,266 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hooks.hpp"
+
+#ifdef _WIN32
+#include "../../source/os/windows/named-pipe.hpp"
+typedef os::windows::named_pipe pipe_t;
+#else
+#include "../../source/os/posix/named-pipe.hpp"
+typedef os::posix::named_pipe pipe_t;
+#endif
+
+// Allowed steady-state allocations per message and path. Lower these as allocations are eliminated, never
+//  raise them to make a change pass. An accept measures 2: the async_request, since the test drops the
+//  operation every time, and the stats shard of the fresh pipe for this thread. The third is headroom.
+static const struct {
+	const char *path;
+	double      budget;
+} default_budgets[] = {
+	{"accept", 3},
+	{"write", 0.05},
+	{"read", 0.05},
+	{"read_message", 0.05},
+	{"wait", 0.05},
+	{"wait_any", 0.05},
+};
+
+static const std::chrono::seconds timeout(10);
+
+struct path_counts {
+	uint64_t operations  = 0;
+	uint64_t allocations = 0;
+	uint64_t bytes       = 0;
+};
+
+// Counts the allocations the calling thread makes while running 'fn'.
+template<typename T>
+static void measure(std::map<std::string, path_counts> &paths, const char *path, T fn) {
+	alloc::counts before = alloc::get();
+	fn();
+	alloc::counts after = alloc::get();
+	path_counts & pc    = paths[path];
+	pc.operations++;
+	pc.allocations += after.allocations - before.allocations;
+	pc.bytes += after.bytes - before.bytes;
+}
+
+static void check(os::error ec, const char *what) {
+	if ((ec != os::error::Success) && (ec != os::error::Pending) && (ec != os::error::Connected)) {
+		throw std::runtime_error(std::string(what) + " failed with error " + std::to_string(int(ec)) + ".");
+	}
+}
+
+static std::string make_pipe_name(const char *what) {
+	return std::string("datalane-alloc-") + what + "-"
+		   + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000000);
+}
+
+// Client writes and reads the echo, every call is measured separately.
+static void run_echo(size_t warmup, size_t messages, size_t size, std::map<std::string, path_counts> &paths) {
+	std::string name = make_pipe_name("echo");
+	pipe_t      server(os::create_only, name, 1);
+
+	std::exception_ptr error;
+	std::thread        echo([&]() {
+		try {
+			std::shared_ptr<os::async_op> accept_op, read_op, write_op;
+			std::vector<char>             buffer(size);
+			os::error                     ec = server.accept(accept_op, nullptr);
+			if (ec == os::error::Pending) {
+				check(accept_op->wait(timeout), "Accepting");
+			}
+			for (size_t idx = 0; idx < warmup + messages; idx++) {
+				os::error result = os::error::Unknown;
+				size_t    length = 0;
+				check(server.read(buffer.data(), buffer.size(), read_op,
+								[&result, &length](os::error ec, size_t len) {
+									result = ec;
+									length = len;
+								}),
+					"Reading");
+				check(read_op->wait(timeout), "Waiting for read");
+				check(result, "Read");
+				check(server.write(buffer.data(), length, write_op, nullptr), "Writing");
+				check(write_op->wait(timeout), "Waiting for write");
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+	});
+
+	pipe_t                             client(os::open_only, name);
+	std::shared_ptr<os::async_op>      read_op, write_op;
+	std::vector<char>                  out(size, 'x'), in(size);
+	os::buffer_pool                    pool;
+	os::buffer_pool::buffer            message;
+	std::map<std::string, path_counts> discard;
+	os::error                          result = os::error::Unknown;
+	// Callbacks capture a single pointer so that std::function keeps them inline.
+	os::async_op_cb_t cb = [&result](os::error ec, size_t) { result = ec; };
+
+	for (size_t idx = 0; idx < warmup + messages; idx++) {
+		// Warmup lets reused requests and buffers reach their final size before anything is counted.
+		std::map<std::string, path_counts> &target = idx < warmup ? discard : paths;
+		os::error                           ec     = os::error::Unknown;
+
+		measure(target, "write", [&]() { ec = client.write(out.data(), out.size(), write_op, cb); });
+		check(ec, "Writing");
+		measure(target, "wait", [&]() { ec = write_op->wait(timeout); });
+		check(ec, "Waiting for write");
+		check(result, "Write");
+
+		// Every other echo goes into a pooled buffer, which the wait below fills once the length is known.
+		if (idx % 2) {
+			measure(target, "read_message", [&]() { ec = client.read_message(pool, message, read_op, cb); });
+		} else {
+			measure(target, "read", [&]() { ec = client.read(in.data(), in.size(), read_op, cb); });
+		}
+		check(ec, "Reading");
+		size_t        index   = 0;
+		os::waitable *waits[] = {read_op.get()};
+		measure(target, "wait_any", [&]() { ec = os::waitable::wait_any(waits, 1, index, timeout); });
+		check(ec, "Waiting for read");
+		check(result, "Read");
+	}
+
+	echo.join();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+// A new client connects for every accept, only accept() and waiting for it are measured.
+static void run_accept(size_t warmup, size_t connections, std::map<std::string, path_counts> &paths) {
+	std::string name = make_pipe_name("accept");
+
+	std::map<std::string, path_counts> discard;
+	std::shared_ptr<os::async_op>      accept_op;
+	for (size_t idx = 0; idx < warmup + connections; idx++) {
+		std::map<std::string, path_counts> &target = idx < warmup ? discard : paths;
+		pipe_t                              server(os::create_only, name, 1);
+		std::thread                         connector([&]() { pipe_t client(os::open_only, name); });
+
+		measure(target, "accept", [&]() {
+			os::error ec = server.accept(accept_op, nullptr);
+			if (ec == os::error::Pending) {
+				ec = accept_op->wait(timeout);
+			}
+			check(ec, "Accepting");
+		});
+		connector.join();
+		accept_op.reset();
+	}
+}
+
+static void usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  --messages N        Measured messages (default 10000)\n"
+			"  --warmup N          Unmeasured messages before (default 1000)\n"
+			"  --size BYTES        Message size (default 256)\n"
+			"  --budget PATH=N     Allowed allocations per operation of PATH, overrides the built-in budget\n"
+			"  --report            Only report, never fail\n",
+			program);
+}
+
+int main(int argc, const char *argv[]) {
+	size_t                        messages = 10000;
+	size_t                        warmup   = 1000;
+	size_t                        size     = 256;
+	bool                          report   = false;
+	std::map<std::string, double> budgets;
+	for (auto &entry : default_budgets) {
+		budgets[entry.path] = entry.budget;
+	}
+
+	try {
+		for (int idx = 1; idx < argc; idx++) {
+			std::string arg   = argv[idx];
+			const char *value = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+			if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else if (arg == "--report") {
+				report = true;
+				continue;
+			} else if (!value) {
+				throw std::invalid_argument("Missing value for '" + arg + "'.");
+			}
+			idx++;
+
+			if (arg == "--messages") {
+				messages = size_t(strtoull(value, nullptr, 10));
+			} else if (arg == "--warmup") {
+				warmup = size_t(strtoull(value, nullptr, 10));
+			} else if (arg == "--size") {
+				size = size_t(strtoull(value, nullptr, 10));
+			} else if (arg == "--budget") {
+				const char *eq = strchr(value, '=');
+				if (!eq || (budgets.find(std::string(value, eq)) == budgets.end())) {
+					throw std::invalid_argument(std::string("Invalid budget '") + value + "'.");
+				}
+				budgets[std::string(value, eq)] = strtod(eq + 1, nullptr);
+			} else {
+				throw std::invalid_argument("Unknown option '" + arg + "'.");
+			}
+		}
+		if ((messages == 0) || (size == 0)) {
+			throw std::invalid_argument("'--messages' and '--size' must be at least 1.");
+		}
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::map<std::string, path_counts> paths;
+	try {
+		run_echo(warmup, messages, size, paths);
+		// Connections are expensive to set up, so fewer of them are enough.
+		run_accept(warmup / 10, std::max<size_t>(messages / 100, 10), paths);
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	int code = 0;
+	printf("%-12s %12s %14s %14s %10s  %s\n", "PATH", "OPERATIONS", "ALLOCS/OP", "BYTES/OP", "BUDGET", "RESULT");
+	for (auto &kv : paths) {
+		double per_op   = double(kv.second.allocations) / double(kv.second.operations);
+		double bytes_op = double(kv.second.bytes) / double(kv.second.operations);
+		double budget   = budgets[kv.first];
+		bool   over     = per_op > budget;
+		printf("%-12s %12llu %14.2f %14.1f %10.2f  %s\n", kv.first.c_str(), (unsigned long long)kv.second.operations,
+			   per_op, bytes_op, budget, over ? "OVER BUDGET" : "ok");
+		if (over && !report) {
+			code = 1;
+		}
+	}
+	return code;
+}
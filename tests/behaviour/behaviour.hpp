@@ -0,0 +1,71 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef DATALANE_BEHAVIOUR_HPP
+#define DATALANE_BEHAVIOUR_HPP
+
+#include <stdexcept>
+#include <string>
+
+namespace behaviour {
+	// Fails the running case with 'what' unless 'condition' holds.
+	inline void check(bool condition, const std::string &what) {
+		if (!condition) {
+			throw std::runtime_error(what);
+		}
+	}
+
+	void wait_many_fairness();
+	void wait_set_fairness();
+
+	void timer_wheel_cascade();
+	void timer_wheel_jump();
+	void timer_wheel_wait();
+
+	void event_auto_reset();
+	void event_manual_reset();
+	void event_wakeup();
+#ifndef _WIN32
+	void event_cross_process();
+#endif
+	void timer_once();
+	void timer_periodic();
+
+	void condition_timeout();
+	void condition_notify_one();
+	void condition_notify_all();
+	void condition_timeout_then_notify();
+	void condition_watch();
+#ifndef _WIN32
+	void condition_owner_death();
+#endif
+
+	void doorbell_coalescing();
+	void doorbell_race();
+
+#ifndef _WIN32
+	void pipe_cancel_read();
+	void pipe_try_read();
+	void pipe_write_backlog();
+	void pipe_backlog_on_read();
+	void pipe_wait_set_cancel();
+	void pipe_hangup_pending();
+	void pipe_readable_wait();
+#endif
+} // namespace behaviour
+
+#endif // DATALANE_BEHAVIOUR_HPP
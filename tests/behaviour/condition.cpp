@@ -0,0 +1,233 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include <chrono>
+#include <new>
+#include <thread>
+#include "behaviour.hpp"
+#include "../../source/os/shared-mutex.hpp"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock steady;
+
+static const std::chrono::milliseconds short_wait(20);
+static const std::chrono::seconds      long_wait(5);
+
+// Waiters take one token each, a notification hands out tokens.
+struct shared_state {
+	os::shared_mutex     mutex;
+	os::shared_condition condition;
+	size_t               waiting  = 0;
+	size_t               tokens   = 0;
+	size_t               consumed = 0;
+	size_t               failed   = 0;
+};
+
+// Waits until a token is available or 'timeout' passed without any notification.
+static void take_token(shared_state &state, std::chrono::nanoseconds timeout) {
+	if (state.mutex.lock() != os::error::Success) {
+		state.failed++;
+		return;
+	}
+	state.waiting++;
+	while (state.tokens == 0) {
+		os::error ec = state.condition.wait(state.mutex, timeout);
+		if (ec == os::error::TimedOut) {
+			break;
+		} else if (ec != os::error::Success) {
+			state.failed++;
+			break;
+		}
+	}
+	if (state.tokens > 0) {
+		state.tokens--;
+		state.consumed++;
+	}
+	state.waiting--;
+	state.mutex.unlock();
+}
+
+// Blocks until 'count' threads sit in take_token().
+static void await_waiters(shared_state &state, size_t count) {
+	steady::time_point end = steady::now() + long_wait;
+	for (;;) {
+		behaviour::check(state.mutex.lock() == os::error::Success, "Locking the mutex failed.");
+		size_t waiting = state.waiting;
+		state.mutex.unlock();
+		if (waiting >= count) {
+			return;
+		}
+		behaviour::check(steady::now() < end, "The waiters did not start waiting.");
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Hands out 'count' tokens, then notifies one or all waiters.
+static void give_tokens(shared_state &state, size_t count, bool all) {
+	behaviour::check(state.mutex.lock() == os::error::Success, "Locking the mutex failed.");
+	state.tokens += count;
+	state.mutex.unlock();
+	os::error ec = all ? state.condition.notify_all() : state.condition.notify_one();
+	behaviour::check(ec == os::error::Success, "Notifying returned error " + std::to_string(int(ec)) + ".");
+}
+
+static size_t get_consumed(shared_state &state) {
+	behaviour::check(state.mutex.lock() == os::error::Success, "Locking the mutex failed.");
+	size_t consumed = state.consumed;
+	state.mutex.unlock();
+	return consumed;
+}
+
+// A wait without a notification times out, with the mutex held again.
+void behaviour::condition_timeout() {
+	shared_state state;
+	check(state.mutex.lock() == os::error::Success, "Locking the mutex failed.");
+	steady::time_point begin = steady::now();
+	os::error          ec    = state.condition.wait(state.mutex, short_wait);
+	steady::duration   took  = steady::now() - begin;
+	check(state.mutex.unlock() == os::error::Success, "The mutex was not held after the wait.");
+	check(ec == os::error::TimedOut, "The wait returned error " + std::to_string(int(ec)) + ".");
+	check(took >= short_wait, "The wait timed out early.");
+}
+
+// Two waiters, two notify_one() calls: each hands over one token, and both waiters get one.
+void behaviour::condition_notify_one() {
+	shared_state state;
+	std::thread  first([&]() { take_token(state, long_wait); });
+	std::thread  second([&]() { take_token(state, long_wait); });
+	await_waiters(state, 2);
+
+	give_tokens(state, 1, false);
+	std::this_thread::sleep_for(short_wait);
+	size_t after_one = get_consumed(state);
+	give_tokens(state, 1, false);
+	first.join();
+	second.join();
+
+	check(state.failed == 0, "A waiter failed.");
+	check(after_one == 1, "One notification handed out " + std::to_string(after_one) + " tokens.");
+	check(state.consumed == 2, "Only " + std::to_string(state.consumed) + " waiters got a token.");
+}
+
+// notify_all() wakes both waiters at once.
+void behaviour::condition_notify_all() {
+	shared_state state;
+	std::thread  first([&]() { take_token(state, long_wait); });
+	std::thread  second([&]() { take_token(state, long_wait); });
+	await_waiters(state, 2);
+
+	steady::time_point begin = steady::now();
+	give_tokens(state, 2, true);
+	first.join();
+	second.join();
+
+	check(state.failed == 0, "A waiter failed.");
+	check(state.consumed == 2, "Only " + std::to_string(state.consumed) + " waiters got a token.");
+	check(steady::now() - begin < long_wait, "A waiter was not woken.");
+}
+
+// A waiter that timed out must not take the wakeup meant for the one that still waits.
+void behaviour::condition_timeout_then_notify() {
+	shared_state state;
+	std::thread  patient([&]() { take_token(state, long_wait); });
+	std::thread  impatient([&]() { take_token(state, short_wait); });
+	impatient.join();
+	await_waiters(state, 1);
+
+	steady::time_point begin = steady::now();
+	give_tokens(state, 1, false);
+	patient.join();
+
+	check(state.failed == 0, "A waiter failed.");
+	check(state.consumed == 1, "The remaining waiter did not get the token.");
+	check(steady::now() - begin < long_wait, "The remaining waiter was not woken.");
+}
+
+// A watched condition rings its doorbell on every notification, so it can be waited on like any other waitable.
+void behaviour::condition_watch() {
+	shared_state                  state;
+	std::shared_ptr<os::doorbell> bell = state.condition.watch();
+	check(bell != nullptr, "Watching the condition failed.");
+	check(state.condition.watch() == nullptr, "The condition was watched twice.");
+
+	// Empty the doorbell and check the condition before waiting, like wait() does under the mutex.
+	while (bell->take() > 0) {
+	}
+	check(bell->wait(short_wait) == os::error::TimedOut, "The doorbell rang without a notification.");
+
+	std::thread notifier([&]() {
+		std::this_thread::sleep_for(short_wait);
+		give_tokens(state, 1, false);
+	});
+	steady::time_point begin = steady::now();
+	os::error          ec    = bell->wait(long_wait);
+	notifier.join();
+	check(ec == os::error::Success, "Waiting on the doorbell returned error " + std::to_string(int(ec)) + ".");
+	check(steady::now() - begin < long_wait, "The notification did not ring the doorbell.");
+	check(bell->take() > 0, "The doorbell rang without counting the notification.");
+	check(state.mutex.lock() == os::error::Success, "Locking the mutex failed.");
+	size_t tokens = state.tokens;
+	state.mutex.unlock();
+	check(tokens == 1, "The token was not there when the doorbell rang.");
+
+	// Nobody watches any more, notifications only go to wait().
+	state.condition.unwatch();
+	while (bell->take() > 0) {
+	}
+	give_tokens(state, 1, true);
+	check(bell->wait(short_wait) == os::error::TimedOut, "The doorbell rang after unwatch().");
+	check(state.condition.watch() != nullptr, "Watching again after unwatch() failed.");
+}
+
+#ifndef _WIN32
+// A process that dies holding the mutex hands it to the next locker, which is told with os::error::Disconnected.
+void behaviour::condition_owner_death() {
+	void *memory = mmap(nullptr, sizeof(shared_state), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	check(memory != MAP_FAILED, "Mapping shared memory failed.");
+	shared_state *state = new (memory) shared_state();
+
+	pid_t child = fork();
+	if (child == 0) {
+		// Dies with the mutex held and the protected state half updated.
+		if (state->mutex.lock() == os::error::Success) {
+			state->tokens = 1;
+		}
+		_exit(0);
+	}
+	check(child > 0, "Forking failed.");
+	int status = 0;
+	waitpid(child, &status, 0);
+	check(state->tokens == 1, "The child did not take the mutex.");
+
+	os::error ec = state->mutex.lock(long_wait);
+	check(ec == os::error::Disconnected, "Locking after the owner died returned error " + std::to_string(int(ec)) + ".");
+	state->tokens = 0;
+	check(state->mutex.unlock() == os::error::Success, "Unlocking the recovered mutex failed.");
+
+	// Repaired, the mutex works as before.
+	check(state->mutex.lock() == os::error::Success, "Locking the recovered mutex failed.");
+	check(state->condition.wait(state->mutex, short_wait) == os::error::TimedOut,
+		  "Waiting on the condition with the recovered mutex failed.");
+	check(state->mutex.unlock() == os::error::Success, "The recovered mutex was not held after the wait.");
+
+	state->~shared_state();
+	munmap(memory, sizeof(shared_state));
+}
+#endif
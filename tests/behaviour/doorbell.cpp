@@ -0,0 +1,121 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "behaviour.hpp"
+#include "../../source/os/doorbell.hpp"
+#include "../../source/os/event.hpp"
+
+typedef std::chrono::steady_clock steady;
+
+static const std::chrono::milliseconds short_wait(20);
+static const std::chrono::seconds      long_wait(5);
+
+// Rings in a round of doorbell_race().
+static size_t burst(size_t round) {
+	return 1 + (round % 8);
+}
+
+// Rings only wake the consumer after take() came up empty and armed the doorbell. Until then they are
+//  collected without a wakeup.
+void behaviour::doorbell_coalescing() {
+	auto bell = os::doorbell::construct();
+
+	for (size_t idx = 0; idx < 100; idx++) {
+		check(bell->ring() == os::error::Success, "Ringing failed.");
+	}
+	os::error ec = os::waitable::wait(bell.get(), long_wait);
+	check(ec == os::error::Success, "Waiting for the first ring returned error " + std::to_string(int(ec)) + ".");
+	check(bell->take() == 100, "A burst of rings was not collected at once.");
+
+	// Not armed: take() did not come up empty yet.
+	check(bell->ring(3) == os::error::Success, "Ringing failed.");
+	ec = os::waitable::wait(bell.get(), short_wait);
+	check(ec == os::error::TimedOut, "A ring woke the consumer while it was busy.");
+	check(bell->take() == 3, "Rings during the busy phase were lost.");
+
+	// Armed again by the empty take().
+	check(bell->take() == 0, "Rings appeared out of nowhere.");
+	check(bell->ring() == os::error::Success, "Ringing failed.");
+	ec = os::waitable::wait(bell.get(), long_wait);
+	check(ec == os::error::Success, "A ring after arming returned error " + std::to_string(int(ec)) + ".");
+	check(bell->take() == 1, "The ring after arming was lost.");
+}
+
+// A producer rings short bursts through a second handle while the consumer collects and arms the doorbell again,
+//  then waits until the consumer collected the whole burst. When the last ring of a burst lands while the consumer
+//  arms and is missed, nothing else comes to wake the consumer up and the round stalls.
+void behaviour::doorbell_race() {
+	static const size_t rounds = 20000;
+
+	std::string name = "datalane-behaviour-bell-"
+					   + std::to_string(steady::now().time_since_epoch().count() % 1000000000);
+	auto consumer = os::doorbell::construct(os::create_only, name);
+	auto producer = os::doorbell::construct(os::open_only, name);
+	auto done     = os::event::construct();
+
+	std::atomic<size_t> failed(0);
+	std::thread ringer([&]() {
+		for (size_t round = 0; round < rounds; round++) {
+			for (size_t ring = 0; ring < burst(round); ring++) {
+				// Hold the last ring back by up to 20us, so that it lands anywhere in the consumer's wakeup and take().
+				if ((ring + 1) == burst(round)) {
+					steady::time_point until = steady::now() + std::chrono::nanoseconds((round % 41) * 500);
+					while (steady::now() < until) {
+					}
+				}
+				if (producer->ring() != os::error::Success) {
+					failed++;
+				}
+			}
+			if (os::waitable::wait(done.get(), long_wait) != os::error::Success) {
+				failed++;
+				return;
+			}
+		}
+	});
+
+	uint64_t expected  = 0;
+	uint64_t collected = 0;
+	size_t   wakeups   = 0;
+	size_t   round     = 0;
+	for (; round < rounds; round++) {
+		expected += burst(round);
+		while (collected < expected) {
+			os::error ec = os::waitable::wait(consumer.get(), long_wait);
+			if (ec != os::error::Success) {
+				break;
+			}
+			wakeups++;
+			while (uint64_t count = consumer->take()) {
+				collected += count;
+			}
+		}
+		if (collected != expected) {
+			break;
+		}
+		done->set();
+	}
+	// After a stalled round the producer gives up on its own, once no acknowledgement came.
+	ringer.join();
+
+	check(failed == 0, "The producer failed.");
+	check(round == rounds, "Round " + std::to_string(round) + " collected " + std::to_string(collected) + " of "
+							   + std::to_string(expected) + " rings.");
+	check(wakeups < expected, "Rings were not coalesced.");
+}
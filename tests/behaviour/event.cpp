@@ -0,0 +1,197 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <thread>
+#include "behaviour.hpp"
+#include "../../source/os/event.hpp"
+#include "../../source/os/timer.hpp"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock steady;
+
+// Long enough that a loaded machine does not blow through it, short enough to keep the suite fast.
+static const std::chrono::milliseconds short_wait(20);
+static const std::chrono::seconds      long_wait(5);
+
+static void check_wait(os::waitable *item, std::chrono::nanoseconds timeout, os::error expected, const char *what) {
+	os::error ec = os::waitable::wait(item, timeout);
+	behaviour::check(ec == expected, std::string(what) + " returned error " + std::to_string(int(ec)) + ".");
+}
+
+// An auto reset event wakes exactly one wait per set(), no matter how often it was set.
+void behaviour::event_auto_reset() {
+	auto event = os::event::construct(false, false);
+	check_wait(event.get(), short_wait, os::error::TimedOut, "Waiting on an unset event");
+
+	check(event->set() == os::error::Success, "Setting the event failed.");
+	check(event->set() == os::error::Success, "Setting the event again failed.");
+	check_wait(event.get(), long_wait, os::error::Success, "Waiting on a set event");
+	check_wait(event.get(), short_wait, os::error::TimedOut, "Waiting on a consumed event");
+}
+
+// A manual reset event stays signalled for every wait until it is reset.
+void behaviour::event_manual_reset() {
+	auto event = os::event::construct(true, true);
+	check_wait(event.get(), long_wait, os::error::Success, "Waiting on an initially set event");
+	check_wait(event.get(), long_wait, os::error::Success, "Waiting on it again");
+
+	check(event->reset() == os::error::Success, "Resetting the event failed.");
+	check_wait(event.get(), short_wait, os::error::TimedOut, "Waiting on a reset event");
+}
+
+// A set() from another thread ends a wait that is already blocked, and a named event is the same one when
+//  opened by name.
+void behaviour::event_wakeup() {
+	std::string name = "datalane-behaviour-event-"
+					   + std::to_string(steady::now().time_since_epoch().count() % 1000000000);
+	auto owner  = os::event::construct(os::create_only, name);
+	auto opened = os::event::construct(os::open_only, name);
+
+	steady::time_point begin = steady::now();
+	std::thread setter([&]() {
+		std::this_thread::sleep_for(short_wait);
+		opened->set();
+	});
+
+	os::error        ec     = os::waitable::wait(owner.get(), long_wait);
+	steady::duration waited = steady::now() - begin;
+	setter.join();
+	check(ec == os::error::Success, "Waiting for the other thread returned error " + std::to_string(int(ec)) + ".");
+	check(waited >= short_wait, "The wait ended before the event was set.");
+}
+
+#ifndef _WIN32
+// A named auto-reset event set from another process: sets that pile up wake a single wait, and sets that race the
+//  waits of this process are never swallowed by them.
+void behaviour::event_cross_process() {
+	static const uint64_t rounds = 20000;
+
+	std::string name = "datalane-behaviour-xevent-"
+					   + std::to_string(steady::now().time_since_epoch().count() % 1000000000);
+	auto event = os::event::construct(os::create_only, name);
+	auto ready = os::event::construct(os::create_only, name + "-ready");
+	auto go    = os::event::construct(os::create_only, name + "-go");
+
+	// Round the child announced last, shared with it.
+	void *memory = mmap(nullptr, sizeof(std::atomic<uint64_t>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+						-1, 0);
+	check(memory != MAP_FAILED, "Mapping shared memory failed.");
+	std::atomic<uint64_t> *announced = new (memory) std::atomic<uint64_t>(0);
+
+	pid_t child = fork();
+	if (child == 0) {
+		int code = 0;
+		try {
+			auto remote       = os::event::construct(os::open_only, name);
+			auto remote_ready = os::event::construct(os::open_only, name + "-ready");
+			auto remote_go    = os::event::construct(os::open_only, name + "-go");
+
+			// Sets that nobody waited for in between.
+			remote->set();
+			remote->set();
+			remote->set();
+			remote_ready->set();
+			if (os::waitable::wait(remote_go.get(), long_wait) != os::error::Success) {
+				_exit(1);
+			}
+
+			// Sets racing the waits of the parent, spaced out by up to 20us.
+			std::mt19937 random(42);
+			for (uint64_t round = 1; round <= rounds; round++) {
+				announced->store(round);
+				remote->set();
+				steady::time_point until = steady::now() + std::chrono::nanoseconds(random() % 20000);
+				while (steady::now() < until) {
+				}
+			}
+		} catch (...) {
+			code = 1;
+		}
+		_exit(code);
+	}
+	check(child > 0, "Starting the child process failed.");
+
+	check_wait(ready.get(), long_wait, os::error::Success, "Waiting for the child");
+	check_wait(event.get(), long_wait, os::error::Success, "Waiting for the piled up sets");
+	check_wait(event.get(), short_wait, os::error::TimedOut, "Waiting once more after piled up sets");
+	go->set();
+
+	// Every round is followed by a wakeup that sees it, so waiting never runs into the timeout.
+	uint64_t  seen = 0;
+	os::error ec   = os::error::Success;
+	while (seen < rounds) {
+		ec = os::waitable::wait(event.get(), long_wait);
+		if (ec != os::error::Success) {
+			break;
+		}
+		seen = announced->load();
+	}
+
+	int status = 0;
+	waitpid(child, &status, 0);
+	munmap(memory, sizeof(std::atomic<uint64_t>));
+	check(WIFEXITED(status) && (WEXITSTATUS(status) == 0), "The child process failed.");
+	check(ec == os::error::Success, "Round " + std::to_string(seen + 1) + " of the child was never seen.");
+
+	// A set() that raced the last wait may leave the event signalled once more, but never more than once.
+	size_t left = 0;
+	while (os::waitable::wait(event.get(), std::chrono::milliseconds(0)) == os::error::Success) {
+		left++;
+	}
+	check(left <= 1, "Sets piled up " + std::to_string(left) + " wakeups.");
+}
+#endif
+
+// A one-shot timer is signalled once after its delay and then stays quiet.
+void behaviour::timer_once() {
+	auto timer = os::timer::construct();
+	check(timer->start(short_wait * 2) == os::error::Success, "Starting the timer failed.");
+
+	steady::time_point begin = steady::now();
+	check_wait(timer.get(), std::chrono::milliseconds(1), os::error::TimedOut, "Waiting before the delay");
+	check_wait(timer.get(), long_wait, os::error::Success, "Waiting for the delay");
+	check(steady::now() - begin >= short_wait, "The timer fired before its delay.");
+	check(timer->get_expirations() == 1, "A one-shot timer expired more than once.");
+	check_wait(timer.get(), short_wait, os::error::TimedOut, "Waiting after the timer fired");
+}
+
+// A periodic timer folds the periods a slow waiter missed into one signal, and stop() ends it.
+void behaviour::timer_periodic() {
+	auto timer = os::timer::construct();
+	check(timer->start(std::chrono::milliseconds(1), std::chrono::milliseconds(1)) == os::error::Success,
+		  "Starting the timer failed.");
+
+	std::this_thread::sleep_for(short_wait);
+	check_wait(timer.get(), long_wait, os::error::Success, "Waiting for a missed period");
+#ifndef _WIN32
+	// Windows does not tell how many periods passed.
+	check(timer->get_expirations() > 1, "Missed periods were not counted.");
+#endif
+	check_wait(timer.get(), long_wait, os::error::Success, "Waiting for the next period");
+
+	check(timer->stop() == os::error::Success, "Stopping the timer failed.");
+	// A period may have passed right before stop(), Windows keeps that signal.
+	os::waitable::wait(timer.get(), std::chrono::milliseconds(0));
+	check_wait(timer.get(), short_wait, os::error::TimedOut, "Waiting on a stopped timer");
+}
@@ -0,0 +1,104 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include "behaviour.hpp"
+
+static const struct {
+	const char *name;
+	void (*run)();
+} cases[] = {
+	{"wait-many-fairness", &behaviour::wait_many_fairness},
+	{"wait-set-fairness", &behaviour::wait_set_fairness},
+	{"timer-wheel-cascade", &behaviour::timer_wheel_cascade},
+	{"timer-wheel-jump", &behaviour::timer_wheel_jump},
+	{"timer-wheel-wait", &behaviour::timer_wheel_wait},
+	{"event-auto-reset", &behaviour::event_auto_reset},
+	{"event-manual-reset", &behaviour::event_manual_reset},
+	{"event-wakeup", &behaviour::event_wakeup},
+#ifndef _WIN32
+	{"event-cross-process", &behaviour::event_cross_process},
+#endif
+	{"timer-once", &behaviour::timer_once},
+	{"timer-periodic", &behaviour::timer_periodic},
+	{"condition-timeout", &behaviour::condition_timeout},
+	{"condition-notify-one", &behaviour::condition_notify_one},
+	{"condition-notify-all", &behaviour::condition_notify_all},
+	{"condition-timeout-then-notify", &behaviour::condition_timeout_then_notify},
+	{"condition-watch", &behaviour::condition_watch},
+#ifndef _WIN32
+	{"condition-owner-death", &behaviour::condition_owner_death},
+#endif
+	{"doorbell-coalescing", &behaviour::doorbell_coalescing},
+	{"doorbell-race", &behaviour::doorbell_race},
+#ifndef _WIN32
+	{"pipe-cancel-read", &behaviour::pipe_cancel_read},
+	{"pipe-try-read", &behaviour::pipe_try_read},
+	{"pipe-write-backlog", &behaviour::pipe_write_backlog},
+	{"pipe-backlog-on-read", &behaviour::pipe_backlog_on_read},
+	{"pipe-wait-set-cancel", &behaviour::pipe_wait_set_cancel},
+	{"pipe-hangup-pending", &behaviour::pipe_hangup_pending},
+	{"pipe-readable-wait", &behaviour::pipe_readable_wait},
+#endif
+};
+
+static void usage(const char *program) {
+	fprintf(stderr, "Usage: %s [case...]\n  Runs the named cases, or all of them. Cases:\n", program);
+	for (auto &entry : cases) {
+		fprintf(stderr, "    %s\n", entry.name);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	int code = 0;
+	for (auto &entry : cases) {
+		bool selected = (argc < 2);
+		for (int idx = 1; idx < argc; idx++) {
+			if ((strcmp(argv[idx], "--help") == 0) || (strcmp(argv[idx], "-h") == 0)) {
+				usage(argv[0]);
+				return 0;
+			}
+			selected = selected || (strcmp(argv[idx], entry.name) == 0);
+		}
+		if (!selected) {
+			continue;
+		}
+
+		try {
+			entry.run();
+			printf("%-32s ok\n", entry.name);
+		} catch (std::exception &e) {
+			printf("%-32s FAILED: %s\n", entry.name, e.what());
+			code = 1;
+		}
+	}
+
+	for (int idx = 1; idx < argc; idx++) {
+		bool known = false;
+		for (auto &entry : cases) {
+			known = known || (strcmp(argv[idx], entry.name) == 0);
+		}
+		if (!known) {
+			fprintf(stderr, "Unknown case '%s'.\n", argv[idx]);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	return code;
+}
@@ -0,0 +1,420 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+// Pipes are tested on POSIX only, the Windows tests under tests/windows cover the other side.
+#ifndef _WIN32
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "behaviour.hpp"
+#include "../../source/os/wait-set.hpp"
+#include "../../source/os/posix/named-pipe.hpp"
+
+typedef std::chrono::steady_clock steady;
+
+static const std::chrono::seconds timeout(5);
+
+static std::string make_pipe_name(const char *what) {
+	return std::string("datalane-behaviour-") + what + "-"
+		   + std::to_string(steady::now().time_since_epoch().count() % 1000000000);
+}
+
+// A server end with one connected client.
+struct pipe_pair {
+	std::unique_ptr<os::posix::named_pipe> server;
+	std::unique_ptr<os::posix::named_pipe> client;
+
+	pipe_pair(const char *what) {
+		std::string name = make_pipe_name(what);
+		server           = std::make_unique<os::posix::named_pipe>(os::create_only, name, 1);
+		client           = std::make_unique<os::posix::named_pipe>(os::open_only, name);
+
+		std::shared_ptr<os::async_op> accept_op;
+		os::error                     ec = server->accept(accept_op, nullptr);
+		if (ec == os::error::Pending) {
+			ec = accept_op->wait(timeout);
+		}
+		behaviour::check((ec == os::error::Success) || (ec == os::error::Connected),
+						 "Accepting returned error " + std::to_string(int(ec)) + ".");
+	}
+};
+
+// Joins a helper thread when a check throws, so that the failure is reported instead of terminating.
+struct thread_joiner {
+	std::thread &thread;
+
+	thread_joiner(std::thread &thread) : thread(thread) {}
+	~thread_joiner() {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+};
+
+// Message 'index' of 'size' bytes, every byte depends on both.
+static std::vector<char> make_message(size_t index, size_t size) {
+	std::vector<char> message(size);
+	for (size_t pos = 0; pos < size; pos++) {
+		message[pos] = char((pos * 31 + index * 7) & 0xFF);
+	}
+	return message;
+}
+
+// Writes 'message' and waits for it, on a thread of its own so that large messages can block.
+static std::thread write_async(os::posix::named_pipe &pipe, const std::vector<char> &message, os::error &result) {
+	return std::thread([&pipe, &message, &result]() {
+		std::shared_ptr<os::async_op> write_op;
+		result = pipe.write(message.data(), message.size(), write_op, nullptr);
+		if (result == os::error::Success) {
+			result = write_op->wait(timeout);
+		}
+	});
+}
+
+// Reads one message with a blocking wait, returns its length.
+static size_t read_one(os::posix::named_pipe &pipe, std::vector<char> &buffer) {
+	std::shared_ptr<os::async_op> read_op;
+	size_t                        length = 0;
+	os::error                     result = os::error::Unknown;
+	os::error ec = pipe.read(buffer.data(), buffer.size(), read_op, [&length, &result](os::error ec, size_t len) {
+		result = ec;
+		length = len;
+	});
+	if (ec == os::error::Success) {
+		ec = read_op->wait(timeout);
+	}
+	behaviour::check(ec == os::error::Success, "Reading returned error " + std::to_string(int(ec)) + ".");
+	behaviour::check(result == os::error::Success,
+					 "The read completed with error " + std::to_string(int(result)) + ".");
+	return length;
+}
+
+// A read that took part of a message refuses to be cancelled and finishes it, so the next message arrives intact.
+//  One that took nothing yet is cancelled and leaves the message to the next read.
+void behaviour::pipe_cancel_read() {
+	pipe_pair pair("cancel");
+
+	// Cancelled before anything arrived.
+	std::vector<char>             buffer(16 * 1024 * 1024);
+	std::shared_ptr<os::async_op> read_op;
+	check(pair.server->read(buffer.data(), buffer.size(), read_op, nullptr) == os::error::Success, "Reading failed.");
+	check(!read_op->is_complete(), "Reading from an empty pipe completed.");
+	check(read_op->cancel(), "A read that took nothing refused to be cancelled.");
+
+	// Larger than the socket buffers: issuing the write sends what fits, and the read takes only that.
+	std::vector<char>             large = make_message(1, buffer.size());
+	std::vector<char>             small = make_message(2, 1000);
+	std::shared_ptr<os::async_op> write_op;
+	check(pair.client->write(large.data(), large.size(), write_op, nullptr) == os::error::Success, "Writing failed.");
+	check(pair.server->read(buffer.data(), buffer.size(), read_op, nullptr) == os::error::Success, "Reading failed.");
+	check(!read_op->is_complete() && (read_op->get_bytes_transferred() > 0),
+		  "The read did not take part of the large message.");
+	check(!read_op->cancel(), "A read that took part of a message was cancelled.");
+
+	os::error   large_result = os::error::Unknown;
+	os::error   small_result = os::error::Unknown;
+	std::thread writer([&]() {
+		large_result = write_op->wait(timeout);
+		write_async(*pair.client, small, small_result).join();
+	});
+	thread_joiner joiner(writer);
+
+	os::error ec = read_op->wait(timeout);
+	check(ec == os::error::Success, "Finishing the large message returned error " + std::to_string(int(ec)) + ".");
+	check(read_op->get_bytes_transferred() == large.size(), "The large message arrived incomplete.");
+	check(memcmp(buffer.data(), large.data(), large.size()) == 0, "The large message arrived damaged.");
+
+	size_t length = read_one(*pair.server, buffer);
+	check((length == small.size()) && (memcmp(buffer.data(), small.data(), small.size()) == 0),
+		  "The message after the large one arrived damaged.");
+	writer.join();
+	check((large_result == os::error::Success) && (small_result == os::error::Success), "Writing failed.");
+}
+// try_read() never waits: nothing is there, or only part of a message, is os::error::WouldBlock.
+void behaviour::pipe_try_read() {
+	pipe_pair pair("try-read");
+
+	std::vector<char> buffer(16 * 1024 * 1024);
+	size_t            length = 0;
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::WouldBlock,
+		  "Reading from an empty pipe did not refuse.");
+
+	std::vector<char> small = make_message(1, 1000);
+	check(pair.client->try_write(small.data(), small.size()) == os::error::Success, "Writing failed.");
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::Success, "Reading failed.");
+	check((length == small.size()) && (memcmp(buffer.data(), small.data(), small.size()) == 0),
+		  "The message arrived damaged.");
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::WouldBlock,
+		  "Reading the same message twice did not refuse.");
+
+	// Larger than the socket buffers, so only part of it can be there while the writer blocks.
+	std::vector<char> large        = make_message(2, buffer.size());
+	os::error         large_result = os::error::Unknown;
+	std::thread       writer       = write_async(*pair.client, large, large_result);
+	thread_joiner     joiner(writer);
+
+	size_t pending = 0;
+	for (auto deadline = steady::now() + timeout; (pending == 0) && (steady::now() < deadline);) {
+		check(pair.server->available(pending) == os::error::Success, "Asking for the available data failed.");
+	}
+	check(pending > 0, "Nothing of the large message arrived.");
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::WouldBlock,
+		  "Reading part of a message did not refuse.");
+
+	length = read_one(*pair.server, buffer);
+	check((length == large.size()) && (memcmp(buffer.data(), large.data(), large.size()) == 0),
+		  "The large message arrived damaged.");
+	writer.join();
+	check(large_result == os::error::Success, "Writing the large message failed.");
+}
+
+// Filling the backlog past the high watermark refuses further messages and reports it once, draining it to the low
+//  watermark signals get_writable() and reports it once more. Every message arrives intact and in order.
+void behaviour::pipe_write_backlog() {
+	pipe_pair pair("write-backlog");
+
+	static const size_t message_size = 64 * 1024;
+	static const size_t low          = 256 * 1024;
+	static const size_t high         = 1024 * 1024;
+	std::vector<bool>   reported;
+	pair.client->set_write_watermarks(low, high);
+	pair.client->set_writable_callback([&reported](bool writable) { reported.push_back(writable); });
+
+	size_t written = 0;
+	for (; written < 1000; written++) {
+		std::vector<char> message = make_message(written, message_size);
+		os::error         ec      = pair.client->try_write(message.data(), message.size());
+		if (ec == os::error::WouldBlock) {
+			break;
+		}
+		check(ec == os::error::Success, "Writing returned error " + std::to_string(int(ec)) + ".");
+	}
+	check((written < 1000) && (pair.client->get_backlog() > high), "The backlog never rose above the watermark.");
+	check((reported.size() == 1) && !reported[0], "Rising above the watermark was not reported once.");
+	check(pair.client->get_writable()->wait(std::chrono::milliseconds(0)) == os::error::TimedOut,
+		  "The pipe was writable above the watermark.");
+
+	// Nothing but try_read() on one end and get_writable() on the other.
+	std::vector<char> buffer(message_size);
+	size_t            received   = 0;
+	bool              signalled  = false;
+	auto              deadline   = steady::now() + timeout;
+	while ((received < written) && (steady::now() < deadline)) {
+		size_t length = 0;
+		while (pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::Success) {
+			std::vector<char> expected = make_message(received, message_size);
+			check((length == message_size) && (memcmp(buffer.data(), expected.data(), message_size) == 0),
+				  "Message " + std::to_string(received) + " arrived damaged or out of order.");
+			received++;
+		}
+
+		if (pair.client->get_writable()->wait(std::chrono::milliseconds(1)) == os::error::Success) {
+			check(!signalled, "The pipe became writable twice.");
+			check(pair.client->get_backlog() <= low, "The pipe became writable above the low watermark.");
+			check((reported.size() == 2) && reported[1], "Falling back to the watermark was not reported once.");
+			signalled = true;
+		}
+	}
+	check(received == written, "Only " + std::to_string(received) + " of " + std::to_string(written)
+									   + " messages arrived.");
+	check(signalled, "The pipe never became writable again.");
+	check(pair.client->get_backlog() == 0, "The backlog was not sent completely.");
+	check(reported.size() == 2, "The writable state was reported more than twice.");
+}
+
+// A caller that leaves messages in the backlog and then only waits for the answer still sends them, whether it waits
+//  on get_readable() or on a read. The remote end answers only once it has every message.
+void behaviour::pipe_backlog_on_read() {
+	pipe_pair pair("backlog-on-read");
+
+	static const size_t message_size = 64 * 1024;
+	// More than the socket buffers take, whatever the buffer tuner made of them.
+	static const size_t messages     = 256;
+	pair.client->set_write_watermarks(0, messages * (message_size + 64));
+
+	// The remote end starts reading only once a round was written, so that the backlog can't drain before.
+	std::atomic<size_t> rounds_written{0};
+	os::error           server_result = os::error::Success;
+	std::thread         server([&]() {
+		std::vector<char> buffer(message_size);
+		for (size_t round = 0; (round < 2) && (server_result == os::error::Success); round++) {
+			for (auto deadline = steady::now() + timeout; (rounds_written <= round) && (steady::now() < deadline);) {
+				std::this_thread::yield();
+			}
+			for (size_t idx = 0; idx < messages; idx++) {
+				std::shared_ptr<os::async_op> read_op;
+				os::error ec = pair.server->read(buffer.data(), buffer.size(), read_op, nullptr);
+				if (ec == os::error::Success) {
+					ec = read_op->wait(timeout);
+				}
+				std::vector<char> expected = make_message(round * messages + idx, message_size);
+				if ((ec != os::error::Success) || (read_op->get_bytes_transferred() != message_size)
+					|| (memcmp(buffer.data(), expected.data(), message_size) != 0)) {
+					server_result = (ec != os::error::Success) ? ec : os::error::Error;
+					return;
+				}
+			}
+			static const char answer[] = "done";
+			os::error         result   = os::error::Unknown;
+			std::vector<char> message(answer, answer + sizeof(answer));
+			write_async(*pair.server, message, result).join();
+			server_result = result;
+		}
+	});
+	thread_joiner joiner(server);
+
+	std::vector<char> buffer(message_size);
+	for (size_t round = 0; round < 2; round++) {
+		for (size_t idx = 0; idx < messages; idx++) {
+			std::vector<char> message = make_message(round * messages + idx, message_size);
+			check(pair.client->try_write(message.data(), message.size()) == os::error::Success, "Writing failed.");
+		}
+		check(pair.client->get_backlog() > 0, "Nothing was left in the backlog.");
+		rounds_written++;
+
+		if (round == 0) {
+			os::error ec = pair.client->get_readable()->wait(timeout);
+			check(ec == os::error::Success, "Waiting for the answer returned error " + std::to_string(int(ec)) + ".");
+		}
+		size_t length = read_one(*pair.client, buffer);
+		check((length == 5) && (memcmp(buffer.data(), "done", 5) == 0), "The answer arrived damaged.");
+		check(pair.client->get_backlog() == 0, "The backlog was not sent completely.");
+	}
+	server.join();
+	check(server_result == os::error::Success,
+		  "The remote end failed with error " + std::to_string(int(server_result)) + ".");
+}
+// A request completed on another thread wakes a wait set up that blocks on it, instead of waiting for the pipe.
+void behaviour::pipe_wait_set_cancel() {
+	pipe_pair pair("wait-set-cancel");
+
+	std::vector<char>             buffer(1000);
+	std::shared_ptr<os::async_op> read_op;
+	check(pair.server->read(buffer.data(), buffer.size(), read_op, nullptr) == os::error::Success, "Reading failed.");
+	os::wait_set set;
+	check(set.add(read_op.get()), "Adding the read failed.");
+
+	bool        cancelled = false;
+	std::thread canceller([&]() {
+		// Long enough for the wait to block.
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		cancelled = read_op->cancel();
+	});
+	thread_joiner joiner(canceller);
+
+	std::vector<os::waitable *> ready;
+	auto                        begin = steady::now();
+	os::error                   ec    = set.wait(ready, timeout);
+	auto                        took  = steady::now() - begin;
+	canceller.join();
+	check(cancelled, "The read refused to be cancelled.");
+	check(ec == os::error::Success, "Waiting returned error " + std::to_string(int(ec)) + ".");
+	check((ready.size() == 1) && (ready[0] == read_op.get()), "The cancelled read was not reported.");
+	check(took < std::chrono::seconds(1), "The wait only noticed the cancelled read late.");
+	set.remove(read_op.get());
+}
+// The remote end leaving with messages still on their way: they are read first, then the pipe disconnects and
+//  reports it exactly once.
+void behaviour::pipe_hangup_pending() {
+	pipe_pair pair("hangup-pending");
+
+	std::atomic<int> disconnects{0};
+	pair.server->set_disconnect_callback([&disconnects]() { disconnects++; });
+
+	static const size_t messages = 3;
+	for (size_t idx = 0; idx < messages; idx++) {
+		std::vector<char> message = make_message(idx, 1000);
+		check(pair.client->try_write(message.data(), message.size()) == os::error::Success, "Writing failed.");
+	}
+	pair.client.reset();
+
+	// Long enough for the hang-up to be noticed, which has to wait for the messages.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	check(pair.server->is_connected(), "The pipe disconnected with messages left to read.");
+	check(disconnects == 0, "The disconnect was reported with messages left to read.");
+
+	std::vector<char> buffer(1000);
+	for (size_t idx = 0; idx < messages; idx++) {
+		size_t            length   = read_one(*pair.server, buffer);
+		std::vector<char> expected = make_message(idx, 1000);
+		check((length == expected.size()) && (memcmp(buffer.data(), expected.data(), length) == 0),
+			  "Message " + std::to_string(idx) + " arrived damaged.");
+	}
+
+	// The last read took the last byte, which disconnects.
+	for (auto deadline = steady::now() + timeout; (disconnects == 0) && (steady::now() < deadline);) {
+		std::this_thread::yield();
+	}
+	check(!pair.server->is_connected(), "The pipe is still connected after the last message.");
+	check(disconnects == 1, "The disconnect was reported " + std::to_string(disconnects) + " times.");
+
+	std::shared_ptr<os::async_op> read_op;
+	check(pair.server->read(buffer.data(), buffer.size(), read_op, nullptr) == os::error::Disconnected,
+		  "Reading after the disconnect did not fail.");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	check(disconnects == 1, "The disconnect was reported again.");
+}
+// get_readable() in wait_any() and in a wait set: quiet on an empty pipe, signalled once a message arrived, and
+//  quiet again until the message was read.
+void behaviour::pipe_readable_wait() {
+	pipe_pair pair("readable-wait");
+
+	static const std::chrono::milliseconds quiet(50);
+	os::waitable *                         readable = pair.server->get_readable();
+	std::vector<char>                      buffer(1000);
+	size_t                                 length = 0;
+	size_t                                 index  = 0;
+	check(os::waitable::wait_any(&readable, 1, index, quiet) == os::error::TimedOut,
+		  "An empty pipe was readable in wait_any().");
+
+	std::vector<char> first = make_message(1, 1000);
+	check(pair.client->try_write(first.data(), first.size()) == os::error::Success, "Writing failed.");
+	check((os::waitable::wait_any(&readable, 1, index, timeout) == os::error::Success) && (index == 0),
+		  "The message did not make the pipe readable in wait_any().");
+	check(os::waitable::wait_any(&readable, 1, index, quiet) == os::error::TimedOut,
+		  "The same message made the pipe readable twice.");
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::Success, "Reading failed.");
+	check((length == first.size()) && (memcmp(buffer.data(), first.data(), length) == 0),
+		  "The first message arrived damaged.");
+
+	os::wait_set                set;
+	std::vector<os::waitable *> ready;
+	check(set.add(readable), "Adding the readiness to the set failed.");
+	check(set.wait(ready, quiet) == os::error::TimedOut, "An empty pipe was readable in a wait set.");
+
+	// Sent while the set blocks.
+	std::vector<char> second = make_message(2, 1000);
+	os::error         result = os::error::Unknown;
+	std::thread       writer([&]() {
+		std::this_thread::sleep_for(quiet);
+		write_async(*pair.client, second, result).join();
+	});
+	thread_joiner joiner(writer);
+	os::error     ec = set.wait(ready, timeout);
+	writer.join();
+	check(ec == os::error::Success, "Waiting on the set returned error " + std::to_string(int(ec)) + ".");
+	check((ready.size() == 1) && (ready[0] == readable), "The message did not make the pipe readable in the set.");
+	check(pair.server->try_read(buffer.data(), buffer.size(), length) == os::error::Success, "Reading failed.");
+	check((length == second.size()) && (memcmp(buffer.data(), second.data(), length) == 0),
+		  "The second message arrived damaged.");
+	check(set.wait(ready, quiet) == os::error::TimedOut, "The pipe stayed readable after the message was read.");
+	set.remove(readable);
+	check(result == os::error::Success, "Writing the second message failed.");
+}
+#endif
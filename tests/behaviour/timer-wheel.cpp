@@ -0,0 +1,105 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include <vector>
+#include "behaviour.hpp"
+#include "../../source/os/timer-wheel.hpp"
+
+typedef os::timer_wheel::clock wheel_clock;
+
+struct fired {
+	std::vector<size_t> *order;
+	size_t               index;
+};
+
+static void record(void *data) {
+	fired *f = static_cast<fired *>(data);
+	f->order->push_back(f->index);
+}
+
+// One entry on each of the first four levels, with one tick per microsecond a level spans 64 times the one below.
+static const std::chrono::microseconds distances[] = {
+	std::chrono::microseconds(50),
+	std::chrono::microseconds(5000),
+	std::chrono::microseconds(300000),
+	std::chrono::microseconds(20000000),
+};
+static const size_t levels = sizeof(distances) / sizeof(distances[0]);
+
+// Walk the clock up to just before and then just past every deadline. Entries have to move down through the
+//  levels on the way and still fire exactly at their deadline, never early and in order.
+void behaviour::timer_wheel_cascade() {
+	os::timer_wheel                     wheel(std::chrono::microseconds(1));
+	wheel_clock::time_point             base = wheel_clock::now();
+	std::vector<size_t>                 order;
+	std::vector<fired>                  data(levels);
+	std::vector<os::timer_wheel::entry> entries(levels);
+	for (size_t idx = 0; idx < levels; idx++) {
+		data[idx] = {&order, idx};
+		entries[idx].set_callback(&record, &data[idx]);
+		wheel.schedule(entries[idx], base + distances[idx]);
+	}
+	check(wheel.size() == levels, "Not every entry was scheduled.");
+
+	for (size_t idx = 0; idx < levels; idx++) {
+		wheel.expire(base + distances[idx] - std::chrono::microseconds(1));
+		check(order.size() == idx, "Entry " + std::to_string(idx) + " or a later one fired early.");
+		wheel.expire(base + distances[idx] + std::chrono::microseconds(1));
+		check(order.size() == idx + 1, "Entry " + std::to_string(idx) + " did not fire at its deadline.");
+		check(order[idx] == idx, "Entries fired out of order.");
+	}
+	check(wheel.size() == 0, "Entries are left after all fired.");
+	check(wheel.get_next_deadline() == wheel_clock::time_point::max(), "The wheel still has a deadline.");
+}
+
+// Jump past every deadline at once, so that entries drop more than one level in a single step.
+void behaviour::timer_wheel_jump() {
+	os::timer_wheel                     wheel(std::chrono::microseconds(1));
+	wheel_clock::time_point             base = wheel_clock::now();
+	std::vector<size_t>                 order;
+	std::vector<fired>                  data(levels);
+	std::vector<os::timer_wheel::entry> entries(levels);
+	for (size_t idx = 0; idx < levels; idx++) {
+		data[idx] = {&order, idx};
+		entries[idx].set_callback(&record, &data[idx]);
+		wheel.schedule(entries[idx], base + distances[idx]);
+	}
+
+	size_t expired = wheel.expire(base + distances[levels - 1] + std::chrono::microseconds(1));
+	check(expired == levels, "Only " + std::to_string(expired) + " entries expired.");
+	check(order.size() == levels, "Not every callback was called.");
+	check(wheel.size() == 0, "Entries are left after all fired.");
+}
+
+// Wait on the wheel itself: it wakes up where an entry moves down a level, and again at the deadline.
+void behaviour::timer_wheel_wait() {
+	os::timer_wheel        wheel(std::chrono::microseconds(1));
+	std::vector<size_t>    order;
+	fired                  data = {&order, 0};
+	os::timer_wheel::entry entry(&record, &data);
+
+	wheel_clock::time_point begin    = wheel_clock::now();
+	wheel_clock::time_point deadline = begin + std::chrono::milliseconds(2);
+	wheel.schedule(entry, deadline);
+	while (order.empty()) {
+		os::error ec = os::waitable::wait(&wheel, std::chrono::seconds(1));
+		check((ec == os::error::Success) || (ec == os::error::TimedOut),
+			  "Waiting on the wheel failed with error " + std::to_string(int(ec)) + ".");
+		check(wheel_clock::now() - begin < std::chrono::seconds(1), "The entry did not fire.");
+		wheel.expire();
+	}
+	check(wheel_clock::now() >= deadline, "The entry fired before its deadline.");
+}
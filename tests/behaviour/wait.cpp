@@ -0,0 +1,61 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <vector>
+#include "behaviour.hpp"
+#include "../../source/os/event.hpp"
+#include "../../source/os/wait-set.hpp"
+
+// Two items that stay signalled, with room for one per wait. Both have to take turns.
+static const size_t rounds = 100;
+
+void behaviour::wait_many_fairness() {
+	auto          first  = os::event::construct(true, true);
+	auto          second = os::event::construct(true, true);
+	os::waitable *items[] = {first.get(), second.get()};
+
+	size_t cursor    = 0;
+	size_t picked[2] = {0, 0};
+	for (size_t round = 0; round < rounds; round++) {
+		size_t    signalled = 0;
+		size_t    count     = 0;
+		os::error ec        = os::waitable::wait_many(items, 2, &signalled, 1, count, cursor, std::chrono::seconds(1));
+		check(ec == os::error::Success, "wait_many failed with error " + std::to_string(int(ec)) + ".");
+		check(count == 1, "wait_many consumed more than 'max' items.");
+		picked[signalled]++;
+	}
+	check((picked[0] == rounds / 2) && (picked[1] == rounds / 2),
+		  "Items were picked " + std::to_string(picked[0]) + " and " + std::to_string(picked[1]) + " times.");
+}
+
+void behaviour::wait_set_fairness() {
+	auto     first  = os::event::construct(true, true);
+	auto     second = os::event::construct(true, true);
+	os::wait_set set;
+	check(set.add(first.get()) && set.add(second.get()), "Adding to the set failed.");
+
+	size_t                  picked[2] = {0, 0};
+	std::vector<os::waitable *> ready;
+	for (size_t round = 0; round < rounds; round++) {
+		os::error ec = set.wait(ready, 1, std::chrono::seconds(1));
+		check(ec == os::error::Success, "wait_set::wait failed with error " + std::to_string(int(ec)) + ".");
+		check(ready.size() == 1, "wait_set::wait consumed more than 'max' members.");
+		picked[(ready[0] == first.get()) ? 0 : 1]++;
+	}
+	check((picked[0] == rounds / 2) && (picked[1] == rounds / 2),
+		  "Members were picked " + std::to_string(picked[0]) + " and " + std::to_string(picked[1]) + " times.");
+}
@@ -0,0 +1,121 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef DATALANE_BENCH_HPP
+#define DATALANE_BENCH_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include "../common.hpp"
+#include "perf-counters.hpp"
+
+#ifdef _WIN32
+#include "../../source/os/windows/named-pipe.hpp"
+#else
+#include "../../source/os/posix/named-pipe.hpp"
+#endif
+
+namespace bench {
+#ifdef _WIN32
+	typedef os::windows::named_pipe pipe_t;
+#else
+	typedef os::posix::named_pipe pipe_t;
+#endif
+
+	struct config {
+		// Upper and lower limit for messages per size, the actual count is derived from 'bytes'.
+		size_t messages     = 10000;
+		size_t min_messages = 16;
+		size_t bytes        = 64 * 1024 * 1024;
+
+		// Messages per connection that are sent before measuring starts.
+		size_t warmup = 100;
+
+		// Connections for fan-in, fan-out and open-loop.
+		size_t clients = 4;
+
+		// Open-loop: messages per second over all connections. At 0 the rate is 'load' times the throughput of
+		//  an unpaced run with the same connections and size.
+		double rate = 0;
+		double load = 0.8;
+
+		enum class arrival_t {
+			Constant,
+			Poisson,
+		} arrival = arrival_t::Poisson;
+
+		// c10k: connections and the threads that serve them on each side. At a rate of 0 every connection sends
+		//  one message per second.
+		size_t connections = 10000;
+		size_t threads     = 4;
+
+		std::chrono::nanoseconds timeout = std::chrono::seconds(10);
+	};
+
+	struct result {
+		std::string scenario;
+		size_t      size     = 0;
+		size_t      clients  = 0;
+		size_t      messages = 0;
+
+		std::chrono::nanoseconds    duration = std::chrono::nanoseconds(0);
+		shared::time::measure_timer latency;
+
+		// Open-loop only: the rate messages were scheduled at, and the latency measured from the time a message
+		//  was actually sent instead of when it should have been, which hides queueing delay.
+		double                      rate = 0;
+		shared::time::measure_timer uncorrected;
+
+		// c10k only: connections accepted per second and resident memory per connection (both ends), right after
+		//  connecting and once every connection carried traffic and went idle again.
+		double  accept_rate                = 0;
+		int64_t memory_per_connection      = 0;
+		int64_t idle_memory_per_connection = 0;
+
+		// Counters over the whole scenario including setup and warmup, if available.
+		bool                  has_counters = false;
+		perf_counters::values counters;
+	};
+
+	typedef void (*scenario_t)(const config &cfg, size_t size, result &res);
+
+	// Client sends, server echoes, latency is the round trip.
+	void ping_pong(const config &cfg, size_t size, result &res);
+
+	// One client streams to the server as fast as it can, latency is the one-way delay.
+	void throughput(const config &cfg, size_t size, result &res);
+
+	// Several clients stream to a single server thread.
+	void fan_in(const config &cfg, size_t size, result &res);
+
+	// A single server thread streams to several clients.
+	void fan_out(const config &cfg, size_t size, result &res);
+
+	// Clients send on a fixed schedule without waiting for the echo, latency is measured from the scheduled
+	//  send time so that it includes any delay behind the schedule (coordinated omission correction).
+	void open_loop(const config &cfg, size_t size, result &res);
+
+	// Thousands of connections served by a few threads on each side: accept rate, memory per connection and
+	//  latency at a steady aggregate rate, measured from the scheduled send time.
+	void c10k(const config &cfg, size_t size, result &res);
+
+	// Resident memory of this process in bytes, 0 if unknown.
+	size_t get_rss();
+} // namespace bench
+
+#endif // DATALANE_BENCH_HPP
@@ -0,0 +1,366 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "../../source/os/buffer-tuner.hpp"
+#include "../../source/os/trace.hpp"
+
+struct scenario_info {
+	const char *       name;
+	bench::scenario_t function;
+	// Part of 'all', scenarios that need a lot of resources only run when named.
+	bool               in_all;
+};
+
+static const scenario_info scenarios[] = {
+	{"ping-pong", &bench::ping_pong, true},
+	{"throughput", &bench::throughput, true},
+	{"fan-in", &bench::fan_in, true},
+	{"fan-out", &bench::fan_out, true},
+	{"open-loop", &bench::open_loop, true},
+	{"c10k", &bench::c10k, false},
+};
+
+static void usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  --scenario NAME     ping-pong, throughput, fan-in, fan-out, open-loop, c10k or all (default, all\n"
+			"                      but c10k), may be repeated\n"
+			"  --min-size BYTES    Smallest message size (default 8)\n"
+			"  --max-size BYTES    Largest message size (default 16M)\n"
+			"  --messages N        Maximum messages per size and connection (default 10000)\n"
+			"  --min-messages N    Minimum messages per size and connection (default 16)\n"
+			"  --bytes BYTES       Data per size and connection that decides the message count (default 64M)\n"
+			"  --warmup N          Unmeasured messages per connection, at most 10%% of all (default 100)\n"
+			"  --clients N         Connections for fan-in, fan-out and open-loop (default 4)\n"
+			"  --rate N            Open-loop messages per second over all connections (default: from --load)\n"
+			"  --load F            Open-loop rate as a fraction of the measured saturation rate (default 0.8)\n"
+			"  --arrival TYPE      Open-loop and c10k schedule, 'poisson' (default) or 'constant'\n"
+			"  --connections N     c10k connections (default 10000)\n"
+			"  --threads N         c10k threads per side (default 4)\n"
+			"  --timeout-ms N      Give up on a single operation after this long (default 10000)\n"
+			"  --output FILE       Write the JSON report to FILE instead of stdout\n"
+			"  --trace FILE        Write a Chrome trace of all I/O events to FILE (needs ENABLE_TRACING)\n"
+			"  --no-perf           Do not collect perf_event counters\n"
+			"  --buffer-tuning     Size kernel send buffers from observed traffic instead of using a fixed size\n",
+			program);
+}
+
+static size_t parse_size(const char *text) {
+	char *             end   = nullptr;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (end == text) {
+		throw std::invalid_argument(std::string("Invalid number '") + text + "'.");
+	}
+	switch (*end) {
+	case 'k':
+	case 'K':
+		value *= 1024;
+		break;
+	case 'm':
+	case 'M':
+		value *= 1024 * 1024;
+		break;
+	case 'g':
+	case 'G':
+		value *= 1024 * 1024 * 1024;
+		break;
+	}
+	return size_t(value);
+}
+
+static const char *platform_name() {
+#if defined(_WIN32)
+	return "windows";
+#elif defined(__APPLE__)
+	return "macos";
+#elif defined(__linux__)
+	return "linux";
+#else
+	return "unknown";
+#endif
+}
+
+static void write_report(FILE *file, const bench::config &cfg, std::vector<bench::result> &results) {
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"benchmark\": \"datalane-bench\",\n");
+	fprintf(file, "\t\"platform\": \"%s\",\n", platform_name());
+	fprintf(file,
+			"\t\"config\": {\"messages\": %zu, \"min_messages\": %zu, \"bytes\": %zu, \"warmup\": %zu, "
+			"\"clients\": %zu},\n",
+			cfg.messages, cfg.min_messages, cfg.bytes, cfg.warmup, cfg.clients);
+	fprintf(file, "\t\"results\": [");
+	for (size_t idx = 0; idx < results.size(); idx++) {
+		bench::result &res     = results[idx];
+		double         seconds = double(res.duration.count()) / 1e9;
+		double         rate    = seconds > 0 ? double(res.latency.count()) / seconds : 0;
+
+		fprintf(file, "%s\n\t\t{", idx > 0 ? "," : "");
+		fprintf(file, "\"scenario\": \"%s\", \"size\": %zu, \"clients\": %zu, \"messages\": %llu, ",
+				res.scenario.c_str(), res.size, res.clients, (unsigned long long)res.latency.count());
+		fprintf(file, "\"seconds\": %.6f, \"msgs_per_sec\": %.1f, \"bytes_per_sec\": %.1f, ", seconds, rate,
+				rate * double(res.size));
+		fprintf(file,
+				"\"latency_ns\": {\"min\": %lld, \"avg\": %.0f, \"p50\": %lld, \"p99\": %lld, \"p99.9\": %lld, "
+				"\"max\": %lld}",
+				(long long)res.latency.percentile(0.0).count(), res.latency.average(),
+				(long long)res.latency.percentile(0.5).count(), (long long)res.latency.percentile(0.99).count(),
+				(long long)res.latency.percentile(0.999).count(), (long long)res.latency.percentile(1.0).count());
+		if (res.accept_rate > 0) {
+			fprintf(file,
+					", \"accepts_per_sec\": %.1f, \"memory_per_connection\": %lld, \"idle_memory_per_connection\": %lld",
+					res.accept_rate, (long long)res.memory_per_connection, (long long)res.idle_memory_per_connection);
+		}
+		if (res.rate > 0) {
+			fprintf(file, ", \"target_rate\": %.1f", res.rate);
+		}
+		if (res.uncorrected.count() > 0) {
+			fprintf(file,
+					", \"uncorrected_latency_ns\": {\"p50\": %lld, \"p99\": %lld, \"p99.9\": %lld, \"max\": %lld}",
+					(long long)res.uncorrected.percentile(0.5).count(),
+					(long long)res.uncorrected.percentile(0.99).count(),
+					(long long)res.uncorrected.percentile(0.999).count(),
+					(long long)res.uncorrected.percentile(1.0).count());
+		}
+		if (res.has_counters && (res.messages > 0)) {
+			fprintf(file, ", \"per_message\": {");
+			bool first = true;
+			for (size_t idx = 0; idx < size_t(bench::perf_counters::counter::_Count); idx++) {
+				if (res.counters.value[idx] >= 0) {
+					fprintf(file, "%s\"%s\": %.2f", first ? "" : ", ",
+							bench::perf_counters::get_name(bench::perf_counters::counter(idx)),
+							double(res.counters.value[idx]) / double(res.messages));
+					first = false;
+				}
+			}
+			fprintf(file, "}");
+		}
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n\t]\n}\n");
+}
+
+int main(int argc, const char *argv[]) {
+	shared::logger::is_timestamp_relative_to_start(true);
+	shared::logger::to_stdout(false);
+	shared::logger::to_stderr(true);
+	shared::logger::to_debug(false);
+
+	bench::config                cfg;
+	size_t                       min_size = 8;
+	size_t                       max_size = 16 * 1024 * 1024;
+	std::string                  output;
+	std::string                  trace;
+	bool                         use_perf = true;
+	std::vector<const scenario_info *> selected;
+
+	try {
+		for (int idx = 1; idx < argc; idx++) {
+			std::string arg   = argv[idx];
+			const char *value = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+			if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else if (arg == "--no-perf") {
+				use_perf = false;
+				continue;
+			} else if (arg == "--buffer-tuning") {
+				os::buffer_tuner::limits limits = os::buffer_tuner::get_limits();
+				limits.enabled                  = true;
+				os::buffer_tuner::set_limits(limits);
+				continue;
+			} else if (!value) {
+				throw std::invalid_argument("Missing value for '" + arg + "'.");
+			}
+			idx++;
+
+			if (arg == "--scenario") {
+				bool found = false;
+				for (const scenario_info &info : scenarios) {
+					if (((strcmp(value, "all") == 0) && info.in_all) || (strcmp(value, info.name) == 0)) {
+						selected.push_back(&info);
+						found = true;
+					}
+				}
+				if (!found) {
+					throw std::invalid_argument(std::string("Unknown scenario '") + value + "'.");
+				}
+			} else if (arg == "--min-size") {
+				min_size = parse_size(value);
+			} else if (arg == "--max-size") {
+				max_size = parse_size(value);
+			} else if (arg == "--messages") {
+				cfg.messages = parse_size(value);
+			} else if (arg == "--min-messages") {
+				cfg.min_messages = parse_size(value);
+			} else if (arg == "--bytes") {
+				cfg.bytes = parse_size(value);
+			} else if (arg == "--warmup") {
+				cfg.warmup = parse_size(value);
+			} else if (arg == "--clients") {
+				cfg.clients = parse_size(value);
+			} else if (arg == "--connections") {
+				cfg.connections = parse_size(value);
+			} else if (arg == "--threads") {
+				cfg.threads = parse_size(value);
+			} else if (arg == "--rate") {
+				cfg.rate = double(parse_size(value));
+			} else if (arg == "--load") {
+				char *end = nullptr;
+				cfg.load  = strtod(value, &end);
+				if ((end == value) || (cfg.load <= 0)) {
+					throw std::invalid_argument(std::string("Invalid load '") + value + "'.");
+				}
+			} else if (arg == "--arrival") {
+				if (strcmp(value, "poisson") == 0) {
+					cfg.arrival = bench::config::arrival_t::Poisson;
+				} else if (strcmp(value, "constant") == 0) {
+					cfg.arrival = bench::config::arrival_t::Constant;
+				} else {
+					throw std::invalid_argument(std::string("Unknown arrival '") + value + "'.");
+				}
+			} else if (arg == "--timeout-ms") {
+				cfg.timeout = std::chrono::milliseconds(parse_size(value));
+			} else if (arg == "--output") {
+				output = value;
+			} else if (arg == "--trace") {
+				trace = value;
+			} else {
+				throw std::invalid_argument("Unknown option '" + arg + "'.");
+			}
+		}
+
+		if (min_size < 8) {
+			throw std::invalid_argument("Messages must be at least 8 bytes to carry a timestamp.");
+		} else if (max_size < min_size) {
+			throw std::invalid_argument("'--max-size' can't be smaller than '--min-size'.");
+		} else if ((cfg.clients == 0) || (cfg.clients > 63)) {
+			throw std::invalid_argument("'--clients' must be between 1 and 63.");
+		} else if ((cfg.messages == 0) || (cfg.min_messages > cfg.messages)) {
+			throw std::invalid_argument("'--min-messages' can't be larger than '--messages'.");
+		} else if ((trace.length() > 0) && !os::trace::is_enabled()) {
+			throw std::invalid_argument("'--trace' requires the library to be built with ENABLE_TRACING.");
+		}
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (selected.size() == 0) {
+		for (const scenario_info &info : scenarios) {
+			if (info.in_all) {
+				selected.push_back(&info);
+			}
+		}
+	}
+
+	std::unique_ptr<bench::perf_counters> perf;
+	if (use_perf) {
+		perf = std::make_unique<bench::perf_counters>();
+		if (!perf->is_available()) {
+			shared::logger::log("perf_event counters are not available, continuing without them.");
+			perf.reset();
+		} else if (perf->is_user_only()) {
+			shared::logger::log("perf_event only allows counting user space, cycles exclude syscalls.");
+		}
+	}
+
+	std::vector<bench::result> results;
+	int                        code = 0;
+	for (const scenario_info *info : selected) {
+		for (size_t size = min_size; size <= max_size; size *= 2) {
+			bench::result res;
+			try {
+				if (perf) {
+					perf->start();
+				}
+				info->function(cfg, size, res);
+				if (perf) {
+					res.counters     = perf->stop();
+					res.has_counters = true;
+				}
+			} catch (std::exception &e) {
+				if (perf) {
+					perf->stop();
+				}
+				shared::logger::log("%s, %zu bytes: %s", info->name, size, e.what());
+				code = 1;
+				continue;
+			}
+
+			shared::logger::log("%-10s %9zu bytes: %8llu msgs, p50 %10lld ns, p99 %10lld ns, p99.9 %10lld ns",
+								info->name, size, (unsigned long long)res.latency.count(),
+								(long long)res.latency.percentile(0.5).count(),
+								(long long)res.latency.percentile(0.99).count(),
+								(long long)res.latency.percentile(0.999).count());
+			if (res.accept_rate > 0) {
+				shared::logger::log("%-10s %9zu bytes: %zu connections, %.0f accepts/s, %lld bytes per connection, "
+									"%lld when idle",
+									info->name, size, res.clients, res.accept_rate,
+									(long long)res.memory_per_connection, (long long)res.idle_memory_per_connection);
+			}
+			if (res.uncorrected.count() > 0) {
+				shared::logger::log("%-10s %9zu bytes: target %.0f msgs/s, uncorrected p50 %10lld ns, p99 %10lld ns, "
+									"p99.9 %10lld ns",
+									info->name, size, res.rate, (long long)res.uncorrected.percentile(0.5).count(),
+									(long long)res.uncorrected.percentile(0.99).count(),
+									(long long)res.uncorrected.percentile(0.999).count());
+			}
+			if (res.has_counters && (res.messages > 0)) {
+				std::string line;
+				for (size_t idx = 0; idx < size_t(bench::perf_counters::counter::_Count); idx++) {
+					if (res.counters.value[idx] >= 0) {
+						char buf[64];
+						snprintf(buf, sizeof(buf), " %s %.1f",
+								 bench::perf_counters::get_name(bench::perf_counters::counter(idx)),
+								 double(res.counters.value[idx]) / double(res.messages));
+						line += buf;
+					}
+				}
+				shared::logger::log("%-10s %9zu bytes: per message%s", info->name, size, line.c_str());
+			}
+			results.push_back(std::move(res));
+		}
+	}
+
+	if ((trace.length() > 0) && !os::trace::write_chrome_trace(trace)) {
+		shared::logger::log("Failed to write trace to '%s'.", trace.c_str());
+		code = 1;
+	}
+
+	FILE *file = stdout;
+	if (output.length() > 0) {
+		file = fopen(output.c_str(), "w");
+		if (!file) {
+			shared::logger::log("Failed to open '%s' for writing.", output.c_str());
+			return 1;
+		}
+	}
+	write_report(file, cfg, results);
+	if (file != stdout) {
+		fclose(file);
+	}
+
+	return code;
+}
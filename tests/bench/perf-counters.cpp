@@ -0,0 +1,149 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "perf-counters.hpp"
+#include <string.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config, bool exclude_kernel) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size           = sizeof(attr);
+	attr.type           = type;
+	attr.config         = config;
+	attr.disabled       = 1;
+	attr.inherit        = 1;
+	attr.exclude_kernel = exclude_kernel ? 1 : 0;
+	attr.exclude_hv     = 1;
+	attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+bench::perf_counters::perf_counters() {
+	for (int &fd : fds) {
+		fd = -1;
+	}
+
+#ifdef __linux__
+	static const struct {
+		uint32_t type;
+		uint64_t config;
+	} events[] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+	};
+
+	for (size_t idx = 0; idx < size_t(counter::_Count); idx++) {
+		fds[idx] = open_counter(events[idx].type, events[idx].config, user_only);
+		if ((fds[idx] < 0) && !user_only) {
+			// Unprivileged users may only count user space with perf_event_paranoid >= 2.
+			fds[idx] = open_counter(events[idx].type, events[idx].config, true);
+			if ((fds[idx] >= 0) && (events[idx].type == PERF_TYPE_HARDWARE)) {
+				user_only = true;
+			}
+		}
+	}
+#endif
+}
+
+bench::perf_counters::~perf_counters() {
+#ifdef __linux__
+	for (int fd : fds) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+#endif
+}
+
+bool bench::perf_counters::is_available() {
+	for (int fd : fds) {
+		if (fd >= 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool bench::perf_counters::is_user_only() {
+	return user_only;
+}
+
+void bench::perf_counters::start() {
+#ifdef __linux__
+	for (int fd : fds) {
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+bench::perf_counters::values bench::perf_counters::stop() {
+	values result;
+	for (int64_t &value : result.value) {
+		value = -1;
+	}
+
+#ifdef __linux__
+	for (int fd : fds) {
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+	for (size_t idx = 0; idx < size_t(counter::_Count); idx++) {
+		// Value, time enabled, time running.
+		uint64_t data[3] = {0, 0, 0};
+		if ((fds[idx] < 0) || (read(fds[idx], data, sizeof(data)) != sizeof(data))) {
+			continue;
+		}
+		if ((data[2] > 0) && (data[2] < data[1])) {
+			data[0] = uint64_t(double(data[0]) * double(data[1]) / double(data[2]));
+		}
+		result.value[idx] = int64_t(data[0]);
+	}
+#endif
+	return result;
+}
+
+const char *bench::perf_counters::get_name(counter type) {
+	switch (type) {
+	case counter::Cycles:
+		return "cycles";
+	case counter::Instructions:
+		return "instructions";
+	case counter::CacheMisses:
+		return "cache_misses";
+	case counter::ContextSwitches:
+		return "context_switches";
+	case counter::PageFaults:
+		return "page_faults";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,71 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef DATALANE_BENCH_PERF_COUNTERS_HPP
+#define DATALANE_BENCH_PERF_COUNTERS_HPP
+
+#include <inttypes.h>
+#include <string>
+
+namespace bench {
+	// Hardware and scheduler counters of this process and all threads it starts while they are running.
+	/// Uses perf_event on Linux and is unavailable elsewhere. Counters the kernel refuses (no PMU in a virtual
+	///  machine, perf_event_paranoid, seccomp) are left out individually instead of failing the benchmark.
+	class perf_counters {
+		public:
+		enum class counter : size_t {
+			Cycles,
+			Instructions,
+			CacheMisses,
+			ContextSwitches,
+			PageFaults,
+			_Count,
+		};
+
+		struct values {
+			// Negative for counters that could not be opened.
+			int64_t value[size_t(counter::_Count)];
+		};
+
+		private:
+		int  fds[size_t(counter::_Count)];
+		bool user_only = false;
+
+		public:
+		perf_counters();
+		~perf_counters();
+
+		perf_counters(const perf_counters &) = delete;
+		perf_counters &operator=(const perf_counters &) = delete;
+
+		// Is at least one counter available?
+		bool is_available();
+
+		// Only user space is counted, kernel time (syscalls) is invisible.
+		bool is_user_only();
+
+		// Reset and start counting.
+		void start();
+
+		// Stop counting and return the values, scaled up if the kernel had to multiplex them.
+		values stop();
+
+		static const char *get_name(counter type);
+	};
+} // namespace bench
+
+#endif // DATALANE_BENCH_PERF_COUNTERS_HPP
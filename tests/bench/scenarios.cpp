@@ -0,0 +1,849 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bench.hpp"
+#include "../../source/os/wait-set.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct completion {
+	os::error ec     = os::error::Unknown;
+	size_t    length = 0;
+};
+
+static std::string make_pipe_name(std::string scenario) {
+	static std::atomic<uint32_t> counter(0);
+	return "datalane-bench-" + scenario + "-"
+		   + std::to_string(bench_clock::now().time_since_epoch().count() % 1000000000) + "-"
+		   + std::to_string(counter++);
+}
+
+static size_t message_count(const bench::config &cfg, size_t size) {
+	size_t count = cfg.bytes / size;
+	return std::max(cfg.min_messages, std::min(cfg.messages, count));
+}
+
+static size_t warmup_count(const bench::config &cfg, size_t messages) {
+	return std::min(cfg.warmup, messages / 10);
+}
+
+// The first 8 bytes of every message carry the time it was sent.
+static void stamp(std::vector<char> &buffer) {
+	int64_t now = bench_clock::now().time_since_epoch().count();
+	memcpy(buffer.data(), &now, sizeof(int64_t));
+}
+
+static std::chrono::nanoseconds since_stamp(std::vector<char> &buffer) {
+	int64_t then = 0;
+	memcpy(&then, buffer.data(), sizeof(int64_t));
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()
+																 - bench_clock::duration(then));
+}
+
+static void fill(std::vector<char> &buffer) {
+	for (size_t idx = 0; idx < buffer.size(); idx++) {
+		buffer[idx] = char(idx * 31 + 7);
+	}
+}
+
+static void check(os::error ec, const char *what) {
+	if (ec != os::error::Success) {
+		throw std::runtime_error(std::string(what) + " failed with error " + std::to_string(int(ec)) + ".");
+	}
+}
+
+// Blocking helpers on top of the asynchronous pipe API.
+static void accept_client(bench::pipe_t &pipe, std::shared_ptr<os::async_op> &op, const bench::config &cfg) {
+	os::error ec = pipe.accept(op, nullptr);
+	if (ec == os::error::Pending) {
+		ec = op->wait(cfg.timeout);
+	} else if (ec == os::error::Connected) {
+		ec = os::error::Success;
+	}
+	check(ec, "Accepting a client");
+}
+
+static void write_message(bench::pipe_t &pipe, std::shared_ptr<os::async_op> &op, std::vector<char> &buffer,
+						  size_t length, const bench::config &cfg) {
+	completion c;
+	check(pipe.write(buffer.data(), length, op, [&c](os::error ec, size_t length) {
+		c.ec     = ec;
+		c.length = length;
+	}),
+		  "Writing");
+	check(op->wait(cfg.timeout), "Waiting for write");
+	check(c.ec, "Write");
+	if (c.length != length) {
+		throw std::runtime_error("Short write.");
+	}
+}
+
+static size_t read_message(bench::pipe_t &pipe, std::shared_ptr<os::async_op> &op, std::vector<char> &buffer,
+						   const bench::config &cfg) {
+	completion c;
+	check(pipe.read(buffer.data(), buffer.size(), op, [&c](os::error ec, size_t length) {
+		c.ec     = ec;
+		c.length = length;
+	}),
+		  "Reading");
+	check(op->wait(cfg.timeout), "Waiting for read");
+	check(c.ec, "Read");
+	return c.length;
+}
+
+// Runs 'fn' on a thread and rethrows whatever it threw on join.
+class worker {
+	std::thread        thread;
+	std::exception_ptr error;
+
+	public:
+	template<typename T>
+	worker(T fn) {
+		thread = std::thread([this, fn]() {
+			try {
+				fn();
+			} catch (...) {
+				error = std::current_exception();
+			}
+		});
+	}
+
+	~worker() {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	void join() {
+		thread.join();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+void bench::ping_pong(const config &cfg, size_t size, result &res) {
+	std::string name     = make_pipe_name("ping-pong");
+	size_t      messages = message_count(cfg, size);
+	size_t      warmup   = warmup_count(cfg, messages);
+
+	res.scenario = "ping-pong";
+	res.size     = size;
+	res.clients  = 1;
+	res.messages = messages;
+
+	pipe_t server(os::create_only, name, 1);
+	worker echo([&]() {
+		std::shared_ptr<os::async_op> accept_op, read_op, write_op;
+		std::vector<char>             buffer(size);
+
+		accept_client(server, accept_op, cfg);
+		for (size_t idx = 0; idx < warmup + messages; idx++) {
+			size_t length = read_message(server, read_op, buffer, cfg);
+			write_message(server, write_op, buffer, length, cfg);
+		}
+	});
+
+	pipe_t                        client(os::open_only, name);
+	std::shared_ptr<os::async_op> read_op, write_op;
+	std::vector<char>             out(size), in(size);
+	fill(out);
+
+	bench_clock::time_point begin;
+	for (size_t idx = 0; idx < warmup + messages; idx++) {
+		if (idx == warmup) {
+			begin = bench_clock::now();
+		}
+
+		auto start = bench_clock::now();
+		write_message(client, write_op, out, size, cfg);
+		if (read_message(client, read_op, in, cfg) != size) {
+			throw std::runtime_error("Echo has the wrong size.");
+		}
+		if (idx >= warmup) {
+			res.latency.manual_track(bench_clock::now() - start);
+		}
+	}
+	res.duration = bench_clock::now() - begin;
+
+	echo.join();
+}
+
+void bench::throughput(const config &cfg, size_t size, result &res) {
+	std::string name     = make_pipe_name("throughput");
+	size_t      messages = message_count(cfg, size);
+	size_t      warmup   = warmup_count(cfg, messages);
+
+	res.scenario = "throughput";
+	res.size     = size;
+	res.clients  = 1;
+	res.messages = messages;
+
+	pipe_t server(os::create_only, name, 1);
+	worker sender([&]() {
+		pipe_t                        client(os::open_only, name);
+		std::shared_ptr<os::async_op> write_op;
+		std::vector<char>             buffer(size);
+		fill(buffer);
+
+		for (size_t idx = 0; idx < warmup + messages; idx++) {
+			stamp(buffer);
+			write_message(client, write_op, buffer, size, cfg);
+		}
+	});
+
+	std::shared_ptr<os::async_op> accept_op, read_op;
+	std::vector<char>             buffer(size);
+	accept_client(server, accept_op, cfg);
+
+	bench_clock::time_point begin;
+	for (size_t idx = 0; idx < warmup + messages; idx++) {
+		if (idx == warmup) {
+			begin = bench_clock::now();
+		}
+
+		if (read_message(server, read_op, buffer, cfg) != size) {
+			throw std::runtime_error("Message has the wrong size.");
+		}
+		if (idx >= warmup) {
+			res.latency.manual_track(since_stamp(buffer));
+		}
+	}
+	res.duration = bench_clock::now() - begin;
+
+	sender.join();
+}
+
+void bench::fan_in(const config &cfg, size_t size, result &res) {
+	std::string name     = make_pipe_name("fan-in");
+	size_t      messages = message_count(cfg, size);
+	size_t      warmup   = warmup_count(cfg, messages);
+	size_t      clients  = cfg.clients;
+
+	res.scenario = "fan-in";
+	res.size     = size;
+	res.clients  = clients;
+	res.messages = messages * clients;
+
+	std::vector<std::unique_ptr<pipe_t>> servers;
+	for (size_t idx = 0; idx < clients; idx++) {
+		servers.push_back(std::make_unique<pipe_t>(os::create_only, name, clients));
+	}
+
+	std::vector<std::unique_ptr<worker>> senders;
+	for (size_t idx = 0; idx < clients; idx++) {
+		senders.push_back(std::make_unique<worker>([&]() {
+			pipe_t                        client(os::open_only, name);
+			std::shared_ptr<os::async_op> write_op;
+			std::vector<char>             buffer(size);
+			fill(buffer);
+
+			for (size_t msg = 0; msg < warmup + messages; msg++) {
+				stamp(buffer);
+				write_message(client, write_op, buffer, size, cfg);
+			}
+		}));
+	}
+
+	std::vector<std::shared_ptr<os::async_op>> accept_ops(clients), read_ops(clients);
+	std::vector<std::vector<char>>             buffers(clients, std::vector<char>(size));
+	std::vector<completion>                    completions(clients);
+	std::vector<size_t>                        received(clients, 0);
+	std::vector<os::waitable *>                waits(clients, nullptr);
+	for (size_t idx = 0; idx < clients; idx++) {
+		accept_client(*servers[idx], accept_ops[idx], cfg);
+	}
+
+	auto post_read = [&](size_t idx) {
+		completion &c = completions[idx];
+		check(servers[idx]->read(buffers[idx].data(), size, read_ops[idx],
+								 [&c](os::error ec, size_t length) {
+									 c.ec     = ec;
+									 c.length = length;
+								 }),
+			  "Reading");
+		waits[idx] = read_ops[idx].get();
+	};
+	for (size_t idx = 0; idx < clients; idx++) {
+		post_read(idx);
+	}
+
+	// Every client that has a message waiting is served per wait, instead of one per system call.
+	size_t                  total = 0;
+	std::vector<size_t>     ready(clients);
+	bench_clock::time_point begin = bench_clock::now();
+	while (total < (warmup + messages) * clients) {
+		size_t count = 0;
+		check(os::waitable::wait_many(waits.data(), waits.size(), ready.data(), ready.size(), count, cfg.timeout),
+			  "Waiting for reads");
+		for (size_t pos = 0; pos < count; pos++) {
+			size_t index = ready[pos];
+			check(completions[index].ec, "Read");
+			if (completions[index].length != size) {
+				throw std::runtime_error("Message has the wrong size.");
+			}
+
+			received[index]++;
+			total++;
+			if (total == warmup * clients) {
+				begin = bench_clock::now();
+			}
+			if (received[index] > warmup) {
+				res.latency.manual_track(since_stamp(buffers[index]));
+			}
+
+			if (received[index] < warmup + messages) {
+				post_read(index);
+			} else {
+				waits[index] = nullptr;
+			}
+		}
+	}
+	res.duration = bench_clock::now() - begin;
+
+	for (auto &sender : senders) {
+		sender->join();
+	}
+}
+
+void bench::fan_out(const config &cfg, size_t size, result &res) {
+	std::string name     = make_pipe_name("fan-out");
+	size_t      messages = message_count(cfg, size);
+	size_t      warmup   = warmup_count(cfg, messages);
+	size_t      clients  = cfg.clients;
+
+	res.scenario = "fan-out";
+	res.size     = size;
+	res.clients  = clients;
+	res.messages = messages * clients;
+
+	std::vector<std::unique_ptr<pipe_t>> servers;
+	for (size_t idx = 0; idx < clients; idx++) {
+		servers.push_back(std::make_unique<pipe_t>(os::create_only, name, clients));
+	}
+
+	// Every receiver keeps its own histogram, they are merged once all of them are done.
+	std::vector<shared::time::measure_timer> samples(clients);
+	std::vector<bench_clock::time_point>     finished(clients);
+	std::vector<std::unique_ptr<worker>>     receivers;
+	for (size_t idx = 0; idx < clients; idx++) {
+		receivers.push_back(std::make_unique<worker>([&, idx]() {
+			pipe_t                        client(os::open_only, name);
+			std::shared_ptr<os::async_op> read_op;
+			std::vector<char>             buffer(size);
+
+			for (size_t msg = 0; msg < warmup + messages; msg++) {
+				if (read_message(client, read_op, buffer, cfg) != size) {
+					throw std::runtime_error("Message has the wrong size.");
+				}
+				if (msg >= warmup) {
+					samples[idx].manual_track(since_stamp(buffer));
+				}
+			}
+			finished[idx] = bench_clock::now();
+		}));
+	}
+
+	std::vector<std::shared_ptr<os::async_op>> accept_ops(clients), write_ops(clients);
+	std::vector<completion>                    completions(clients);
+	std::vector<char>                          buffer(size);
+	fill(buffer);
+	for (size_t idx = 0; idx < clients; idx++) {
+		accept_client(*servers[idx], accept_ops[idx], cfg);
+	}
+
+	bench_clock::time_point begin = bench_clock::now();
+	for (size_t msg = 0; msg < warmup + messages; msg++) {
+		if (msg == warmup) {
+			begin = bench_clock::now();
+		}
+
+		// Queue the message on every connection before waiting on any of them.
+		stamp(buffer);
+		for (size_t idx = 0; idx < clients; idx++) {
+			completion &c = completions[idx];
+			check(servers[idx]->write(buffer.data(), size, write_ops[idx],
+									  [&c](os::error ec, size_t length) {
+										  c.ec     = ec;
+										  c.length = length;
+									  }),
+				  "Writing");
+		}
+		for (size_t idx = 0; idx < clients; idx++) {
+			check(write_ops[idx]->wait(cfg.timeout), "Waiting for write");
+			check(completions[idx].ec, "Write");
+		}
+	}
+
+	for (auto &receiver : receivers) {
+		receiver->join();
+	}
+	res.duration = *std::max_element(finished.begin(), finished.end()) - begin;
+	for (auto &sample : samples) {
+		res.latency.merge(sample);
+	}
+}
+
+// One open-loop run at 'rate' messages per second, or unpaced at a rate of 0.
+static void open_loop_run(const bench::config &cfg, size_t size, double rate, bench::result &res) {
+	std::string name     = make_pipe_name("open-loop");
+	size_t      messages = message_count(cfg, size);
+	size_t      warmup   = warmup_count(cfg, messages);
+	size_t      clients  = cfg.clients;
+
+	std::vector<std::unique_ptr<bench::pipe_t>> servers;
+	for (size_t idx = 0; idx < clients; idx++) {
+		servers.push_back(std::make_unique<bench::pipe_t>(os::create_only, name, clients));
+	}
+
+	// Every connection keeps its own histograms, they are merged once all of them are done.
+	std::vector<shared::time::measure_timer> corrected(clients), uncorrected(clients);
+	std::vector<bench_clock::time_point>     finished(clients);
+	std::vector<std::unique_ptr<worker>>     senders;
+	bench_clock::time_point                  start = bench_clock::now() + std::chrono::milliseconds(50);
+	for (size_t idx = 0; idx < clients; idx++) {
+		senders.push_back(std::make_unique<worker>([&, idx]() {
+			bench::pipe_t                 client(os::open_only, name);
+			std::shared_ptr<os::async_op> read_op, write_op;
+			std::vector<char>             out(size), in(size);
+			completion                    read_c, write_c;
+			fill(out);
+
+			// Each connection carries an equal share of the rate, constant schedules are staggered.
+			std::mt19937_64                          random(uint64_t(idx) * 7919 + 1);
+			double                                   mean = rate > 0 ? double(clients) / rate * 1e9 : 0;
+			std::exponential_distribution<double>    exponential(1.0);
+			bench_clock::time_point                  due = start;
+			if (cfg.arrival == bench::config::arrival_t::Constant) {
+				due += std::chrono::nanoseconds(int64_t(mean * double(idx) / double(clients)));
+			}
+			auto gap = [&]() {
+				double ns = cfg.arrival == bench::config::arrival_t::Poisson ? mean * exponential(random) : mean;
+				return std::chrono::nanoseconds(int64_t(ns));
+			};
+
+			// Scheduled and actual send time of every message the echo has not come back for yet.
+			std::deque<std::pair<bench_clock::time_point, bench_clock::time_point>> in_flight;
+			size_t total = warmup + messages, sent = 0, received = 0;
+			bool   writing = false;
+
+			auto post_read = [&]() {
+				check(client.read(in.data(), size, read_op,
+								  [&read_c](os::error ec, size_t length) {
+									  read_c.ec     = ec;
+									  read_c.length = length;
+								  }),
+					  "Reading");
+			};
+			post_read();
+
+			while (received < total) {
+				if (!writing && (sent < total) && (bench_clock::now() >= due)) {
+					in_flight.emplace_back(rate > 0 ? due : bench_clock::now(), bench_clock::now());
+					check(client.write(out.data(), size, write_op,
+									   [&write_c](os::error ec, size_t length) {
+										   write_c.ec     = ec;
+										   write_c.length = length;
+									   }),
+						  "Writing");
+					writing = true;
+					// The schedule does not wait for the write, so a slow write makes the next ones late.
+					due += gap();
+					continue;
+				}
+
+				std::chrono::nanoseconds timeout = cfg.timeout;
+				if (!writing && (sent < total)) {
+					timeout = std::max(std::chrono::nanoseconds(0),
+									   std::chrono::duration_cast<std::chrono::nanoseconds>(due - bench_clock::now()));
+				}
+				os::waitable *waits[] = {read_op.get(), writing ? write_op.get() : nullptr};
+				size_t        index   = 0;
+				os::error     ec      = os::waitable::wait_any(waits, 2, index, timeout);
+				if ((ec == os::error::TimedOut) && (timeout < cfg.timeout)) {
+					continue;
+				}
+				check(ec, "Waiting for echo");
+
+				if (index == 1) {
+					check(write_c.ec, "Write");
+					writing = false;
+					sent++;
+					continue;
+				}
+
+				check(read_c.ec, "Read");
+				if ((read_c.length != size) || in_flight.empty()) {
+					throw std::runtime_error("Unexpected echo.");
+				}
+				bench_clock::time_point now = bench_clock::now();
+				if (received >= warmup) {
+					corrected[idx].manual_track(now - in_flight.front().first);
+					uncorrected[idx].manual_track(now - in_flight.front().second);
+				}
+				in_flight.pop_front();
+				received++;
+				if (received < total) {
+					post_read();
+				}
+			}
+			finished[idx] = bench_clock::now();
+		}));
+	}
+
+	// Echo every connection on its own thread, so that a slow connection does not hold up the others.
+	std::vector<std::unique_ptr<worker>> echoes;
+	for (size_t idx = 0; idx < clients; idx++) {
+		echoes.push_back(std::make_unique<worker>([&, idx]() {
+			std::shared_ptr<os::async_op> accept_op, read_op, write_op;
+			std::vector<char>             buffer(size);
+
+			accept_client(*servers[idx], accept_op, cfg);
+			for (size_t msg = 0; msg < warmup + messages; msg++) {
+				size_t length = read_message(*servers[idx], read_op, buffer, cfg);
+				write_message(*servers[idx], write_op, buffer, length, cfg);
+			}
+		}));
+	}
+
+	for (auto &echo : echoes) {
+		echo->join();
+	}
+	for (auto &sender : senders) {
+		sender->join();
+	}
+
+	res.size     = size;
+	res.clients  = clients;
+	res.messages = messages * clients;
+	res.rate     = rate;
+	res.duration = *std::max_element(finished.begin(), finished.end()) - start;
+	for (size_t idx = 0; idx < clients; idx++) {
+		res.latency.merge(corrected[idx]);
+		res.uncorrected.merge(uncorrected[idx]);
+	}
+}
+
+void bench::open_loop(const config &cfg, size_t size, result &res) {
+	double rate = cfg.rate;
+	if (rate <= 0) {
+		// Find the saturation throughput first, the measured run is a fraction of it.
+		bench::result calibration;
+		open_loop_run(cfg, size, 0, calibration);
+		size_t messages = message_count(cfg, size);
+		double seconds  = double(calibration.duration.count()) / 1e9;
+		rate = cfg.load * double((messages + warmup_count(cfg, messages)) * cfg.clients) / seconds;
+	}
+
+	open_loop_run(cfg, size, rate, res);
+	res.scenario = "open-loop";
+}
+
+size_t bench::get_rss() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+		return 0;
+	}
+	return size_t(pmc.WorkingSetSize);
+#else
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (!file) {
+		return 0;
+	}
+	unsigned long long pages = 0, resident = 0;
+	int                read  = fscanf(file, "%llu %llu", &pages, &resident);
+	fclose(file);
+	return read == 2 ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+// Connections a single process can hold with both ends open, after raising the descriptor limit as far as allowed.
+static size_t max_connections() {
+#ifdef _WIN32
+	return SIZE_MAX;
+#else
+	rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		return 512;
+	}
+	if (limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+	}
+	// Two descriptors per connection, plus headroom for the listener, logs and the like.
+	return limit.rlim_cur > 128 ? size_t(limit.rlim_cur - 128) / 2 : 0;
+#endif
+}
+
+void bench::c10k(const config &cfg, size_t size, result &res) {
+	std::string name        = make_pipe_name("c10k");
+	size_t      connections = cfg.connections;
+	size_t      limit       = max_connections();
+	if (connections > limit) {
+		shared::logger::log("c10k: limited to %zu connections by the file descriptor limit.", limit);
+		connections = limit;
+	}
+	if ((connections == 0) || (size < sizeof(int64_t))) {
+		throw std::runtime_error("Not enough connections or too small messages.");
+	}
+
+	// Wait sets are limited to 64 items on Windows, so more threads are needed there.
+	size_t threads = std::max<size_t>(1, std::min(cfg.threads, connections));
+#ifdef _WIN32
+	threads = std::max(threads, (connections + MAXIMUM_WAIT_OBJECTS - 2) / (MAXIMUM_WAIT_OBJECTS - 1));
+#endif
+	double rate     = cfg.rate > 0 ? cfg.rate : double(connections);
+	size_t messages = message_count(cfg, size);
+
+	res.scenario = "c10k";
+	res.size     = size;
+	res.clients  = connections;
+	res.messages = messages;
+	res.rate     = rate;
+
+	std::vector<std::unique_ptr<pipe_t>> servers(connections), clients(connections);
+	size_t                               rss_before = bench::get_rss();
+
+	// Accept on one thread while connecting from this one, the backlog decouples the two.
+	bench_clock::time_point accept_start = bench_clock::now();
+	worker                  acceptor([&]() {
+		for (size_t idx = 0; idx < connections; idx++) {
+			std::shared_ptr<os::async_op> accept_op;
+			servers[idx] = std::make_unique<pipe_t>(os::create_only, name, PIPE_UNLIMITED_INSTANCES);
+			accept_client(*servers[idx], accept_op, cfg);
+		}
+	});
+	for (size_t idx = 0; idx < connections; idx++) {
+		bench_clock::time_point deadline = bench_clock::now() + cfg.timeout;
+		for (;;) {
+			try {
+				clients[idx] = std::make_unique<pipe_t>(os::open_only, name);
+				break;
+			} catch (std::exception &) {
+				// No instance is waiting yet on Windows, or the backlog is full.
+				if (bench_clock::now() > deadline) {
+					throw;
+				}
+				std::this_thread::yield();
+			}
+		}
+	}
+	acceptor.join();
+	double accept_seconds = double((bench_clock::now() - accept_start).count()) * bench_clock::period::num
+							/ bench_clock::period::den;
+	res.accept_rate = double(connections) / accept_seconds;
+
+	size_t rss_after = bench::get_rss();
+	if ((rss_before > 0) && (rss_after > 0)) {
+		res.memory_per_connection = (int64_t(rss_after) - int64_t(rss_before)) / int64_t(connections);
+	}
+
+	// Every thread owns the connections whose index modulo 'threads' is its own.
+	std::atomic<size_t>                      echoed(0);
+	std::atomic<bool>                        done(false);
+	std::vector<shared::time::measure_timer> samples(threads);
+	std::vector<std::unique_ptr<worker>>     echoes, senders;
+	for (size_t thread = 0; thread < threads; thread++) {
+		echoes.push_back(std::make_unique<worker>([&, thread]() {
+			std::vector<size_t> owned;
+			for (size_t idx = thread; idx < connections; idx += threads) {
+				owned.push_back(idx);
+			}
+			std::vector<std::shared_ptr<os::async_op>> read_ops(owned.size()), write_ops(owned.size());
+			std::vector<std::vector<char>>             buffers(owned.size(), std::vector<char>(size));
+			std::vector<completion>                    completions(owned.size());
+			os::wait_set                               waits;
+			std::unordered_map<os::waitable *, size_t> indices;
+			std::vector<os::waitable *>                ready;
+			auto post_read = [&](size_t idx) {
+				completion &c = completions[idx];
+				check(servers[owned[idx]]->read(buffers[idx].data(), size, read_ops[idx],
+												[&c](os::error ec, size_t length) {
+													c.ec     = ec;
+													c.length = length;
+												}),
+					  "Reading");
+			};
+			// Requests are reused for every read, so the set is built once.
+			for (size_t idx = 0; idx < owned.size(); idx++) {
+				post_read(idx);
+				waits.add(read_ops[idx].get());
+				indices[read_ops[idx].get()] = idx;
+			}
+
+			while (!done) {
+				os::error ec = waits.wait(ready, std::chrono::milliseconds(50));
+				if (ec == os::error::TimedOut) {
+					continue;
+				}
+				check(ec, "Waiting for messages");
+				for (os::waitable *item : ready) {
+					size_t index = indices[item];
+					check(completions[index].ec, "Read");
+					write_message(*servers[owned[index]], write_ops[index], buffers[index], completions[index].length,
+								  cfg);
+					echoed++;
+					post_read(index);
+				}
+			}
+			for (auto &op : read_ops) {
+				waits.remove(op.get());
+			}
+		}));
+	}
+
+	bench_clock::time_point start = bench_clock::now() + std::chrono::milliseconds(50);
+	for (size_t thread = 0; thread < threads; thread++) {
+		senders.push_back(std::make_unique<worker>([&, thread]() {
+			std::vector<size_t> owned;
+			for (size_t idx = thread; idx < connections; idx += threads) {
+				owned.push_back(idx);
+			}
+			// This thread's share of the messages, sent round robin over its connections.
+			size_t total = messages / threads + (thread < messages % threads ? 1 : 0);
+			if (total == 0) {
+				return;
+			}
+
+			std::vector<std::shared_ptr<os::async_op>> read_ops(owned.size()), write_ops(owned.size());
+			std::vector<std::vector<char>>             buffers(owned.size(), std::vector<char>(size));
+			std::vector<completion>                    completions(owned.size());
+			os::wait_set                               waits;
+			std::unordered_map<os::waitable *, size_t> indices;
+			std::vector<os::waitable *>                ready;
+			std::vector<char>                          out(size);
+			fill(out);
+			auto post_read = [&](size_t idx) {
+				completion &c = completions[idx];
+				check(clients[owned[idx]]->read(buffers[idx].data(), size, read_ops[idx],
+												[&c](os::error ec, size_t length) {
+													c.ec     = ec;
+													c.length = length;
+												}),
+					  "Reading");
+			};
+			for (size_t idx = 0; idx < owned.size(); idx++) {
+				post_read(idx);
+				waits.add(read_ops[idx].get());
+				indices[read_ops[idx].get()] = idx;
+			}
+
+			std::mt19937_64                       random(uint64_t(thread) * 7919 + 1);
+			std::exponential_distribution<double> exponential(1.0);
+			double                                mean = double(threads) / rate * 1e9;
+			bench_clock::time_point due = start + std::chrono::nanoseconds(int64_t(mean * double(thread) / double(threads)));
+			size_t                  sent = 0, received = 0;
+			while (received < total) {
+				if ((sent < total) && (bench_clock::now() >= due)) {
+					// The scheduled time travels with the message, so the echo measures from it.
+					int64_t scheduled = due.time_since_epoch().count();
+					memcpy(out.data(), &scheduled, sizeof(int64_t));
+					size_t idx = sent % owned.size();
+					write_message(*clients[owned[idx]], write_ops[idx], out, size, cfg);
+					sent++;
+					double gap = cfg.arrival == bench::config::arrival_t::Poisson ? mean * exponential(random) : mean;
+					due += std::chrono::nanoseconds(int64_t(gap));
+					continue;
+				}
+
+				std::chrono::nanoseconds timeout = cfg.timeout;
+				if (sent < total) {
+					timeout = std::max(std::chrono::nanoseconds(0),
+									   std::chrono::duration_cast<std::chrono::nanoseconds>(due - bench_clock::now()));
+				}
+				os::error ec = waits.wait(ready, timeout);
+				if ((ec == os::error::TimedOut) && (timeout < cfg.timeout)) {
+					continue;
+				}
+				check(ec, "Waiting for echo");
+				for (os::waitable *item : ready) {
+					size_t index = indices[item];
+					check(completions[index].ec, "Read");
+					samples[thread].manual_track(since_stamp(buffers[index]));
+					received++;
+					post_read(index);
+				}
+			}
+			for (auto &op : read_ops) {
+				waits.remove(op.get());
+			}
+		}));
+	}
+
+	// Echo threads only stop once told to, so they must be stopped even if a sender failed.
+	std::exception_ptr error;
+	for (auto &sender : senders) {
+		try {
+			sender->join();
+		} catch (...) {
+			error = error ? error : std::current_exception();
+		}
+	}
+	res.duration = bench_clock::now() - start;
+	done         = true;
+	for (auto &echo : echoes) {
+		try {
+			echo->join();
+		} catch (...) {
+			error = error ? error : std::current_exception();
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	for (auto &sample : samples) {
+		res.latency.merge(sample);
+	}
+
+	// Every connection has carried traffic and is idle now. The scenario's own buffers are gone, so hand freed heap
+	//  back to the system first, or it would be counted against the connections.
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+	size_t rss_idle = bench::get_rss();
+	if ((rss_before > 0) && (rss_idle > 0)) {
+		res.idle_memory_per_connection = (int64_t(rss_idle) - int64_t(rss_before)) / int64_t(connections);
+	}
+
+	// Tear down both ends before the next size starts, the descriptors are needed again.
+	clients.clear();
+	servers.clear();
+}
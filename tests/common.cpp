@@ -12,9 +12,13 @@
 #include <locale>
 #include <codecvt>
 #include <string>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <limits.h>
+#include <unistd.h>
 #endif
 
 #pragma region shared::logger
@@ -111,9 +115,9 @@ void shared::logger::log(std::string format, ...) {
 		auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart);
 
 		const char* timestamp_format = "%.2d:%.2d:%.2d.%.3d.%.3d.%.3d";
-#define timestamp_args hours.count(), minutes.count(), seconds.count(),	milliseconds.count(), microseconds.count(), nanoseconds.count()
-		timestamp_buffer.resize(_scprintf(timestamp_format, timestamp_args) + 1);
-		sprintf_s(timestamp_buffer.data(), timestamp_buffer.size(), timestamp_format, timestamp_args);
+#define timestamp_args int(hours.count()), int(minutes.count()), int(seconds.count()), int(milliseconds.count()), int(microseconds.count()), int(nanoseconds.count())
+		timestamp_buffer.resize(snprintf(nullptr, 0, timestamp_format, timestamp_args) + 1);
+		snprintf(timestamp_buffer.data(), timestamp_buffer.size(), timestamp_format, timestamp_args);
 #undef timestamp_args
 	} else {
 		std::time_t t = std::time(0);
@@ -122,10 +126,12 @@ void shared::logger::log(std::string format, ...) {
 	}
 
 	// Generate Message
-	va_list args;
+	va_list args, args_copy;
 	va_start(args, format);
-	message_buffer.resize(_vscprintf(format.c_str(), args) + 1);
-	vsprintf_s(message_buffer.data(), message_buffer.size(), format.c_str(), args);
+	va_copy(args_copy, args);
+	message_buffer.resize(vsnprintf(nullptr, 0, format.c_str(), args_copy) + 1);
+	va_end(args_copy);
+	vsnprintf(message_buffer.data(), message_buffer.size(), format.c_str(), args);
 	va_end(args);
 
 	// Log each line individually
@@ -150,12 +156,12 @@ void shared::logger::log(std::string format, ...) {
 		}
 
 		if (message_end != 0) {
-			final_buffer.resize(_scprintf(final_format,
-				timestamp_buffer.size(), timestamp_buffer.data(),
-				message.length(), message.data()) + 1);
+			final_buffer.resize(snprintf(nullptr, 0, final_format,
+				int(timestamp_buffer.size()), timestamp_buffer.data(),
+				int(message.length()), message.data()) + 1);
 			snprintf(final_buffer.data(), final_buffer.size(), final_format,
-				timestamp_buffer.size(), timestamp_buffer.data(),
-				message.length(), message.data());
+				int(timestamp_buffer.size()), timestamp_buffer.data(),
+				int(message.length()), message.data());
 			final_buffer[final_buffer.size() - 1] = '\n';
 
 			if (log_stdout_enabled) {
@@ -217,6 +223,12 @@ std::string shared::os::get_working_directory() {
 	}
 
 	return bufUTF8.data();
+#else
+	std::vector<char> buf(PATH_MAX);
+	if (!getcwd(buf.data(), buf.size())) {
+		return "";
+	}
+	return buf.data();
 #endif
 }
 
@@ -313,8 +325,8 @@ bool shared::os::process::is_detached() {
 #pragma endregion shared::os
 
 #pragma region shared::time
-shared::time::measure_timer::measure_timer() {
-
+shared::time::measure_timer::measure_timer() : timings(precision) {
+	timings.preallocate();
 }
 
 shared::time::measure_timer::~measure_timer() {
@@ -326,96 +338,43 @@ std::unique_ptr<shared::time::measure_timer::instance> shared::time::measure_tim
 }
 
 void shared::time::measure_timer::manual_track(std::chrono::nanoseconds time) {
-	auto el = timings.find(time);
-	if (el != timings.end()) {
-		el->second++;
-	} else {
-		timings.insert(std::make_pair(time, 1));
-	}
-	calls++;
+	track(time);
 }
 
 void shared::time::measure_timer::track(std::chrono::nanoseconds dur) {
-	auto el = timings.find(dur);
-	if (el != timings.end()) {
-		el->second++;
-	} else {
-		timings.insert(std::make_pair(dur, 1));
-	}
-	calls++;
+	timings.record(dur);
+}
+
+void shared::time::measure_timer::merge(const measure_timer& other) {
+	timings.merge(other.timings);
+}
+
+void shared::time::measure_timer::reset() {
+	timings.reset();
 }
 
 uint64_t shared::time::measure_timer::count() {
-	return calls;
+	return timings.count();
 }
 
 std::chrono::nanoseconds shared::time::measure_timer::total() {
-	if (timings.size() == 0) {
-		return std::chrono::nanoseconds(0);
-	}
-
-	std::chrono::nanoseconds val = std::chrono::nanoseconds(0);
-	for (auto el : timings) {
-		val += el.first * el.second;
-	}
-	return val;
+	return timings.total();
 }
 
 double_t shared::time::measure_timer::average() {
-	if (timings.size() == 0) {
-		return 0;
-	}
-
-	double_t val = 0;
-	for (auto el : timings) {
-		val += el.first.count() * el.second;
-	}
-	return (val / calls);
+	return timings.average();
 }
 
 std::chrono::nanoseconds shared::time::measure_timer::percentile(double_t pct, bool by_time /*= false*/) {
-	if (timings.size() == 0) {
-		return std::chrono::nanoseconds(0);
+	if ((timings.count() == 0) || !by_time || (pct <= 0.0) || (pct >= 1.0)) {
+		return timings.percentile(pct);
 	}
 
-	// Should we gather a percentile by time, or by calls?
-	if (by_time) {
-		// By time, so find the largest and smallest value.
-		// This can be used for median, but not average.
-
-		std::chrono::nanoseconds smallest, largest;
-		smallest = timings.begin()->first;
-		largest = timings.rbegin()->first;
-
-		for (auto el : timings) {
-			double_t el_pct = (double_t((el.first - smallest).count()) / double_t(largest.count()));
-
-			if (is_equal(pct, el_pct, 0.0005)) {
-				return el.first;
-			}
-		}
-
-		return timings.rbegin()->first;
-	} else {
-		uint64_t curr_accu = 0;
-		if (is_equal(pct, 0.0, 0.0005)) {
-			return timings.begin()->first;
-		}
-
-		for (auto el : timings) {
-			uint64_t last_accu = curr_accu;
-			curr_accu += el.second;
-
-			double_t last_pct = double_t(last_accu) / double_t(calls);
-			double_t curr_pct = double_t(curr_accu) / double_t(calls);
-
-			if ((last_pct < pct) && ((curr_pct > pct) || is_equal(pct, curr_pct, 0.0005))) {
-				return el.first;
-			}
-		}
-
-		return timings.rbegin()->first;
-	}
+	// By time, so find the first sample at or above the given point between the smallest and largest.
+	// This can be used for median, but not average.
+	auto smallest = timings.min();
+	auto largest  = timings.max();
+	return timings.ceiling(smallest + std::chrono::nanoseconds(int64_t(double_t((largest - smallest).count()) * pct)));
 }
 
 shared::time::measure_timer::instance::instance(measure_timer* parent) : parent(parent) {
@@ -1,11 +1,13 @@
 // Shared code for all tests.
 // 
 
+#include <cmath>
 #include <inttypes.h>
 #include <string>
 #include <memory>
-#include <map>
+#include <vector>
 #include <chrono>
+#include "../source/os/histogram.hpp"
 
 namespace shared {
 	template<typename T>
@@ -61,9 +63,12 @@ namespace shared {
 	};
 
 	namespace time {
+		// Latency histogram of the library (os::histogram) with finer buckets, about 0.8% error instead of 3%.
+		// Every bucket is allocated up front, so recording never allocates and is O(1).
 		class measure_timer {
-			std::map<std::chrono::nanoseconds, size_t> timings;
-			size_t calls = 0;
+			static const size_t precision = 7;
+
+			::os::histogram timings;
 
 			protected:
 			inline void track(std::chrono::nanoseconds dur);
@@ -93,6 +98,11 @@ namespace shared {
 
 			void manual_track(std::chrono::nanoseconds time);
 
+			// Add all samples of another timer, e.g. one that was filled by another thread.
+			void merge(const measure_timer& other);
+
+			void reset();
+
 			uint64_t count();
 
 			std::chrono::nanoseconds total();
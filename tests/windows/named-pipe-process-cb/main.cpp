@@ -23,7 +23,6 @@
 #include <string>
 #include <thread>
 #include "../../../source/os/windows/named-pipe.hpp"
-#include "../../../source/os/windows/semaphore.hpp"
 #include "../../common.hpp"
 
 using namespace std::placeholders;
@@ -32,8 +31,6 @@ using namespace std::placeholders;
 #undef max
 #undef min
 
-#define SERVER_CLIENT_CHANNEL "DataSend1"
-#define CLIENT_SERVER_CHANNEL "DataRecv1"
 #define CLIENT_MAX_MESSAGES 100000
 
 std::vector<std::string> messages = {
@@ -67,13 +64,13 @@ std::vector<std::string> messages = {
 // New functionality by commit 2a6040df7922a077dc9aa16216e4085796637a42
 struct server_data {
 	os::windows::named_pipe pipe;
-	os::windows::semaphore  sin;
-	os::windows::semaphore  sout;
 
 	std::shared_ptr<os::async_op>               read_op, write_op;
 	std::unique_ptr<os::windows::async_request> accept_request;
-	std::vector<char>                           read_buf, write_buf;
+	std::vector<char>                           write_buf;
 	std::queue<std::vector<char>>               write_queue;
+	os::buffer_pool                             pool;
+	os::buffer_pool::buffer                     message;
 
 	size_t count_recv = 0;
 	size_t count_send = 0;
@@ -82,8 +79,7 @@ struct server_data {
 
 	server_data()
 		: pipe(os::create_only, "Data", 255, os::windows::pipe_type::Message, os::windows::pipe_read_mode::Message,
-			   true),
-		  sin(os::create_only, CLIENT_SERVER_CHANNEL), sout(os::create_only, SERVER_CLIENT_CHANNEL) {}
+			   true) {}
 
 	void accept_client() {
 		os::error ec = os::error::Unknown;
@@ -104,13 +100,6 @@ struct server_data {
 		}		
 	}
 
-	void signal_client_start_cb(os::error err, size_t bytes) {
-		os::error ec = sout.signal();
-		if (ec != os::error::Success) {
-			throw std::exception("unexpected error");
-		}
-	}
-
 	void signal_client_start() {
 		shared::logger::log("Signalling Client to start...");
 
@@ -118,9 +107,7 @@ struct server_data {
 		write_buf[0] = 'G';
 		write_buf[1] = 'O';
 
-		if (pipe.write(write_buf.data(), write_buf.size(), write_op,
-					   std::bind(&server_data::signal_client_start_cb, this, _1, _2))
-			!= os::error::Success) {
+		if (pipe.write(write_buf.data(), write_buf.size(), write_op, nullptr) != os::error::Success) {
 			throw std::exception("Failed to write to pipe.");
 		}
 
@@ -139,7 +126,8 @@ struct server_data {
 
 		if (err == os::error::Success) {
 			count_recv++;
-			send_message(read_buf);
+			std::vector<char> buf(message.data(), message.data() + bytes);
+			send_message(buf);
 		}
 
 		if (pending_msg > 0) {
@@ -152,21 +140,7 @@ struct server_data {
 			return;
 		}
 
-		size_t    avail = 0;
-		os::error ec;
-
-		while (avail == 0) {
-			ec = pipe.available(avail);
-			if (ec != os::error::Success) {
-				break;
-			}
-			if (avail == 0) {
-				Sleep(0); // Give up time slice.
-			}
-		}
-
-		read_buf.resize(avail);
-		ec = pipe.read(read_buf.data(), avail, read_op, std::bind(&server_data::read_cb, this, _1, _2));
+		os::error ec = pipe.read_message(pool, message, read_op, std::bind(&server_data::read_cb, this, _1, _2));
 		if (ec != os::error::Success) {
 			throw std::exception("unexpected error");
 		}
@@ -180,7 +154,6 @@ struct server_data {
 		write_op->invalidate();
 
 		if (err == os::error::Success) {
-			sout.signal();
 			count_send++;
 
 			if (write_queue.size() > 0) {
@@ -232,8 +205,10 @@ struct server_data {
 
 		signal_client_start();
 
+		// The pipe signals waiting messages itself, once per message until the next read is issued.
+		os::waitable *readable = pipe.get_readable();
 		while (pipe.is_connected()) {
-			os::waitable *waits[]    = {&sin, read_op.get(), write_op.get()};
+			os::waitable *waits[]    = {readable, read_op.get(), write_op.get()};
 			size_t        wait_index = std::numeric_limits<size_t>::max();
 			for (size_t idx = 0; idx < 3; idx++) {
 				if (waits[idx] != nullptr && waits[idx]->wait(std::chrono::milliseconds(0)) == os::error::Success) {
@@ -253,7 +228,7 @@ struct server_data {
 				continue;
 			}
 
-			if (waits[wait_index] == &sin) {
+			if (waits[wait_index] == readable) {
 				if (read_op && read_op->is_valid()) {
 					pending_msg++;
 				} else {
@@ -282,8 +257,8 @@ int server(int argc, const char *argv[]) {
 	//	//
 	//	shared::logger::log("Sent %lld, received %lld messages.", sd.count_send, sd.count_recv);
 
-	//	os::waitable *waits[]    = {((sd.read_op && sd.read_op->is_valid()) ? nullptr : &sd.sin), sd.read_op.get(),
- //                                sd.write_op.get()};
+	//	os::waitable *waits[]    = {((sd.read_op && sd.read_op->is_valid()) ? nullptr : sd.pipe.get_readable()),
+ //                                sd.read_op.get(), sd.write_op.get()};
 	//	size_t        wait_index = std::numeric_limits<size_t>::max();
 	//	for (size_t idx = 0; idx < 3; idx++) {
 	//		if (waits[idx] != nullptr && waits[idx]->wait(std::chrono::milliseconds(0)) == os::error::Success) {
@@ -319,8 +294,7 @@ int server(int argc, const char *argv[]) {
 	//					throw std::exception("unexpected error");
 	//				}
 	//			} else {
-	//				// Attempted to read before Kernel update.
-	//				sd.sin.signal();
+	//				// Attempted to read before Kernel update, the next read arms the readable waitable again.
 	//			}
 	//		}
 	//	}
@@ -333,12 +307,12 @@ int server(int argc, const char *argv[]) {
 
 struct client_data {
 	os::windows::named_pipe pipe;
-	os::windows::semaphore  sin;
-	os::windows::semaphore  sout;
 
 	std::shared_ptr<os::async_op> read_op, write_op;
-	std::vector<char>             read_buf, write_buf;
+	std::vector<char>             write_buf;
 	std::queue<std::vector<char>> write_queue;
+	os::buffer_pool               pool;
+	os::buffer_pool::buffer       message;
 
 	bool   is_initialized = false;
 	size_t count_send     = 0;
@@ -352,8 +326,7 @@ struct client_data {
 	std::queue<std::unique_ptr<shared::time::measure_timer::instance>> msg_times;
 
 	client_data()
-		: pipe(os::open_only, "Data", os::windows::pipe_read_mode::Message), sin(os::open_only, SERVER_CLIENT_CHANNEL),
-		  sout(os::open_only, CLIENT_SERVER_CHANNEL) {}
+		: pipe(os::open_only, "Data", os::windows::pipe_read_mode::Message) {}
 
 	void send_message() {
 		if (write_op && write_op->is_valid()) {
@@ -385,19 +358,7 @@ struct client_data {
 			return;
 		}
 
-		size_t    avail = 0;
-		os::error ec;
-
-		while (avail == 0) {
-			ec = pipe.available(avail);
-			if (ec != os::error::Success) {
-				break;
-			}
-		}
-
-		read_buf.resize(avail);
-		ec = pipe.read(read_buf.data(), avail, read_op,
-					   std::bind(&client_data::read_cb, this, std::placeholders::_1, std::placeholders::_2));
+		os::error ec = pipe.read_message(pool, message, read_op, std::bind(&client_data::read_cb, this, _1, _2));
 		if (ec != os::error::Success) {
 			throw std::exception("unexpected error");
 		}
@@ -405,33 +366,23 @@ struct client_data {
 
 	void loop() {
 		size_t count = 0, recv_count = 0;
-		size_t avail = 0;
 
 		// Timers
 
-		os::error ec;
-		auto      loop_time = loop_timer.track();
+		os::error     ec;
+		os::waitable *readable  = pipe.get_readable();
+		auto          loop_time = loop_timer.track();
 		while (pipe.is_connected()) {
 			//shared::logger::log("Sent %lld, received %lld messages.", count_send, count_recv);
 
 			if (!is_initialized) {
 				if (!read_op) {
-					ec = sin.wait(std::chrono::milliseconds(100));
+					ec = readable->wait(std::chrono::milliseconds(100));
 					if (ec != os::error::Success) {
 						continue;
 					}
 					go_time = go_timer.track();
-					while (avail == 0) {
-						ec = pipe.available(avail);
-						if (ec != os::error::Success) {
-							break;
-						}
-					}
-					if (avail == 0) {
-						throw std::exception("unexpected error");
-					}
-					read_buf.resize(avail);
-					ec = pipe.read(read_buf.data(), avail, read_op, std::bind(&client_data::read_cb, this, _1, _2));
+					ec = pipe.read_message(pool, message, read_op, std::bind(&client_data::read_cb, this, _1, _2));
 					if (ec != os::error::Success) {
 						throw std::exception("unexpected error");
 					}
@@ -443,7 +394,7 @@ struct client_data {
 				// - Windows: You need a thread that can enter an alertable state or is permanently in that state.
 
 				os::waitable *waits[] = {
-					((read_op && read_op->is_valid()) ? nullptr : &sin),
+					((read_op && read_op->is_valid()) ? nullptr : readable),
 					read_op.get(),
 					write_op.get(),
 				};
@@ -462,7 +413,7 @@ struct client_data {
 						throw std::exception("unexpected error");
 					}
 				}
-				if (wait_index == 1) {
+				if ((wait_index == 0) || (wait_index == 1)) {
 					read_message();
 				} else if (wait_index == 2) {
 					send_message();
@@ -497,7 +448,7 @@ struct client_data {
 
 		if (!is_initialized) {
 			if (err == os::error::Success) {
-				if (read_buf[0] == 'G' && read_buf[1] == 'O') {
+				if ((bytes == 2) && (message.data()[0] == 'G') && (message.data()[1] == 'O')) {
 					go_time.reset();
 					is_initialized = true;
 					shared::logger::log("Signal received.");
@@ -513,14 +464,14 @@ struct client_data {
 		} else {
 			msg_times.pop();
 
-			uint8_t idx = (uint8_t &)read_buf[0];
+			uint8_t idx = (uint8_t &)message.data()[0];
 			if (idx >= messages.size()) {
 				shared::logger::log("Index %d is out of bounds (maximum %d)", idx, messages.size() - 1);
 				throw std::exception("Message corrupted.");
 			}
 
 			size_t      msg_len = bytes - 1;
-			const char *msg     = (const char *)&read_buf[1];
+			const char *msg     = (const char *)&message.data()[1];
 			if ((msg_len == messages[idx].size()) && (memcmp(msg, messages[idx].c_str(), msg_len) == 0)) {
 				count_recv++;
 				/*if ((count_recv + 1) % 100 == 0)
@@ -543,10 +494,6 @@ struct client_data {
 		write_op->invalidate();
 
 		if (err == os::error::Success) {
-			os::error ec = sout.signal();
-			if (ec != os::error::Success) {
-				throw std::exception("Could not signal remote.");
-			}
 			count_send++;
 			/*if ((count_send + 1) % 100 == 0)
 				shared::logger::log("Sent %lld messages.", count_send);*/
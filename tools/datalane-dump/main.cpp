@@ -0,0 +1,239 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "../../source/os/capture.hpp"
+#include "../../source/os/histogram.hpp"
+
+struct lane_summary {
+	uint64_t      messages = 0;
+	uint64_t      bytes    = 0;
+	uint64_t      first    = 0;
+	uint64_t      last     = 0;
+	// Sizes are kept in a latency histogram, its buckets work for any unit.
+	os::histogram sizes;
+	os::histogram latency;
+	os::histogram gaps;
+};
+
+static void usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s [options] FILE\n"
+			"  --csv FILE          Write every message as CSV to FILE ('-' for stdout) instead of listing them\n"
+			"  --lane N            Only show messages of this lane, may be repeated\n"
+			"  --direction DIR     Only show 'in' or 'out' messages\n"
+			"  --limit N           Stop after N messages\n"
+			"  --hex N             Show up to N captured bytes of every message\n"
+			"  --summary           Only print the summary\n",
+			program);
+}
+
+static uint64_t parse_number(const char *text) {
+	char *             end   = nullptr;
+	unsigned long long value = strtoull(text, &end, 10);
+	if ((end == text) || (*end != '\0')) {
+		throw std::invalid_argument(std::string("Invalid number '") + text + "'.");
+	}
+	return uint64_t(value);
+}
+
+static const char *error_name(int8_t result) {
+	switch (os::error(result)) {
+	case os::error::Success:
+		return "Success";
+	case os::error::MoreData:
+		return "MoreData";
+	default:
+		return "Error";
+	}
+}
+
+static const char *direction_name(os::capture::direction dir) {
+	return dir == os::capture::direction::In ? "in" : "out";
+}
+
+static void print_hex(const char *data, size_t length) {
+	for (size_t idx = 0; idx < length; idx++) {
+		printf("%s%02x", idx == 0 ? "    " : (idx % 32 == 0 ? "\n    " : " "), (unsigned char)data[idx]);
+	}
+	if (length > 0) {
+		printf("\n");
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	std::string                 path;
+	std::string                 csv;
+	std::map<uint32_t, bool>    lanes;
+	int                         direction = -1;
+	uint64_t                    limit     = UINT64_MAX;
+	size_t                      hex       = 0;
+	bool                        summary   = false;
+
+	try {
+		for (int idx = 1; idx < argc; idx++) {
+			std::string arg   = argv[idx];
+			const char *value = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+			if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else if (arg == "--summary") {
+				summary = true;
+				continue;
+			} else if ((arg.length() == 0) || (arg[0] != '-')) {
+				if (path.length() > 0) {
+					throw std::invalid_argument("Only one capture file can be dumped at a time.");
+				}
+				path = arg;
+				continue;
+			} else if (!value) {
+				throw std::invalid_argument("Missing value for '" + arg + "'.");
+			}
+			idx++;
+
+			if (arg == "--csv") {
+				csv = value;
+			} else if (arg == "--lane") {
+				lanes[uint32_t(parse_number(value))] = true;
+			} else if (arg == "--direction") {
+				if (strcmp(value, "in") == 0) {
+					direction = int(os::capture::direction::In);
+				} else if (strcmp(value, "out") == 0) {
+					direction = int(os::capture::direction::Out);
+				} else {
+					throw std::invalid_argument(std::string("Unknown direction '") + value + "'.");
+				}
+			} else if (arg == "--limit") {
+				limit = parse_number(value);
+			} else if (arg == "--hex") {
+				hex = size_t(parse_number(value));
+			} else {
+				throw std::invalid_argument("Unknown option '" + arg + "'.");
+			}
+		}
+
+		if (path.length() == 0) {
+			throw std::invalid_argument("No capture file given.");
+		}
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::unique_ptr<os::capture::reader> rd;
+	try {
+		rd = std::make_unique<os::capture::reader>(path);
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+		return 1;
+	}
+	const os::capture::file_header &head = rd->get_header();
+
+	FILE *out = nullptr;
+	if (csv == "-") {
+		out = stdout;
+	} else if (csv.length() > 0) {
+		out = fopen(csv.c_str(), "w");
+		if (!out) {
+			fprintf(stderr, "Failed to open '%s' for writing.\n", csv.c_str());
+			return 1;
+		}
+	}
+	// Listing and CSV on stdout would mix, so the listing is skipped whenever CSV is written.
+	bool list = !summary && !out;
+
+	if (out) {
+		fprintf(out, "index,time_ns,lane,direction,length,captured,latency_ns,result\n");
+	}
+	if (list) {
+		printf("%10s %14s %6s %4s %10s %10s %12s %s\n", "INDEX", "TIME (US)", "LANE", "DIR", "LENGTH", "CAPTURED",
+			   "LATENCY (NS)", "RESULT");
+	}
+
+	std::map<std::pair<uint32_t, int>, lane_summary> lanes_seen;
+	uint64_t                                         index  = 0;
+	uint64_t                                         shown  = 0;
+	uint64_t                                         offset = rd->begin();
+	os::capture::reader::entry                       ent;
+	while ((shown < limit) && rd->next(offset, ent)) {
+		const os::capture::record_header &rec = *ent.header;
+		uint64_t                          idx = index++;
+		if ((lanes.size() > 0) && (lanes.find(rec.lane) == lanes.end())) {
+			continue;
+		} else if ((direction >= 0) && (int(rec.dir) != direction)) {
+			continue;
+		}
+		shown++;
+
+		uint64_t time = rec.timestamp >= head.start_time ? rec.timestamp - head.start_time : 0;
+		if (out) {
+			fprintf(out, "%llu,%llu,%u,%s,%u,%u,%llu,%s\n", (unsigned long long)idx, (unsigned long long)time,
+					rec.lane, direction_name(rec.dir), rec.message_length, rec.captured_length,
+					(unsigned long long)rec.latency, error_name(rec.result));
+		}
+		if (list) {
+			printf("%10llu %14.3f %6u %4s %10u %10u %12llu %s\n", (unsigned long long)idx, double(time) / 1e3,
+				   rec.lane, direction_name(rec.dir), rec.message_length, rec.captured_length,
+				   (unsigned long long)rec.latency, error_name(rec.result));
+			print_hex(ent.data, std::min<size_t>(hex, rec.captured_length));
+		}
+
+		lane_summary &sum = lanes_seen[std::make_pair(rec.lane, int(rec.dir))];
+		if (sum.messages > 0) {
+			sum.gaps.record(std::chrono::nanoseconds(rec.timestamp - sum.last));
+		} else {
+			sum.first = rec.timestamp;
+		}
+		sum.messages++;
+		sum.bytes += rec.message_length;
+		sum.last = rec.timestamp;
+		sum.sizes.record(std::chrono::nanoseconds(rec.message_length));
+		sum.latency.record(std::chrono::nanoseconds(rec.latency));
+	}
+	if (out && (out != stdout)) {
+		fclose(out);
+	}
+
+	FILE *info = out == stdout ? stderr : stdout;
+	fprintf(info, "\n%s: %llu records, %llu messages seen, sampled 1/%u, %llu dropped (file full)\n", path.c_str(),
+			(unsigned long long)head.records.load(), (unsigned long long)head.seen.load(), head.sample_every,
+			(unsigned long long)head.dropped.load());
+	fprintf(info, "%6s %4s %10s %12s %10s %10s %10s %12s %12s %12s\n", "LANE", "DIR", "MESSAGES", "BYTES",
+			"SIZE P50", "SIZE P99", "SIZE MAX", "LATENCY P50", "LATENCY P99", "GAP P50");
+	for (auto &kv : lanes_seen) {
+		lane_summary &       sum     = kv.second;
+		const os::histogram &sizes   = sum.sizes;
+		const os::histogram &latency = sum.latency;
+		const os::histogram &gaps    = sum.gaps;
+		fprintf(info, "%6u %4s %10llu %12llu %10lld %10lld %10lld %12lld %12lld %12lld\n", kv.first.first,
+				direction_name(os::capture::direction(kv.first.second)), (unsigned long long)sum.messages,
+				(unsigned long long)sum.bytes, (long long)sizes.percentile(0.5).count(),
+				(long long)sizes.percentile(0.99).count(), (long long)sizes.max().count(),
+				(long long)latency.percentile(0.5).count(), (long long)latency.percentile(0.99).count(),
+				(long long)gaps.percentile(0.5).count());
+	}
+
+	return 0;
+}
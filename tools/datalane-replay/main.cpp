@@ -0,0 +1,538 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../source/os/capture.hpp"
+#include "../../source/os/histogram.hpp"
+
+#ifdef _WIN32
+#include "../../source/os/windows/named-pipe.hpp"
+typedef os::windows::named_pipe pipe_t;
+#define popen _popen
+#define pclose _pclose
+#else
+#include "../../source/os/posix/named-pipe.hpp"
+typedef os::posix::named_pipe pipe_t;
+#endif
+
+typedef std::chrono::steady_clock replay_clock;
+
+struct message {
+	// Time since the first message of the sequence.
+	std::chrono::nanoseconds offset;
+	const char *             data;
+	size_t                   length;
+	size_t                   captured;
+};
+
+// The recorded messages of one lane, replayed on one connection.
+struct sequence {
+	uint32_t             lane;
+	std::vector<message> messages;
+};
+
+struct options {
+	std::string           file;
+	std::string           pipe;
+	std::string           sink;
+	double                speed     = 1.0;
+	size_t                processes = 1;
+	size_t                repeat    = 1;
+	int                   direction = int(os::capture::direction::Out);
+	std::vector<uint32_t> lanes;
+	int                   worker = -1;
+
+	std::chrono::nanoseconds timeout = std::chrono::seconds(10);
+};
+
+// Outcome of one process, also the line a worker process reports to its parent.
+struct outcome {
+	uint64_t messages = 0;
+	uint64_t bytes    = 0;
+	uint64_t received = 0;
+	uint64_t errors   = 0;
+	uint64_t duration = 0;
+	// Delay between the scheduled send time and completion of the write, in nanoseconds.
+	uint64_t delay_p50  = 0;
+	uint64_t delay_p99  = 0;
+	uint64_t delay_p999 = 0;
+	uint64_t delay_max  = 0;
+};
+
+static void usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s [options] --pipe NAME FILE\n"
+			"       %s --sink NAME\n"
+			"  --pipe NAME         Pipe of the server to replay against\n"
+			"  --speed X           Replay at X times the recorded rate, 0 sends as fast as possible (default 1)\n"
+			"  --max-rate          Same as '--speed 0'\n"
+			"  --processes N       Replay from N client processes at once, each with all lanes (default 1)\n"
+			"  --repeat N          Replay the recording N times in a row (default 1)\n"
+			"  --lane N            Only replay this lane, may be repeated (default all)\n"
+			"  --direction DIR     Replay the 'out' (default, captured at a client) or 'in' (captured at the\n"
+			"                      server) messages\n"
+			"  --timeout-ms N      Give up on a connection after waiting this long (default 10000)\n"
+			"  --sink NAME         Run a server on NAME that accepts any number of clients and discards all\n"
+			"                      messages, as a target for dry runs\n",
+			program, program);
+}
+
+static double parse_double(const char *text) {
+	char * end   = nullptr;
+	double value = strtod(text, &end);
+	if ((end == text) || (*end != '\0') || (value < 0)) {
+		throw std::invalid_argument(std::string("Invalid number '") + text + "'.");
+	}
+	return value;
+}
+
+static uint64_t parse_number(const char *text) {
+	char *             end   = nullptr;
+	unsigned long long value = strtoull(text, &end, 10);
+	if ((end == text) || (*end != '\0')) {
+		throw std::invalid_argument(std::string("Invalid number '") + text + "'.");
+	}
+	return uint64_t(value);
+}
+
+static std::vector<sequence> load(os::capture::reader &rd, const options &opt) {
+	std::map<uint32_t, sequence> by_lane;
+	uint64_t                     offset = rd.begin();
+	os::capture::reader::entry   ent;
+	while (rd.next(offset, ent)) {
+		const os::capture::record_header &rec = *ent.header;
+		if (int(rec.dir) != opt.direction) {
+			continue;
+		} else if ((opt.lanes.size() > 0) && (std::find(opt.lanes.begin(), opt.lanes.end(), rec.lane) == opt.lanes.end())) {
+			continue;
+		}
+
+		sequence &seq = by_lane[rec.lane];
+		seq.lane      = rec.lane;
+		message msg;
+		// Made relative to the first message below.
+		msg.offset   = std::chrono::nanoseconds(rec.timestamp);
+		msg.data     = ent.data;
+		msg.length   = rec.message_length;
+		msg.captured = rec.captured_length;
+		seq.messages.push_back(msg);
+	}
+
+	// All lanes share the time line of the recording, so that they overlap like they did originally.
+	std::vector<sequence>    sequences;
+	std::chrono::nanoseconds first = std::chrono::nanoseconds::max();
+	for (auto &kv : by_lane) {
+		std::vector<message> &msgs = kv.second.messages;
+		// Records are ordered by reservation, not by completion.
+		std::stable_sort(msgs.begin(), msgs.end(),
+						 [](const message &a, const message &b) { return a.offset < b.offset; });
+		first = std::min(first, msgs.front().offset);
+	}
+	for (auto &kv : by_lane) {
+		for (message &msg : kv.second.messages) {
+			msg.offset -= first;
+		}
+		sequences.push_back(std::move(kv.second));
+	}
+	return sequences;
+}
+
+// Replays one sequence on its own connection, draining whatever the server sends back.
+static void replay(const options &opt, const sequence &seq, replay_clock::time_point start,
+				   std::chrono::nanoseconds span, outcome &out, os::histogram &delays) {
+	pipe_t                        pipe(os::open_only, opt.pipe);
+	std::shared_ptr<os::async_op> read_op, write_op;
+	std::vector<char>             inbound(65536), outbound;
+	os::error                     read_ec = os::error::Unknown, write_ec = os::error::Unknown;
+	size_t                        read_length = 0;
+
+	auto post_read = [&]() {
+		read_ec = os::error::Pending;
+		os::error ec = pipe.read(inbound.data(), inbound.size(), read_op, [&](os::error ec, size_t length) {
+			read_ec     = ec;
+			read_length = length;
+		});
+		if ((ec != os::error::Pending) && (ec != os::error::Success)) {
+			throw std::runtime_error("Reading failed with error " + std::to_string(int(ec)) + ".");
+		}
+	};
+	post_read();
+
+	size_t                   total   = seq.messages.size() * opt.repeat;
+	size_t                   next    = 0;
+	bool                     writing = false;
+	replay_clock::time_point scheduled;
+	auto                     due_of = [&](size_t index) {
+		if (opt.speed <= 0) {
+			return start;
+		}
+		// Repeats continue on the same schedule, one recording length apart.
+		std::chrono::nanoseconds at = span * int64_t(index / seq.messages.size())
+									  + seq.messages[index % seq.messages.size()].offset;
+		return start + std::chrono::nanoseconds(int64_t(double(at.count()) / opt.speed));
+	};
+	while ((next < total) || writing) {
+		const message &msg = seq.messages[next % seq.messages.size()];
+		if (!writing && (next < total)) {
+			replay_clock::time_point due = due_of(next);
+			if (replay_clock::now() >= due) {
+				const char *data = msg.data;
+				if (msg.captured < msg.length) {
+					// Truncated by the capture, pad with zeros.
+					outbound.assign(msg.length, 0);
+					memcpy(outbound.data(), msg.data, msg.captured);
+					data = outbound.data();
+				}
+				write_ec     = os::error::Pending;
+				os::error ec = pipe.write(data, msg.length, write_op, [&](os::error ec, size_t) { write_ec = ec; });
+				if ((ec != os::error::Pending) && (ec != os::error::Success)) {
+					throw std::runtime_error("Writing failed with error " + std::to_string(int(ec)) + ".");
+				}
+				// As fast as possible has no schedule, so the delay is just the write itself.
+				scheduled = (opt.speed > 0) ? due : replay_clock::now();
+				writing   = true;
+				continue;
+			}
+		}
+
+		// Sleep until the next message is due, unless a read or write completes first.
+		std::chrono::nanoseconds timeout = opt.timeout;
+		if (!writing && (next < total)) {
+			timeout = std::min<std::chrono::nanoseconds>(timeout, due_of(next) - replay_clock::now());
+			timeout = std::max<std::chrono::nanoseconds>(timeout, std::chrono::nanoseconds(0));
+		}
+		os::waitable *waits[] = {read_op.get(), writing ? write_op.get() : nullptr};
+		size_t        index   = 0;
+		os::error     ec      = os::waitable::wait_any(waits, 2, index, timeout);
+		if (ec == os::error::TimedOut) {
+			if (timeout == opt.timeout) {
+				throw std::runtime_error("Timed out waiting for the server.");
+			}
+			continue;
+		} else if (ec != os::error::Success) {
+			throw std::runtime_error("Waiting failed with error " + std::to_string(int(ec)) + ".");
+		}
+
+		if (index == 0) {
+			if ((read_ec != os::error::Success) && (read_ec != os::error::MoreData)) {
+				throw std::runtime_error("Read failed with error " + std::to_string(int(read_ec)) + ".");
+			}
+			if (read_ec == os::error::Success) {
+				out.received++;
+			}
+			post_read();
+		} else {
+			if (write_ec != os::error::Success) {
+				out.errors++;
+			} else {
+				out.messages++;
+				out.bytes += msg.length;
+			}
+			delays.record(replay_clock::now() - scheduled);
+			writing = false;
+			next++;
+		}
+	}
+	read_op->cancel();
+}
+
+static outcome run(const options &opt, std::vector<sequence> &sequences) {
+	outcome                              out;
+	std::vector<os::histogram>           delays(sequences.size());
+	std::vector<outcome>                 outs(sequences.size());
+	std::vector<std::exception_ptr>      errors(sequences.size());
+	std::vector<std::thread>             threads;
+
+	// Length of the whole recording, repeats start this far apart.
+	std::chrono::nanoseconds span(0);
+	for (sequence &seq : sequences) {
+		span = std::max(span, seq.messages.back().offset + std::chrono::microseconds(1));
+	}
+
+	// Give every connection time to be set up before the first message is due.
+	replay_clock::time_point start = replay_clock::now() + std::chrono::milliseconds(100);
+	for (size_t idx = 0; idx < sequences.size(); idx++) {
+		threads.emplace_back([&, idx]() {
+			try {
+				replay(opt, sequences[idx], start, span, outs[idx], delays[idx]);
+			} catch (...) {
+				errors[idx] = std::current_exception();
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	out.duration = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(replay_clock::now() - start).count());
+
+	for (size_t idx = 0; idx < sequences.size(); idx++) {
+		if (errors[idx]) {
+			try {
+				std::rethrow_exception(errors[idx]);
+			} catch (std::exception &e) {
+				fprintf(stderr, "Lane %u: %s\n", sequences[idx].lane, e.what());
+			}
+			out.errors++;
+		}
+		out.messages += outs[idx].messages;
+		out.bytes += outs[idx].bytes;
+		out.received += outs[idx].received;
+		out.errors += outs[idx].errors;
+	}
+
+	// Every connection kept its own histogram.
+	os::histogram all;
+	for (os::histogram &delay : delays) {
+		all.merge(delay);
+	}
+	out.delay_p50  = uint64_t(all.percentile(0.5).count());
+	out.delay_p99  = uint64_t(all.percentile(0.99).count());
+	out.delay_p999 = uint64_t(all.percentile(0.999).count());
+	out.delay_max  = uint64_t(all.max().count());
+	return out;
+}
+
+static const char *outcome_format = "%llu %llu %llu %llu %llu %llu %llu %llu %llu";
+
+static void print_outcome(const char *who, const outcome &out) {
+	double seconds = double(out.duration) / 1e9;
+	printf("%-8s %10llu %12llu %10.0f %9.2f %10llu %7llu %12llu %12llu %12llu %12llu\n", who,
+		   (unsigned long long)out.messages, (unsigned long long)out.bytes,
+		   seconds > 0 ? double(out.messages) / seconds : 0, seconds > 0 ? double(out.bytes) / seconds / 1048576.0 : 0,
+		   (unsigned long long)out.received, (unsigned long long)out.errors, (unsigned long long)out.delay_p50,
+		   (unsigned long long)out.delay_p99, (unsigned long long)out.delay_p999, (unsigned long long)out.delay_max);
+}
+
+static std::string quote(const std::string &arg) {
+	std::string result = "\"";
+	for (char c : arg) {
+		if ((c == '"') || (c == '\\')) {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + "\"";
+}
+
+// Starts the same replay in 'opt.processes' worker processes and combines what they report.
+static int run_processes(int argc, const char *argv[], const options &opt) {
+	std::string command;
+	for (int idx = 0; idx < argc; idx++) {
+		command += (idx > 0 ? " " : "") + quote(argv[idx]);
+	}
+
+	std::vector<FILE *> workers;
+	for (size_t idx = 0; idx < opt.processes; idx++) {
+		FILE *file = popen((command + " --worker " + std::to_string(idx)).c_str(), "r");
+		if (!file) {
+			fprintf(stderr, "Failed to start worker %zu.\n", idx);
+			continue;
+		}
+		workers.push_back(file);
+	}
+
+	outcome total;
+	int     code = 0;
+	for (size_t idx = 0; idx < workers.size(); idx++) {
+		outcome            out;
+		unsigned long long v[9] = {0};
+		if (fscanf(workers[idx], outcome_format, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8])
+			!= 9) {
+			fprintf(stderr, "Worker %zu did not report a result.\n", idx);
+			code = 1;
+		}
+		if (pclose(workers[idx]) != 0) {
+			code = 1;
+		}
+		out.messages   = v[0];
+		out.bytes      = v[1];
+		out.received   = v[2];
+		out.errors     = v[3];
+		out.duration   = v[4];
+		out.delay_p50  = v[5];
+		out.delay_p99  = v[6];
+		out.delay_p999 = v[7];
+		out.delay_max  = v[8];
+		print_outcome(("#" + std::to_string(idx)).c_str(), out);
+
+		// Processes run side by side, so percentiles of the whole can only be bounded by the worst process.
+		total.messages += out.messages;
+		total.bytes += out.bytes;
+		total.received += out.received;
+		total.errors += out.errors;
+		total.duration   = std::max(total.duration, out.duration);
+		total.delay_p50  = std::max(total.delay_p50, out.delay_p50);
+		total.delay_p99  = std::max(total.delay_p99, out.delay_p99);
+		total.delay_p999 = std::max(total.delay_p999, out.delay_p999);
+		total.delay_max  = std::max(total.delay_max, out.delay_max);
+	}
+	print_outcome("total", total);
+	return (code != 0 || total.errors > 0) ? 1 : 0;
+}
+
+// Accepts clients on 'name' forever and throws away everything they send.
+static int run_sink(const options &opt) {
+	std::mutex               lock;
+	std::vector<std::thread> threads;
+	for (;;) {
+		std::unique_ptr<pipe_t>       server = std::make_unique<pipe_t>(os::create_only, opt.sink);
+		std::shared_ptr<os::async_op> accept_op;
+		os::error                     ec = server->accept(accept_op, nullptr);
+		if (ec == os::error::Pending) {
+			ec = accept_op->wait();
+		} else if (ec == os::error::Connected) {
+			ec = os::error::Success;
+		}
+		if (ec != os::error::Success) {
+			fprintf(stderr, "Accepting failed with error %d.\n", int(ec));
+			continue;
+		}
+
+		std::shared_ptr<pipe_t> client(server.release());
+		std::thread([client]() {
+			std::shared_ptr<os::async_op> read_op;
+			std::vector<char>             buffer(65536);
+			for (;;) {
+				os::error result = os::error::Unknown;
+				os::error ec     = client->read(buffer.data(), buffer.size(), read_op,
+                                            [&result](os::error ec, size_t) { result = ec; });
+				if ((ec == os::error::Success) || (ec == os::error::Pending)) {
+					ec = read_op->wait();
+				}
+				if ((ec != os::error::Success) || ((result != os::error::Success) && (result != os::error::MoreData))) {
+					break;
+				}
+			}
+		}).detach();
+	}
+	return 0;
+}
+
+int main(int argc, const char *argv[]) {
+	options opt;
+
+	try {
+		for (int idx = 1; idx < argc; idx++) {
+			std::string arg   = argv[idx];
+			const char *value = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+			if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else if (arg == "--max-rate") {
+				opt.speed = 0;
+				continue;
+			} else if ((arg.length() == 0) || (arg[0] != '-')) {
+				if (opt.file.length() > 0) {
+					throw std::invalid_argument("Only one capture file can be replayed at a time.");
+				}
+				opt.file = arg;
+				continue;
+			} else if (!value) {
+				throw std::invalid_argument("Missing value for '" + arg + "'.");
+			}
+			idx++;
+
+			if (arg == "--pipe") {
+				opt.pipe = value;
+			} else if (arg == "--sink") {
+				opt.sink = value;
+			} else if (arg == "--speed") {
+				opt.speed = parse_double(value);
+			} else if (arg == "--processes") {
+				opt.processes = size_t(parse_number(value));
+			} else if (arg == "--repeat") {
+				opt.repeat = size_t(parse_number(value));
+			} else if (arg == "--lane") {
+				opt.lanes.push_back(uint32_t(parse_number(value)));
+			} else if (arg == "--direction") {
+				if (strcmp(value, "in") == 0) {
+					opt.direction = int(os::capture::direction::In);
+				} else if (strcmp(value, "out") == 0) {
+					opt.direction = int(os::capture::direction::Out);
+				} else {
+					throw std::invalid_argument(std::string("Unknown direction '") + value + "'.");
+				}
+			} else if (arg == "--timeout-ms") {
+				opt.timeout = std::chrono::milliseconds(parse_number(value));
+			} else if (arg == "--worker") {
+				opt.worker = int(parse_number(value));
+			} else {
+				throw std::invalid_argument("Unknown option '" + arg + "'.");
+			}
+		}
+
+		if (opt.sink.length() > 0) {
+			return run_sink(opt);
+		} else if (opt.pipe.length() == 0) {
+			throw std::invalid_argument("No pipe given.");
+		} else if (opt.file.length() == 0) {
+			throw std::invalid_argument("No capture file given.");
+		} else if ((opt.processes == 0) || (opt.repeat == 0)) {
+			throw std::invalid_argument("'--processes' and '--repeat' must be at least 1.");
+		}
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::unique_ptr<os::capture::reader> rd;
+	std::vector<sequence>                sequences;
+	try {
+		rd        = std::make_unique<os::capture::reader>(opt.file);
+		sequences = load(*rd, opt);
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s: %s\n", opt.file.c_str(), e.what());
+		return 1;
+	}
+	if (sequences.size() == 0) {
+		fprintf(stderr, "%s: No messages to replay.\n", opt.file.c_str());
+		return 1;
+	}
+
+	if (opt.worker < 0) {
+		printf("%-8s %10s %12s %10s %9s %10s %7s %12s %12s %12s %12s\n", "PROCESS", "MESSAGES", "BYTES", "MSG/S",
+			   "MB/S", "RECEIVED", "ERRORS", "DELAY P50", "DELAY P99", "DELAY P99.9", "DELAY MAX");
+		if (opt.processes > 1) {
+			return run_processes(argc, argv, opt);
+		}
+	}
+
+	outcome out = run(opt, sequences);
+	if (opt.worker >= 0) {
+		printf(outcome_format, (unsigned long long)out.messages, (unsigned long long)out.bytes,
+			   (unsigned long long)out.received, (unsigned long long)out.errors, (unsigned long long)out.duration,
+			   (unsigned long long)out.delay_p50, (unsigned long long)out.delay_p99,
+			   (unsigned long long)out.delay_p999, (unsigned long long)out.delay_max);
+		printf("\n");
+	} else {
+		print_outcome("#0", out);
+	}
+	return out.errors > 0 ? 1 : 0;
+}
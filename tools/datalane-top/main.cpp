@@ -0,0 +1,241 @@
+/* Copyright(C) 2018 Michael Fabian Dirks <info@xaymar.com>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../source/os/stats-page.hpp"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#endif
+
+// Publishers that did not update their page for this many intervals are considered gone.
+static const uint64_t stale_intervals = 5;
+
+struct channel_row {
+	uint64_t               pid;
+	os::stats_page::record data;
+	double                 in_rate   = 0;
+	double                 out_rate  = 0;
+	double                 in_bytes  = 0;
+	double                 out_bytes = 0;
+};
+
+static void usage(const char *program) {
+	fprintf(stderr,
+			"Usage: %s [options]\n"
+			"  --interval MS       Refresh every MS milliseconds (default 1000)\n"
+			"  --once              Print a single snapshot and exit, rates need two samples and show as 0\n"
+			"  --pid PID           Only show this process, may be repeated (required on Windows)\n"
+			"  --all               Also show publishers that stopped updating their page\n",
+			program);
+}
+
+static uint64_t parse_number(const char *text) {
+	char *             end   = nullptr;
+	unsigned long long value = strtoull(text, &end, 10);
+	if ((end == text) || (*end != '\0')) {
+		throw std::invalid_argument(std::string("Invalid number '") + text + "'.");
+	}
+	return uint64_t(value);
+}
+
+static uint64_t now_ns() {
+	// Same clock as the publishers, which is system wide on all supported platforms.
+	return uint64_t(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+			.count());
+}
+
+static bool is_alive(uint64_t pid) {
+#ifdef _WIN32
+	(void)pid;
+	return true;
+#else
+	return (kill(pid_t(pid), 0) == 0) || (errno == EPERM);
+#endif
+}
+
+static std::string format_latency(uint64_t ns) {
+	char buf[32];
+	if (ns == 0) {
+		return "-";
+	} else if (ns < 10000) {
+		snprintf(buf, sizeof(buf), "%lluns", (unsigned long long)ns);
+	} else if (ns < 10000000) {
+		snprintf(buf, sizeof(buf), "%.1fus", double(ns) / 1e3);
+	} else if (ns < 10000000000ull) {
+		snprintf(buf, sizeof(buf), "%.1fms", double(ns) / 1e6);
+	} else {
+		snprintf(buf, sizeof(buf), "%.1fs", double(ns) / 1e9);
+	}
+	return buf;
+}
+
+static void print_table(std::vector<channel_row> &rows, bool clear) {
+	if (clear) {
+		// Home the cursor and clear the screen.
+		printf("\x1b[H\x1b[2J");
+	}
+	printf("%-8s %-32s %10s %10s %9s %9s %6s %6s %9s %9s %9s\n", "PID", "CHANNEL", "MSG/S IN", "MSG/S OUT",
+		   "MB/S IN", "MB/S OUT", "P-RD", "P-WR", "READ P99", "WRITE P99", "WAIT P99");
+	for (channel_row &row : rows) {
+		std::string name = row.data.name;
+		if (name.length() > 32) {
+			name = name.substr(0, 29) + "...";
+		}
+		printf("%-8llu %-32s %10.0f %10.0f %9.2f %9.2f %6lld %6lld %9s %9s %9s\n", (unsigned long long)row.pid,
+			   name.c_str(), row.in_rate, row.out_rate, row.in_bytes / 1048576.0, row.out_bytes / 1048576.0,
+			   (long long)row.data.pending_reads, (long long)row.data.pending_writes,
+			   format_latency(row.data.latency[size_t(os::latency_type::Read)].p99).c_str(),
+			   format_latency(row.data.latency[size_t(os::latency_type::Write)].p99).c_str(),
+			   format_latency(row.data.latency[size_t(os::latency_type::Wait)].p99).c_str());
+	}
+	if (rows.size() == 0) {
+		printf("No channels are being published. Set DATALANE_STATS_PAGE=<interval ms> in the target process.\n");
+	}
+	fflush(stdout);
+}
+
+int main(int argc, const char *argv[]) {
+	std::chrono::milliseconds interval(1000);
+	bool                      once     = false;
+	bool                      show_all = false;
+	std::vector<uint64_t>     pids;
+
+	try {
+		for (int idx = 1; idx < argc; idx++) {
+			std::string arg   = argv[idx];
+			const char *value = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+			if (arg == "--help" || arg == "-h") {
+				usage(argv[0]);
+				return 0;
+			} else if (arg == "--once") {
+				once = true;
+				continue;
+			} else if (arg == "--all") {
+				show_all = true;
+				continue;
+			} else if (!value) {
+				throw std::invalid_argument("Missing value for '" + arg + "'.");
+			}
+			idx++;
+
+			if (arg == "--interval") {
+				interval = std::chrono::milliseconds(parse_number(value));
+			} else if (arg == "--pid") {
+				pids.push_back(parse_number(value));
+			} else {
+				throw std::invalid_argument("Unknown option '" + arg + "'.");
+			}
+		}
+
+		if (interval.count() == 0) {
+			throw std::invalid_argument("'--interval' must be at least 1.");
+		}
+#ifdef _WIN32
+		if (pids.size() == 0) {
+			throw std::invalid_argument("Shared memory can't be enumerated on Windows, use '--pid'.");
+		}
+#endif
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Previous sample of every channel, keyed by page and slot.
+	std::map<std::pair<std::string, size_t>, channel_row> previous;
+
+	for (;;) {
+		std::vector<std::string> pages;
+		if (pids.size() > 0) {
+			for (uint64_t pid : pids) {
+				pages.push_back(os::stats_page::get_page_name(pid));
+			}
+		} else {
+			pages = os::stats_page::find_pages();
+		}
+
+		std::map<std::pair<std::string, size_t>, channel_row> current;
+		std::vector<channel_row>                              rows;
+		uint64_t                                              now = now_ns();
+		uint64_t stale = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count()) * stale_intervals;
+
+		for (std::string &page : pages) {
+			os::stats_page::reader rd(page);
+			if (!rd.is_valid()) {
+				continue;
+			}
+			if (!show_all) {
+				// The publisher interval is unknown, so a page is stale when it fell behind both intervals.
+				uint64_t heartbeat = rd.get_heartbeat();
+				uint64_t limit     = std::max<uint64_t>(stale, 5000000000ull);
+				if (!is_alive(rd.get_pid()) || ((now > heartbeat) && (now - heartbeat > limit))) {
+					continue;
+				}
+			}
+
+			for (size_t idx = 0; idx < rd.get_slot_count(); idx++) {
+				channel_row row;
+				if (!rd.read(idx, row.data)) {
+					continue;
+				}
+				row.data.name[os::stats_page::name_length - 1] = '\0';
+				row.pid                                        = rd.get_pid();
+
+				auto key  = std::make_pair(page, idx);
+				auto prev = previous.find(key);
+				if ((prev != previous.end()) && (strcmp(prev->second.data.name, row.data.name) == 0)) {
+					const os::stats_page::record &old = prev->second.data;
+					if (row.data.updated == old.updated) {
+						// The publisher has not updated since the last refresh, keep the rates of the last update.
+						row = prev->second;
+					} else if ((row.data.updated > old.updated) && (row.data.messages_in >= old.messages_in)
+							   && (row.data.messages_out >= old.messages_out)) {
+						double seconds = double(row.data.updated - old.updated) / 1e9;
+						row.in_rate    = double(row.data.messages_in - old.messages_in) / seconds;
+						row.out_rate   = double(row.data.messages_out - old.messages_out) / seconds;
+						row.in_bytes   = double(row.data.bytes_in - old.bytes_in) / seconds;
+						row.out_bytes  = double(row.data.bytes_out - old.bytes_out) / seconds;
+					}
+				}
+				current[key] = row;
+				rows.push_back(row);
+			}
+		}
+		previous = std::move(current);
+
+		print_table(rows, !once);
+		if (once) {
+			break;
+		}
+		std::this_thread::sleep_for(interval);
+	}
+
+	return 0;
+}